@@ -0,0 +1,258 @@
+"""
+Clock alignment between the rig (esp_timer), the acquisition system and the
+host, from the firmware's clock-sync pulses (main/clocksync.h).
+
+Offline: pair the TLM_SYNC records of a session (telemetry.py --csv PREFIX
+writes PREFIX_sync.csv; with the pulses on the event pin use PREFIX_marker.csv)
+with the rising edges the acquisition system recorded, and fit
+
+    acq_time = device_time + offset + drift * (device_time - t0)
+
+The acquired pulses are numbered from their widths (frame coding, see
+clocksync.h), so missed edges or an acquisition started late do not shift
+the pairing.
+
+Live: fit the host clock (time.time()) against the device from the receive
+times of the TLM_SYNC records. That fit carries the serial latency as part of
+the offset, a few ms; use the acquisition edges when sub-ms matters.
+
+Usage:
+    python clocksync.py --sync session_sync.csv --edges intan_sync.csv
+    python clocksync.py --sync session_marker.csv --edges edges.csv --out map.csv
+    python clocksync.py COM8                     # live, host clock vs device
+
+--edges is a CSV with the rising-edge time and the pulse width in seconds per
+row (columns set by --edge-cols, default 0,1).
+"""
+import argparse
+import csv
+import math
+import sys
+import time
+
+FRAME_LEN = 10          # CLOCKSYNC_FRAME_LEN
+ZERO_S, ONE_S, FRAME_S = 1e-3, 2e-3, 3e-3
+SYNC_MARKERS = (12, 13, 14)     # SYNC_0, SYNC_1, SYNC_FRAME in event_state_t
+Z95 = 1.96
+
+
+class ClockFit:
+    """
+    Online least-squares fit of y = x + offset + drift * (x - x0), optionally
+    with exponential forgetting (window in seconds of x) so slow drift changes
+    over a long session are tracked. Works on y - x, which only spans the
+    offset and drift, so the sums stay well conditioned for hours.
+    """
+
+    def __init__(self, window_s=None, period_s=1.0, reject_sigma=5.0):
+        self.lam = math.exp(-period_s / window_s) if window_s else 1.0
+        self.reject_sigma = reject_sigma
+        self.x0 = None
+        self.w = 0.0
+        self.mx = self.my = 0.0
+        self.sxx = self.sxy = self.syy = 0.0
+        self.n = 0
+        self.rejected = 0
+
+    def add(self, x, y):
+        """Add one pair (seconds); returns False if rejected as an outlier."""
+        if self.x0 is None:
+            self.x0, self.y0 = x, y - x
+        u, v = x - self.x0, (y - x) - self.y0
+        if self.n >= 10 and self.reject_sigma:
+            r = v - self._predict_v(u)
+            if abs(r) > self.reject_sigma * max(self.sigma(), 1e-6):
+                self.rejected += 1
+                return False
+        lam = self.lam
+        self.w = lam * self.w + 1.0
+        du, dv = u - self.mx, v - self.my
+        self.mx += du / self.w
+        self.my += dv / self.w
+        self.sxx = lam * self.sxx + du * (u - self.mx)
+        self.sxy = lam * self.sxy + du * (v - self.my)
+        self.syy = lam * self.syy + dv * (v - self.my)
+        self.n += 1
+        return True
+
+    def _slope(self):
+        return self.sxy / self.sxx if self.sxx > 0 else 0.0
+
+    def _predict_v(self, u):
+        return self.my + self._slope() * (u - self.mx)
+
+    def sigma(self):
+        """Residual standard deviation, seconds."""
+        if self.w <= 2 or self.sxx <= 0:
+            return float("nan")
+        return math.sqrt(max(self.syy - self._slope() * self.sxy, 0.0) / (self.w - 2))
+
+    def drift(self):
+        """(drift, 95% half-width), dimensionless (multiply by 1e6 for ppm)."""
+        se = self.sigma() / math.sqrt(self.sxx) if self.sxx > 0 else float("nan")
+        return self._slope(), Z95 * se
+
+    def offset(self, x):
+        """(y - x at device time x, 95% half-width), seconds."""
+        u = x - self.x0
+        se = self.sigma() * math.sqrt(1.0 / self.w + (u - self.mx) ** 2 / self.sxx)
+        return self.y0 + self._predict_v(u), Z95 * se
+
+    def map(self, x):
+        """Device time -> the other clock."""
+        return x + self.offset(x)[0]
+
+    def summary(self, x):
+        off, off_ci = self.offset(x)
+        d, d_ci = self.drift()
+        return (f"n={self.n} offset {off * 1e3:+.4f} ms ±{off_ci * 1e3:.4f}  "
+                f"drift {d * 1e6:+.3f} ppm ±{d_ci * 1e6:.3f}  "
+                f"resid {self.sigma() * 1e6:.1f} us  rejected {self.rejected}")
+
+
+def read_device_sync(path):
+    """{pulse number: device time in s} from a telemetry.py sync or marker CSV."""
+    pulses = {}
+    with open(path, newline="") as f:
+        for row in csv.DictReader(f):
+            if "width_us" in row:                       # PREFIX_sync.csv
+                pulses[int(row["seq"])] = int(row["t_us"]) / 1e6
+            elif int(row["marker"]) in SYNC_MARKERS and int(row["t_us"]):
+                pulses[int(row["trial"])] = int(row["t_us"]) / 1e6
+    return pulses
+
+
+def read_edges(path, cols):
+    edges = []
+    with open(path, newline="") as f:
+        for row in csv.reader(f):
+            try:
+                edges.append((float(row[cols[0]]), float(row[cols[1]])))
+            except (ValueError, IndexError):
+                continue
+    return edges
+
+
+def number_edges(edges, device_frames):
+    """
+    [(pulse number, edge time)] from the acquired (time, width) edges. Frames
+    are found by their long first pulse and numbered from the 8 width-coded
+    bits (mod 256), unwrapped against the frames the device reported.
+    """
+    def symbol(w):
+        if w > (ONE_S + FRAME_S) / 2:
+            return "F"
+        return 1 if w > (ZERO_S + ONE_S) / 2 else 0
+
+    out = []
+    prev_frame = None
+    i = 0
+    while i < len(edges):
+        if symbol(edges[i][1]) != "F" or i + 8 >= len(edges):
+            i += 1
+            continue
+        t0 = edges[i][0]
+        # the 8 bit pulses must follow at one-period spacing with no gaps
+        period = edges[i + 1][0] - t0
+        block = edges[i:i + FRAME_LEN]
+        ok = len(block) >= 9 and all(
+            abs((block[k][0] - t0) - k * period) < 0.25 * period for k in range(1, 9))
+        bits = [symbol(w) for _, w in block[1:9]]
+        if not ok or "F" in bits:
+            i += 1
+            continue
+        low = sum(b << k for k, b in enumerate(bits))
+        candidates = [f for f in device_frames if f % 256 == low]
+        if not candidates:
+            i += 1
+            continue
+        if prev_frame is None:
+            if len(candidates) > 1:
+                print(f"warning: frame {low} (mod 256) is ambiguous, taking the first",
+                      file=sys.stderr)
+            frame = min(candidates)
+        else:
+            frame = min(candidates, key=lambda f: abs(f - prev_frame - 1))
+        prev_frame = frame
+        for k, (t, _) in enumerate(block):
+            if k > 0 and abs((t - t0) - k * period) > 0.25 * period:
+                break
+            out.append((frame * FRAME_LEN + k, t))
+        i += len(block)
+    return out
+
+
+def offline(args):
+    device = read_device_sync(args.sync)
+    if not device:
+        sys.exit(f"no sync pulses in {args.sync}")
+    edges = read_edges(args.edges, [int(c) for c in args.edge_cols.split(",")])
+    frames = sorted({n // FRAME_LEN for n in device})
+    pairs = [(device[n], t) for n, t in number_edges(edges, frames) if n in device]
+    if len(pairs) < 3:
+        sys.exit(f"only {len(pairs)} pulses paired ({len(device)} sent, {len(edges)} acquired)")
+    pairs.sort()
+    period = (pairs[-1][0] - pairs[0][0]) / max(len(pairs) - 1, 1)
+    fit = ClockFit(window_s=args.window, period_s=period)
+    for x, y in pairs:
+        fit.add(x, y)
+    mid = (pairs[0][0] + pairs[-1][0]) / 2
+    print(f"{len(pairs)} of {len(device)} pulses paired, {len(edges)} edges acquired")
+    print(fit.summary(mid))
+    if args.out:
+        with open(args.out, "w", newline="") as f:
+            w = csv.writer(f)
+            w.writerow(("device_s", "acq_s", "fit_s", "resid_us"))
+            for x, y in pairs:
+                w.writerow((f"{x:.6f}", f"{y:.6f}", f"{fit.map(x):.6f}",
+                            f"{(y - fit.map(x)) * 1e6:.1f}"))
+
+
+def live(args):
+    import serial
+    from telemetry import BAUD_RATE, Decoder
+
+    dec = Decoder()
+    fit = ClockFit(window_s=args.window)
+    ser = serial.Serial(args.port, args.baud or BAUD_RATE, timeout=0.1)
+    try:
+        while True:
+            data = ser.read(4096)
+            now = time.time()
+            for kind, rec in dec.feed(data):
+                if kind != "record":
+                    continue
+                if rec["type"] == "sync" or (rec["type"] == "marker" and rec["marker"] in SYNC_MARKERS):
+                    x = rec["t_us"] / 1e6
+                    fit.add(x, now)
+                    if fit.n >= 3:
+                        print(fit.summary(x))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        ser.close()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("port", nargs="?", help="serial port for the live host-clock fit")
+    ap.add_argument("--baud", type=int)
+    ap.add_argument("--sync", help="telemetry.py PREFIX_sync.csv (or PREFIX_marker.csv)")
+    ap.add_argument("--edges", help="acquired sync edges: time and width in seconds")
+    ap.add_argument("--edge-cols", default="0,1", help="columns of time,width (default 0,1)")
+    ap.add_argument("--window", type=float,
+                    help="forget pairs older than about this many seconds (default: keep all)")
+    ap.add_argument("--out", help="write the paired times and residuals here")
+    args = ap.parse_args()
+
+    if args.sync and args.edges:
+        offline(args)
+    elif args.port:
+        live(args)
+    else:
+        ap.error("give --sync and --edges, or a serial port")
+
+
+if __name__ == "__main__":
+    main()
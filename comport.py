@@ -5,10 +5,10 @@ import serial
 import csv
 import os
 from datetime import datetime
+from telemetry import BAUD_RATE   # the firmware console rate (TELEMETRY_UART_BAUD)
 
 LOGS_DIR = "logs"
 SERIAL_PORT = "COM8"
-BAUD_RATE = 115200
 ENCODER_TASK_PERIOD = 10  # ms
 
 class BehaviorLoggerGUI(tk.Tk):
@@ -92,7 +92,8 @@ class BehaviorLoggerGUI(tk.Tk):
     
     def _log_loop(self):
         while not self.stop_event.is_set():
-            raw = self.ser.readline().decode('ascii', errors='ignore').strip()
+            # binary telemetry frames end in 0x00: keep the text after the last one
+            raw = self.ser.readline().rsplit(b'\0', 1)[-1].decode('ascii', errors='ignore').strip()
             if not raw:
                 continue
             parts = raw.split(',')
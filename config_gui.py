@@ -8,6 +8,7 @@ from tkinter import ttk, simpledialog, messagebox, font
 from PIL import Image, ImageTk
 import serial
 import serial.tools.list_ports
+from telemetry import BAUD_RATE   # the firmware console rate (TELEMETRY_UART_BAUD)
 
 # === Serial Setup ===
 # def find_serial_port():
@@ -22,7 +23,7 @@ import serial.tools.list_ports
 #     raise RuntimeError("No serial port found")
 serial_port = 'COM7'
 
-ser = serial.Serial(serial_port, 115200, timeout=1)
+ser = serial.Serial(serial_port, BAUD_RATE, timeout=1)
 print(f"Connected to {serial_port}")
 
 SUBJECT_FILE = "subjects.txt"
@@ -400,7 +401,8 @@ def log_data(subject_id, csv_filename, total_trials):
         while not stop_event.is_set():
             line = ser.readline()
             if line:
-                line = line.decode(errors='ignore').strip()
+                # binary telemetry frames end in 0x00: keep the text after the last one
+                line = line.rsplit(b'\0', 1)[-1].decode(errors='ignore').strip()
                 print("ESP32:", line)
                 if line.startswith("EVENT"):
                     parts = line.split(",")
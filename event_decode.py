@@ -0,0 +1,156 @@
+"""
+Host-side decoder for the binary-coded event markers (main/event.h,
+CONFIG_EVENT_MARKER_WORDS).
+
+Each marker is a start bit then a 32-bit word, NRZ, MSB first, 10 us per bit:
+    [31:27] state  [26:11] trial (low 16 bits)  [10:4] sequence  [3:0] CRC-4
+The input is a CSV capture of the event pin, either sampled levels (one row
+per sample, --rate gives the sample rate) or a transition list with a time
+column in seconds (logic-analyser export, --time-col). Sample at 250 kHz or
+faster; bits are read at their centres.
+
+Usage:
+    python event_decode.py capture.csv --rate 1e6            # level in column 0
+    python event_decode.py edges.csv --time-col 0 --col 1    # Saleae-style export
+    python event_decode.py trace.csv --rate 2e5 --col 3 --threshold 1.6 --csv words.csv
+"""
+import argparse
+import csv
+import sys
+
+BIT_S = 10e-6
+WORD_BITS = 32
+GUARD_BITS = 3
+
+# event_state_t order (main/event.h)
+EVENT_NAMES = ("INIT", "CUE_0", "CUE_1", "CUE_2", "CUE_3", "MOVING",
+               "REWARD_0", "REWARD_1", "REWARD_2", "REWARD_3",
+               "TIMEOUT", "RESET", "SYNC_0", "SYNC_1", "SYNC_FRAME")
+
+
+def crc4(data28):
+    """CRC-4/ITU (x^4 + x + 1, init 0) over 28 bits, as event_word_crc4()."""
+    crc = 0
+    for i in range(27, -1, -1):
+        bit = ((data28 >> i) & 1) ^ (crc >> 3)
+        crc = (crc << 1) & 0xF
+        if bit:
+            crc ^= 0x3
+    return crc
+
+
+def read_edges(path, col, time_col, rate, threshold, skip):
+    """Return [(t_s, level)] with one entry per level change."""
+    edges = []
+    last = None
+    with open(path, newline="") as f:
+        rows = csv.reader(f)
+        for _ in range(skip):
+            next(rows, None)
+        for n, row in enumerate(rows):
+            try:
+                level = 1 if float(row[col]) > threshold else 0
+                t = float(row[time_col]) if time_col is not None else n / rate
+            except (ValueError, IndexError):
+                continue                    # header or blank line
+            if level != last:
+                edges.append((t, level))
+                last = level
+    return edges
+
+
+class Trace:
+    """Level lookup over an edge list; queries must move forward in time."""
+
+    def __init__(self, edges):
+        self.edges = edges
+        self.i = 0
+
+    def level(self, t):
+        while self.i + 1 < len(self.edges) and self.edges[self.i + 1][0] <= t:
+            self.i += 1
+        while self.i > 0 and self.edges[self.i][0] > t:
+            self.i -= 1
+        return self.edges[self.i][1]
+
+
+def decode(edges, bit_s=BIT_S):
+    """Yield (t_start_s, word, crc_ok) for every start bit found."""
+    trace = Trace(edges)
+    ready_after = None                      # end of the previous word's data bits
+    for k, (t0, level) in enumerate(edges):
+        if level != 1:
+            continue
+        if ready_after is not None and t0 < ready_after:
+            continue                        # an edge inside the word just read
+        if ready_after is None:
+            # first sync, or resync after a bad word: need an idle gap
+            low_since = edges[k - 1][0] if k > 0 else None
+            if low_since is not None and t0 - low_since < GUARD_BITS * bit_s * 0.9:
+                continue
+        word = 0
+        for b in range(WORD_BITS):
+            word = (word << 1) | trace.level(t0 + (1 + b + 0.5) * bit_s)
+        ok = crc4(word >> 4) == (word & 0xF)
+        # a good word fixes where the next one may start; after a bad one only
+        # an idle gap resynchronises
+        ready_after = t0 + (1 + WORD_BITS) * bit_s if ok else None
+        yield t0, word, ok
+
+
+def fields(word):
+    state = word >> 27
+    name = EVENT_NAMES[state] if state < len(EVENT_NAMES) else f"?{state}"
+    return name, (word >> 11) & 0xFFFF, (word >> 4) & 0x7F
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("capture", help="CSV capture of the event pin")
+    ap.add_argument("--col", type=int, default=0, help="column with the pin level (default 0)")
+    ap.add_argument("--time-col", type=int, help="column with the time in seconds")
+    ap.add_argument("--rate", type=float, help="sample rate in Hz when there is no time column")
+    ap.add_argument("--threshold", type=float, default=0.5,
+                    help="level above this is high (default 0.5; use ~1.6 for volts)")
+    ap.add_argument("--skip", type=int, default=0, help="header rows to skip")
+    ap.add_argument("--csv", help="write decoded words to this file")
+    args = ap.parse_args()
+
+    if args.time_col is None and not args.rate:
+        ap.error("give --rate or --time-col")
+    if args.time_col is None and args.rate < 2.5 / BIT_S:
+        print(f"warning: {args.rate:g} Hz is under 2.5 samples per bit", file=sys.stderr)
+
+    edges = read_edges(args.capture, args.col, args.time_col, args.rate,
+                       args.threshold, args.skip)
+    if not edges:
+        sys.exit("no samples read")
+
+    out = None
+    if args.csv:
+        out = csv.writer(open(args.csv, "w", newline=""))
+        out.writerow(("t_s", "event", "trial", "seq", "gap"))
+
+    good = bad = gaps = 0
+    prev_seq = None
+    for t, word, ok in decode(edges):
+        if not ok:
+            bad += 1
+            print(f"{t:12.6f}  bad CRC  0x{word:08X}")
+            continue
+        good += 1
+        name, trial, seq = fields(word)
+        gap = 0 if prev_seq is None else (seq - prev_seq - 1) & 0x7F
+        prev_seq = seq
+        gaps += gap
+        note = f"  ({gap} missing)" if gap else ""
+        print(f"{t:12.6f}  {name:<9} trial {trial:<5} seq {seq:<3}{note}")
+        if out:
+            out.writerow((f"{t:.6f}", name, trial, seq, gap))
+
+    print(f"{good} words, {bad} bad CRC, {gaps} missing by sequence number", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,113 @@
+// main/app_mode.c
+#include "app_mode.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "serial_cmd.h"
+
+static const char *TAG = "MODE";
+
+#define MODE_NVS_NAMESPACE  "app"
+#define MODE_NVS_KEY        "mode"
+#define MODE_NAME_MAX       16
+
+static const app_mode_t *s_modes[APP_MODE_MAX];
+static int               s_nmodes;
+static const app_mode_t *s_current;
+
+static const app_mode_t *find(const char *name)
+{
+    for (int i = 0; i < s_nmodes; i++) {
+        if (strcasecmp(s_modes[i]->name, name) == 0) return s_modes[i];
+    }
+    return NULL;
+}
+
+static esp_err_t load_name(char *name, size_t len)
+{
+    nvs_handle_t h;
+    ESP_RETURN_ON_ERROR(nvs_open(MODE_NVS_NAMESPACE, NVS_READONLY, &h), TAG, "nvs_open");
+    esp_err_t err = nvs_get_str(h, MODE_NVS_KEY, name, &len);
+    nvs_close(h);
+    return err;
+}
+
+static esp_err_t save_name(const char *name)
+{
+    nvs_handle_t h;
+    ESP_RETURN_ON_ERROR(nvs_open(MODE_NVS_NAMESPACE, NVS_READWRITE, &h), TAG, "nvs_open");
+    esp_err_t err = nvs_set_str(h, MODE_NVS_KEY, name);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+// MODE [name]: list the modes, or store one and restart into it
+static void cmd_mode(const char *args)
+{
+    if (*args == '\0') {
+        for (int i = 0; i < s_nmodes; i++) {
+            printf("%c %-10s %s\n", s_modes[i] == s_current ? '*' : ' ',
+                   s_modes[i]->name, s_modes[i]->help ? s_modes[i]->help : "");
+        }
+        return;
+    }
+    const app_mode_t *m = find(args);
+    if (m == NULL) {
+        printf("no mode '%s'\n", args);
+        return;
+    }
+    esp_err_t err = save_name(m->name);
+    if (err != ESP_OK) {
+        printf("mode %s: %s\n", m->name, esp_err_to_name(err));
+        return;
+    }
+    printf("mode %s: restarting\n", m->name);
+    if (s_current && s_current->teardown) s_current->teardown();
+    vTaskDelay(pdMS_TO_TICKS(50));      // let the reply drain
+    esp_restart();
+}
+
+esp_err_t app_mode_register(const app_mode_t *mode)
+{
+    ESP_RETURN_ON_FALSE(mode && mode->name && mode->init && mode->run, ESP_ERR_INVALID_ARG,
+                        TAG, "bad mode");
+    ESP_RETURN_ON_FALSE(strlen(mode->name) < MODE_NAME_MAX, ESP_ERR_INVALID_ARG,
+                        TAG, "mode name too long");
+    ESP_RETURN_ON_FALSE(s_nmodes < APP_MODE_MAX, ESP_ERR_NO_MEM, TAG, "mode table full");
+    if (s_nmodes == 0) {
+        ESP_RETURN_ON_ERROR(serial_cmd_register("MODE", cmd_mode, "[name] list or switch task mode (restarts)"),
+                            TAG, "MODE command");
+    }
+    s_modes[s_nmodes++] = mode;
+    return ESP_OK;
+}
+
+esp_err_t app_mode_boot(const char *fallback)
+{
+    char              name[MODE_NAME_MAX];
+    const app_mode_t *m = NULL;
+
+    if (load_name(name, sizeof(name)) == ESP_OK) {
+        m = find(name);
+        if (m == NULL) ESP_LOGW(TAG, "stored mode '%s' not in this image", name);
+    }
+    if (m == NULL) m = find(fallback);
+    ESP_RETURN_ON_FALSE(m != NULL, ESP_ERR_NOT_FOUND, TAG, "no mode '%s'", fallback);
+
+    ESP_LOGI(TAG, "starting '%s'", m->name);
+    s_current = m;
+    ESP_RETURN_ON_ERROR(m->init(), TAG, "%s init", m->name);
+    return m->run();
+}
+
+const char *app_mode_current(void)
+{
+    return s_current ? s_current->name : NULL;
+}
@@ -0,0 +1,57 @@
+// main/app_mode.h
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Task modes in one firmware image.
+ *
+ * main.c does the initialization every mode shares (NVS, telemetry console,
+ * serial commands, display), then starts the one mode named in NVS. MODE
+ * <name> stores a new choice and restarts into it: rate groups, the encoder
+ * PCNT unit and the motor timer are claimed once per boot, so a restart (about
+ * a second) is the clean way to hand them to another mode.
+ */
+
+#define APP_MODE_MAX    8
+
+typedef struct {
+    const char *name;
+    const char *help;
+    esp_err_t (*init)(void);        // claim peripherals, build the UI, set up rate groups/tasks
+    esp_err_t (*run)(void);         // start them; returns once running
+    void      (*teardown)(void);    // outputs safe (motor off, TTLs low) before a restart
+} app_mode_t;
+
+// built-in modes
+extern const app_mode_t mode_task;          // phase1tieredreward.c: trial paradigms (paradigms.c)
+extern const app_mode_t mode_pidtune;       // PIDtunerOnly.c: PID tuning for pid_tuner.html
+extern const app_mode_t mode_levertest;     // test.c: RoboClaw lever test (separate rig)
+extern const app_mode_t mode_bench_kin;     // kinbus_bench.c: kinbus vs. mutex contention
+extern const app_mode_t mode_bench_motor;   // motor_bench.c: motor driver call cost
+extern const app_mode_t mode_bench_gfx;     // gfx_bench.c: CPU vs. PPA fills and keying
+
+/**
+ * @brief  Make a mode selectable; also registers the MODE serial command on
+ *         the first call.
+ */
+esp_err_t app_mode_register(const app_mode_t *mode);
+
+/**
+ * @brief  Init and run the mode stored in NVS, or @p fallback if none (or
+ *         an unknown one) is stored.
+ */
+esp_err_t app_mode_boot(const char *fallback);
+
+/**
+ * @brief  Name of the running mode (NULL before app_mode_boot()).
+ */
+const char *app_mode_current(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,283 @@
+// main/audio.c
+//
+// The refill happens in the I2S on_sent interrupt: the block that just went
+// out is rewritten in place and goes out again after the other queued blocks,
+// so the time each refilled block starts playing is known from the interrupt
+// time. Requests reach the interrupt through a one-slot mailbox; a newer
+// request simply replaces one that has not been picked up yet.
+#include "audio.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "driver/i2s_pdm.h"
+#include "esp_cache.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "journal.h"
+
+static const char *TAG = "AUDIO";
+
+#define AUDIO_GPIO_1        47
+#define AUDIO_GPIO_2        48
+#define AUDIO_FULL_SCALE    30000       // headroom below INT16_MAX
+#define AUDIO_LOOP_MIN      2400        // loop buffers span at least 50 ms
+#define BLOCK_US            ((int64_t)AUDIO_BLOCK_FRAMES * 1000000 / AUDIO_RATE_HZ)
+
+struct audio_buf {
+    int16_t  *pcm;
+    uint32_t  len;          // frames
+    uint32_t  ramp;         // attack/release, frames
+    bool      loop;
+    uint32_t  freq_hz;      // for the journal
+};
+
+typedef struct {
+    const audio_buf_t *buf;     // NULL: stop
+    int64_t            t_on;    // target time of the first sample (or of the fade)
+} audio_req_t;
+
+static i2s_chan_handle_t s_tx;
+static portMUX_TYPE      s_lock = portMUX_INITIALIZER_UNLOCKED;
+static audio_req_t       s_req;
+static bool              s_req_pending;
+static volatile bool     s_busy;
+static audio_stats_t     s_stats;
+
+// interrupt-side playback state
+static const audio_buf_t *s_cur;
+static uint32_t           s_pos;        // next frame of s_cur
+static uint32_t           s_played;     // frames since onset (attack ramp)
+static uint32_t           s_fade;       // frames left in a stop fade, 0 = none
+static bool               s_stopping;
+
+// nearest frame to a time offset
+static inline int64_t us_to_frames(int64_t us)
+{
+    return (us * AUDIO_RATE_HZ + (us >= 0 ? 500000 : -500000)) / 1000000;
+}
+
+static inline int32_t ramp_gain(uint32_t n, uint32_t ramp)
+{
+    // Q15 gain rising linearly over ramp frames
+    return n >= ramp ? 32768 : (int32_t)((uint64_t)n * 32768 / ramp);
+}
+
+static int16_t next_sample(void)
+{
+    const audio_buf_t *b = s_cur;
+    int32_t g = ramp_gain(s_played + 1, b->ramp);
+    if (!b->loop) {
+        int32_t rel = ramp_gain(b->len - s_pos, b->ramp);
+        if (rel < g) g = rel;
+    }
+    if (s_stopping) {
+        int32_t f = ramp_gain(s_fade, AUDIO_STOP_RAMP_MS * AUDIO_RATE_HZ / 1000);
+        if (f < g) g = f;
+    }
+    int16_t v = (int16_t)((b->pcm[s_pos] * g) >> 15);
+
+    s_played++;
+    if (++s_pos == b->len) {
+        if (b->loop) s_pos = 0;
+        else         s_cur = NULL;
+    }
+    if (s_stopping && --s_fade == 0) s_cur = NULL;
+    return v;
+}
+
+static bool on_sent(i2s_chan_handle_t chan, i2s_event_data_t *event, void *ctx)
+{
+    int16_t *out    = event->dma_buf;
+    size_t   frames = event->size / (2 * sizeof(int16_t));
+    // this block plays after the AUDIO_DMA_BLOCKS - 1 still queued
+    int64_t  t_blk  = esp_timer_get_time() + (AUDIO_DMA_BLOCKS - 1) * BLOCK_US;
+
+    audio_req_t req  = { 0 };
+    bool        have = false;
+    portENTER_CRITICAL_ISR(&s_lock);
+    if (s_req_pending) {
+        if (us_to_frames(s_req.t_on - t_blk) < (int64_t)frames) {          // due in this block (or already late)
+            req  = s_req;
+            have = true;
+            s_req_pending = false;
+        }
+    }
+    portEXIT_CRITICAL_ISR(&s_lock);
+
+    size_t start = frames;
+    if (have) {
+        int64_t at = us_to_frames(req.t_on - t_blk);
+        if (at < 0) {
+            uint32_t late = (uint32_t)(-at * 1000000 / AUDIO_RATE_HZ);
+            s_stats.late++;
+            if (late > s_stats.max_late_us) s_stats.max_late_us = late;
+            at = 0;
+        } else {
+            // rounding to a sample boundary; the block start itself is inferred
+            int64_t  t     = t_blk + at * 1000000 / AUDIO_RATE_HZ;
+            uint32_t round = (uint32_t)llabs(t - req.t_on);
+            if (round > s_stats.max_round_us) s_stats.max_round_us = round;
+        }
+        start = (size_t)at;
+        int64_t t_on = t_blk + at * 1000000 / AUDIO_RATE_HZ;
+        if (req.buf) {
+            journal_post(t_on, JR_TONE, 1, (uint16_t)req.buf->freq_hz);
+            s_stats.plays++;
+        } else if (s_cur) {
+            journal_post(t_on, JR_TONE, 0, 0);
+        }
+    }
+
+    for (size_t i = 0; i < frames; i++) {
+        if (i == start) {
+            if (req.buf) {
+                s_cur      = req.buf;
+                s_pos      = 0;
+                s_played   = 0;
+                s_stopping = false;
+            } else if (s_cur) {
+                s_stopping = true;
+                s_fade     = AUDIO_STOP_RAMP_MS * AUDIO_RATE_HZ / 1000;
+            }
+        }
+        int16_t v = s_cur ? next_sample() : 0;
+        out[2 * i]     = v;
+        out[2 * i + 1] = v;
+    }
+    // the block is rewritten through the cache; the DMA reads memory
+    esp_cache_msync(event->dma_buf, event->size, ESP_CACHE_MSYNC_FLAG_DIR_C2M);
+    portENTER_CRITICAL_ISR(&s_lock);
+    if (s_cur == NULL && !s_req_pending) s_busy = false;
+    portEXIT_CRITICAL_ISR(&s_lock);
+    return false;
+}
+
+esp_err_t audio_init(void)
+{
+    ESP_RETURN_ON_FALSE(s_tx == NULL, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+
+    i2s_chan_config_t ccfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_0, I2S_ROLE_MASTER);
+    ccfg.dma_desc_num  = AUDIO_DMA_BLOCKS;
+    ccfg.dma_frame_num = AUDIO_BLOCK_FRAMES;
+    ESP_RETURN_ON_ERROR(i2s_new_channel(&ccfg, &s_tx, NULL), TAG, "i2s channel");
+
+    i2s_pdm_tx_config_t pcfg = {
+        .clk_cfg  = I2S_PDM_TX_CLK_DAC_DEFAULT_CONFIG(AUDIO_RATE_HZ),
+        .slot_cfg = I2S_PDM_TX_SLOT_DAC_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO),
+        .gpio_cfg = {
+            .clk   = I2S_GPIO_UNUSED,       // DAC mode: the data lines carry everything
+            .dout  = AUDIO_GPIO_1,
+            .dout2 = AUDIO_GPIO_2,
+        },
+    };
+    pcfg.slot_cfg.line_mode = I2S_PDM_TX_TWO_LINE_DAC;
+    ESP_RETURN_ON_ERROR(i2s_channel_init_pdm_tx_mode(s_tx, &pcfg), TAG, "pdm tx");
+
+    i2s_event_callbacks_t cbs = { .on_sent = on_sent };
+    ESP_RETURN_ON_ERROR(i2s_channel_register_event_callback(s_tx, &cbs, NULL), TAG, "callbacks");
+    ESP_RETURN_ON_ERROR(i2s_channel_enable(s_tx), TAG, "enable");
+
+    ESP_LOGI(TAG, "PDM on GPIO%d/%d, %d Hz, onset latency %d us",
+             AUDIO_GPIO_1, AUDIO_GPIO_2, AUDIO_RATE_HZ, AUDIO_LATENCY_US);
+    return ESP_OK;
+}
+
+esp_err_t audio_render(const audio_wave_t *w, audio_buf_t **out)
+{
+    ESP_RETURN_ON_FALSE(w && out && w->amp >= 0.0f && w->amp <= 1.0f, ESP_ERR_INVALID_ARG,
+                        TAG, "bad wave");
+    ESP_RETURN_ON_FALSE(w->shape == AUDIO_NOISE || (w->freq_hz > 0 && w->freq_hz < AUDIO_RATE_HZ / 2),
+                        ESP_ERR_INVALID_ARG, TAG, "%lu Hz out of range", w->freq_hz);
+
+    uint32_t len;
+    double   cycle = 0.0;       // frames per cycle
+    if (w->dur_ms > 0) {
+        len = (uint32_t)((uint64_t)w->dur_ms * AUDIO_RATE_HZ / 1000);
+        if (w->shape != AUDIO_NOISE) cycle = (double)AUDIO_RATE_HZ / w->freq_hz;
+    } else if (w->shape == AUDIO_NOISE) {
+        len = AUDIO_LOOP_MIN * 4;
+    } else {
+        // whole cycles, so the loop point is seamless
+        uint32_t cycles = (uint32_t)ceil((double)AUDIO_LOOP_MIN * w->freq_hz / AUDIO_RATE_HZ);
+        len   = (uint32_t)lround((double)cycles * AUDIO_RATE_HZ / w->freq_hz);
+        cycle = (double)len / cycles;
+    }
+    ESP_RETURN_ON_FALSE(len > 0, ESP_ERR_INVALID_ARG, TAG, "empty wave");
+
+    audio_buf_t *b = heap_caps_calloc(1, sizeof(*b), MALLOC_CAP_DEFAULT);
+    ESP_RETURN_ON_FALSE(b, ESP_ERR_NO_MEM, TAG, "buf");
+    b->pcm = heap_caps_malloc(len * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    if (b->pcm == NULL) {
+        free(b);
+        ESP_LOGE(TAG, "no PSRAM for %lu frames", len);
+        return ESP_ERR_NO_MEM;
+    }
+    b->len     = len;
+    b->loop    = (w->dur_ms == 0);
+    b->ramp    = (uint32_t)((uint64_t)w->ramp_ms * AUDIO_RATE_HZ / 1000);
+    b->freq_hz = w->shape == AUDIO_NOISE ? 0 : w->freq_hz;
+    if (!b->loop && b->ramp > len / 2) b->ramp = len / 2;
+
+    const float a = w->amp * AUDIO_FULL_SCALE;
+    for (uint32_t i = 0; i < len; i++) {
+        float v;
+        switch (w->shape) {
+        case AUDIO_SINE:
+            v = sinf((float)(2.0 * M_PI * fmod(i, cycle) / cycle));
+            break;
+        case AUDIO_SQUARE:
+            v = fmod(i, cycle) < cycle / 2 ? 1.0f : -1.0f;
+            break;
+        default:
+            v = (float)(int32_t)esp_random() / 2147483648.0f;
+            break;
+        }
+        b->pcm[i] = (int16_t)lrintf(a * v);
+    }
+    *out = b;
+    return ESP_OK;
+}
+
+static int64_t request(const audio_buf_t *buf, int64_t t_on)
+{
+    int64_t earliest = esp_timer_get_time() + AUDIO_LATENCY_US;
+    if (t_on < earliest) t_on = earliest;
+    portENTER_CRITICAL(&s_lock);
+    s_req         = (audio_req_t){ .buf = buf, .t_on = t_on };
+    s_req_pending = true;
+    if (buf) s_busy = true;
+    portEXIT_CRITICAL(&s_lock);
+    return t_on;
+}
+
+int64_t audio_play(const audio_buf_t *buf)
+{
+    if (s_tx == NULL || buf == NULL) return 0;
+    return request(buf, 0);
+}
+
+int64_t audio_play_at(const audio_buf_t *buf, int64_t t_on)
+{
+    if (s_tx == NULL || buf == NULL) return 0;
+    return request(buf, t_on);
+}
+
+void audio_stop(void)
+{
+    if (s_tx == NULL) return;
+    request(NULL, 0);
+}
+
+bool audio_busy(void)
+{
+    return s_busy;
+}
+
+void audio_get_stats(audio_stats_t *out)
+{
+    *out = s_stats;
+}
@@ -0,0 +1,102 @@
+// main/audio.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Sound on the speaker pins (GPIO 47/48) as a PDM bitstream from I2S0, one
+ * line per pin (the amplifier's input filter turns it back into audio).
+ *
+ * The channel streams continuously, silence included, in DMA blocks of
+ * AUDIO_BLOCK_FRAMES. Waveforms are rendered ahead of time into buffers
+ * (audio_render()); audio_play() only hands a buffer to the block-refill
+ * interrupt. That interrupt knows when each block will reach the pins and
+ * starts the buffer at the sample that falls exactly AUDIO_LATENCY_US after
+ * the audio_play() call, so onset is a fixed delay after the state
+ * transition (to one sample, ~21 us) instead of depending on where the DMA
+ * happened to be. The scheduled onset time is journaled (JR_TONE); it is
+ * computed from the interrupt time, not measured at the pins.
+ *
+ * Ramps are applied while streaming, so one buffer serves any ramp and a
+ * looping buffer (dur_ms 0) can be faded out by audio_stop() at any point.
+ */
+
+#define AUDIO_RATE_HZ       48000
+#define AUDIO_BLOCK_FRAMES  48          // 1 ms per DMA block
+#define AUDIO_DMA_BLOCKS    3
+// a request waits at most one block for the refill interrupt, whose block
+// plays after the AUDIO_DMA_BLOCKS - 1 already queued; plus ISR margin
+#define AUDIO_LATENCY_US    (AUDIO_DMA_BLOCKS * AUDIO_BLOCK_FRAMES * 1000000 / AUDIO_RATE_HZ + 200)
+#define AUDIO_STOP_RAMP_MS  2           // fade on audio_stop(), against clicks
+
+typedef enum {
+    AUDIO_SINE = 0,
+    AUDIO_SQUARE,
+    AUDIO_NOISE,        // white noise
+} audio_shape_t;
+
+typedef struct {
+    audio_shape_t shape;
+    uint32_t      freq_hz;      // ignored for noise
+    float         amp;          // 0..1 of full scale
+    uint32_t      dur_ms;       // 0: loop until audio_stop()
+    uint32_t      ramp_ms;      // linear attack and release
+} audio_wave_t;
+
+typedef struct audio_buf audio_buf_t;
+
+typedef struct {
+    uint32_t plays;
+    uint32_t late;              // started after their target sample (should stay 0)
+    uint32_t max_late_us;
+    uint32_t max_round_us;      // scheduled onset vs. target, sample rounding only (not measured)
+} audio_stats_t;
+
+/**
+ * @brief  Bring up the PDM channel and start streaming silence.
+ */
+esp_err_t audio_init(void);
+
+/**
+ * @brief  Render a waveform into a new buffer (PSRAM). Loop buffers hold a
+ *         whole number of cycles, so the pitch may be off by up to 0.05%.
+ *         Slow (allocates and computes): do it before the trial needs it.
+ */
+esp_err_t audio_render(const audio_wave_t *wave, audio_buf_t **out);
+
+/**
+ * @brief  Play @p buf, replacing whatever is playing, AUDIO_LATENCY_US from
+ *         now. Non-blocking, safe from any task.
+ * @return The esp_timer time the first sample will reach the pins.
+ */
+int64_t audio_play(const audio_buf_t *buf);
+
+/**
+ * @brief  audio_play() with the onset at @p t_on (esp_timer time), or as
+ *         soon after as AUDIO_LATENCY_US allows. A later request still
+ *         replaces this one until its onset block is reached.
+ * @return The onset time actually scheduled.
+ */
+int64_t audio_play_at(const audio_buf_t *buf, int64_t t_on);
+
+/**
+ * @brief  Fade out over AUDIO_STOP_RAMP_MS, AUDIO_LATENCY_US from now.
+ */
+void audio_stop(void);
+
+/**
+ * @brief  True from audio_play() until the buffer (or its fade) has ended.
+ */
+bool audio_busy(void);
+
+void audio_get_stats(audio_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
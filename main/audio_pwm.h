@@ -0,0 +1,23 @@
+// main/audio_pwm.h
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Blocking tones on the speaker pins (GPIO 47/48), for the RoboClaw lever
+ * test: tone.h with the caller sleeping through the tone.
+ */
+
+/**
+ * @brief  Play a square wave for @p duration_ms, sleeping the caller. The
+ *         first call brings up the audio engine.
+ */
+void play_tone(uint32_t tone_frequency, uint32_t duration_ms);
+
+#ifdef __cplusplus
+}
+#endif
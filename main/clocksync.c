@@ -0,0 +1,87 @@
+// main/clocksync.c
+#include "clocksync.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "event.h"
+#include "freertos/FreeRTOS.h"
+#include "journal.h"
+#include "telemetry.h"
+
+static const char *TAG = "SYNC";
+
+static gpio_num_t         s_pin = GPIO_NUM_NC;
+static esp_timer_handle_t s_period_timer, s_fall_timer;
+static uint32_t           s_seq;
+static portMUX_TYPE       s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void fall_cb(void *arg)
+{
+    gpio_set_level(s_pin, 0);
+}
+
+// pulse width for pulse number seq (frame layout in clocksync.h)
+static uint16_t pulse_width(uint32_t seq)
+{
+    uint32_t k = seq % CLOCKSYNC_FRAME_LEN;
+    if (k == 0) return CLOCKSYNC_FRAME_US;
+    if (k <= 8 && ((seq / CLOCKSYNC_FRAME_LEN) >> (k - 1)) & 1) return CLOCKSYNC_ONE_US;
+    return CLOCKSYNC_ZERO_US;
+}
+
+static void period_cb(void *arg)
+{
+    uint32_t seq   = s_seq++;
+    uint16_t width = pulse_width(seq);
+
+    if (s_pin == GPIO_NUM_NC) {
+        // the marker's TLM_MARKER/journal record carries the edge time
+        event_send_marker(width == CLOCKSYNC_FRAME_US ? SYNC_FRAME :
+                          width == CLOCKSYNC_ONE_US   ? SYNC_1 : SYNC_0, seq);
+        return;
+    }
+
+    // read the clock and raise the pin with nothing in between
+    portENTER_CRITICAL(&s_lock);
+    int64_t t = esp_timer_get_time();
+    gpio_set_level(s_pin, 1);
+    portEXIT_CRITICAL(&s_lock);
+
+    esp_timer_start_once(s_fall_timer, width);
+    telemetry_sync(t, seq, width);
+    journal_post(t, JR_SYNC, 1, (uint16_t)seq);
+}
+
+esp_err_t clocksync_init(gpio_num_t pin, uint32_t period_ms)
+{
+    ESP_RETURN_ON_FALSE(period_ms * 1000 > 2 * CLOCKSYNC_FRAME_US, ESP_ERR_INVALID_ARG,
+                        TAG, "period %lu ms too short", period_ms);
+    s_pin = pin;
+
+    if (pin != GPIO_NUM_NC) {
+        gpio_config_t io = {
+            .pin_bit_mask = 1ULL << pin,
+            .mode         = GPIO_MODE_OUTPUT,
+            .pull_up_en   = GPIO_PULLUP_DISABLE,
+            .pull_down_en = GPIO_PULLDOWN_DISABLE,
+            .intr_type    = GPIO_INTR_DISABLE,
+        };
+        ESP_RETURN_ON_ERROR(gpio_config(&io), TAG, "sync pin");
+        gpio_set_level(pin, 0);
+
+        const esp_timer_create_args_t fall_args = { .callback = fall_cb, .name = "sync_fall" };
+        ESP_RETURN_ON_ERROR(esp_timer_create(&fall_args, &s_fall_timer), TAG, "fall timer");
+    }
+
+    const esp_timer_create_args_t period_args = { .callback = period_cb, .name = "sync" };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&period_args, &s_period_timer), TAG, "period timer");
+    ESP_RETURN_ON_ERROR(esp_timer_start_periodic(s_period_timer, (uint64_t)period_ms * 1000),
+                        TAG, "start");
+
+    if (pin == GPIO_NUM_NC) {
+        ESP_LOGI(TAG, "sync markers on the event pin every %lu ms", period_ms);
+    } else {
+        ESP_LOGI(TAG, "sync pulses on GPIO%d every %lu ms", pin, period_ms);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,48 @@
+// main/clocksync.h
+#pragma once
+
+#include <stdint.h>
+#include "driver/gpio.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Clock synchronisation with the acquisition system.
+ *
+ * Every period a sync pulse goes to the acquisition system's digital input and
+ * a TLM_SYNC record carrying the esp_timer time of its rising edge goes to the
+ * host. clocksync.py pairs the two streams (or the records with the host's own
+ * receive times) and fits offset and drift.
+ *
+ * So the acquired pulses can be numbered without the host stream, their widths
+ * carry the pulse number: pulses come in frames of CLOCKSYNC_FRAME_LEN, the
+ * first CLOCKSYNC_FRAME_US wide, the next 8 the frame number mod 256 (LSB
+ * first, CLOCKSYNC_ONE_US for a 1, CLOCKSYNC_ZERO_US for a 0), the last a 0.
+ * Pulse n is then frame * CLOCKSYNC_FRAME_LEN + position.
+ *
+ * With a dedicated pin the edge time is read and the pin set inside one
+ * critical section, so it is good to about a microsecond. With
+ * GPIO_NUM_NC the pulses go out on the event pin as SYNC markers, scheduled
+ * like any other marker and timed by the RMT tx-done interrupt (event.h).
+ */
+
+#define CLOCKSYNC_ZERO_US       1000
+#define CLOCKSYNC_ONE_US        2000
+#define CLOCKSYNC_FRAME_US      3000
+#define CLOCKSYNC_FRAME_LEN     10
+
+/**
+ * @brief  Start the sync pulses.
+ * @param  pin        dedicated output, or GPIO_NUM_NC for the event pin
+ *                    (event_init_rmt() must have been called)
+ * @param  period_ms  pulse spacing; 1000 keeps drift well under 1 ms/hour
+ *                    resolvable within a few minutes
+ */
+esp_err_t clocksync_init(gpio_num_t pin, uint32_t period_ms);
+
+#ifdef __cplusplus
+}
+#endif
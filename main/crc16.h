@@ -0,0 +1,20 @@
+// main/crc16.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief  CRC-16/XMODEM (poly 0x1021, init 0, no reflection, no final xor):
+ *         the RoboClaw packet serial CRC (mcpcommands.c) and the telemetry
+ *         frame CRC (telemetry.h).
+ */
+uint16_t crc16_xmodem(const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
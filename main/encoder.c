@@ -1,66 +1,376 @@
 #include "encoder.h"
 #include <stdio.h>
-#include "driver/pcnt.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "driver/pulse_cnt.h"
 #include "driver/gpio.h"
+#include "driver/rmt_tx.h"
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_cpu.h"
 #include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
 
-#define ENC_A_GPIO   24
-#define ENC_B_GPIO   25 
-#define PCNT_UNIT    PCNT_UNIT_0
+#define ENC_A_GPIO      24
+#define ENC_B_GPIO      25 
+#define ENC_PCNT_LIMIT  30000   // hardware counter wraps to 0 at ±this value
+#define ENC_GLITCH_NS   1000    // reject edges shorter than this (legacy: 100 APB cycles)
+
+// speed test (encoder_speed_test)
+#define ENC_TEST_RES_HZ     40000000    // RMT tick 25 ns
+#define ENC_TEST_CYCLES     1000        // quadrature cycles per rate (4000 counts, no wrap)
+
+static const char *TAG = "ENCODER";
 
 //–– module-local state ––  
-static int32_t totalCount = 0;
-static int16_t lastCnt    = 0;
-static int16_t rawCnt     = 0;
+static pcnt_unit_handle_t s_unit     = NULL;
+static atomic_int         s_window   = 0;   // accumulated count at raw 0, for watch points
+static atomic_uint        s_overflow = 0;   // number of wrap events seen
+static atomic_int         s_pos      = 0;   // last encoder_sample(), what read_encoder() returns
+static int32_t            s_last     = 0;   // last sample, sampler only
+
+// threshold watch slots (the PCNT has ENCODER_WATCH_SLOTS threshold registers)
+typedef struct {
+    bool          armed;
+    int           hw_value;      // threshold translated into raw counter space
+    int32_t       pos;           // threshold in accumulated counts
+    TaskHandle_t  task;
+    uint32_t      notify_bits;
+    int64_t       t_us;          // time of the most recent crossing
+    uint32_t      hits;          // crossings since arm
+} encoder_watch_t;
+
+static encoder_watch_t s_watch[ENCODER_WATCH_SLOTS];
+static portMUX_TYPE    s_watch_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Runs when the hardware counter hits a limit and is reset to 0 by the PCNT
+// (the driver has already added the wrap to its accumulated count; s_window
+// only follows the raw counter's window for encoder_watch_arm()). Also runs when the counter hits an
+// armed threshold: timestamp it and wake the owner.
+static bool IRAM_ATTR encoder_on_reach(pcnt_unit_handle_t unit,
+                                       const pcnt_watch_event_data_t *edata,
+                                       void *user_ctx)
+{
+    int        value = edata->watch_point_value;
+    BaseType_t hp_task_woken = pdFALSE;
+
+    if (value == ENC_PCNT_LIMIT || value == -ENC_PCNT_LIMIT) {
+        atomic_fetch_add_explicit(&s_window, value, memory_order_relaxed);
+        atomic_fetch_add_explicit(&s_overflow, 1, memory_order_relaxed);
+        return false;
+    }
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&s_watch_lock);
+    for (int i = 0; i < ENCODER_WATCH_SLOTS; i++) {
+        encoder_watch_t *w = &s_watch[i];
+        if (!w->armed || w->hw_value != value) continue;
+        w->t_us = now;
+        w->hits++;
+        if (w->task) {
+            xTaskNotifyFromISR(w->task, w->notify_bits, eSetBits, &hp_task_woken);
+        }
+    }
+    portEXIT_CRITICAL_ISR(&s_watch_lock);
+    return hp_task_woken == pdTRUE;
+}
+
+// Glitch filter and x4 quadrature decoding on A/B; the encoder's unit and
+// the speed test's are set up alike. Channels are returned for deletion.
+static esp_err_t setup_quadrature(pcnt_unit_handle_t unit, int a_gpio, int b_gpio,
+                                  pcnt_channel_handle_t chan[2])
+{
+    // optional glitch filter  
+    pcnt_glitch_filter_config_t filter_cfg = {
+        .max_glitch_ns = ENC_GLITCH_NS,
+    };
+    ESP_RETURN_ON_ERROR(pcnt_unit_set_glitch_filter(unit, &filter_cfg), TAG, "glitch filter");
+
+    // channel A: A edges, B selects +/–  
+    pcnt_chan_config_t chan_a_cfg = {
+        .edge_gpio_num  = a_gpio,
+        .level_gpio_num = b_gpio,
+    };
+    ESP_RETURN_ON_ERROR(pcnt_new_channel(unit, &chan_a_cfg, &chan[0]), TAG, "channel A");
+    ESP_RETURN_ON_ERROR(pcnt_channel_set_edge_action(chan[0],
+                        PCNT_CHANNEL_EDGE_ACTION_INCREASE,      // rising A
+                        PCNT_CHANNEL_EDGE_ACTION_DECREASE), TAG, "A edges");   // falling A
+    ESP_RETURN_ON_ERROR(pcnt_channel_set_level_action(chan[0],
+                        PCNT_CHANNEL_LEVEL_ACTION_INVERSE,      // B high
+                        PCNT_CHANNEL_LEVEL_ACTION_KEEP), TAG, "A levels");     // B low
+
+    // channel B: swap A/B for full quadrature  
+    pcnt_chan_config_t chan_b_cfg = {
+        .edge_gpio_num  = b_gpio,
+        .level_gpio_num = a_gpio,
+    };
+    ESP_RETURN_ON_ERROR(pcnt_new_channel(unit, &chan_b_cfg, &chan[1]), TAG, "channel B");
+    ESP_RETURN_ON_ERROR(pcnt_channel_set_edge_action(chan[1],
+                        PCNT_CHANNEL_EDGE_ACTION_INCREASE,
+                        PCNT_CHANNEL_EDGE_ACTION_DECREASE), TAG, "B edges");
+    ESP_RETURN_ON_ERROR(pcnt_channel_set_level_action(chan[1],
+                        PCNT_CHANNEL_LEVEL_ACTION_KEEP,         // A high
+                        PCNT_CHANNEL_LEVEL_ACTION_INVERSE), TAG, "B levels");  // A low
+    return ESP_OK;
+}
 
 void init_encoder(void) {
     // pull-ups so A/B never float  
     gpio_set_pull_mode(ENC_A_GPIO, GPIO_PULLUP_ONLY);
     gpio_set_pull_mode(ENC_B_GPIO, GPIO_PULLUP_ONLY);
 
-    // channel 0: A pulses, B selects +/–  
-    pcnt_config_t cfg = {
-        .pulse_gpio_num = ENC_A_GPIO,
-        .ctrl_gpio_num  = ENC_B_GPIO,
-        .channel        = PCNT_CHANNEL_0,
-        .unit           = PCNT_UNIT,
-        .pos_mode       = PCNT_COUNT_INC,
-        .neg_mode       = PCNT_COUNT_DEC,
-        .lctrl_mode     = PCNT_MODE_KEEP,
-        .hctrl_mode     = PCNT_MODE_REVERSE,
-        .counter_h_lim  = INT16_MAX,
-        .counter_l_lim  = INT16_MIN,
+    // accum_count: the driver widens the count across wraps itself
+    pcnt_unit_config_t unit_cfg = {
+        .high_limit = ENC_PCNT_LIMIT,
+        .low_limit  = -ENC_PCNT_LIMIT,
+        .flags.accum_count = 1,
     };
-    ESP_ERROR_CHECK( pcnt_unit_config(&cfg) );
+    ESP_ERROR_CHECK( pcnt_new_unit(&unit_cfg, &s_unit) );
+    pcnt_channel_handle_t chan[2];
+    ESP_ERROR_CHECK( setup_quadrature(s_unit, ENC_A_GPIO, ENC_B_GPIO, chan) );
 
-    // channel 1: swap A/B for full quadrature  
-    cfg.channel        = PCNT_CHANNEL_1;
-    cfg.pulse_gpio_num = ENC_B_GPIO;
-    cfg.ctrl_gpio_num  = ENC_A_GPIO;
-    cfg.lctrl_mode     = PCNT_MODE_REVERSE;
-    cfg.hctrl_mode     = PCNT_MODE_KEEP;
-    ESP_ERROR_CHECK( pcnt_unit_config(&cfg) );
+    // the driver accumulates on these; the counter resets to 0 at either limit
+    ESP_ERROR_CHECK( pcnt_unit_add_watch_point(s_unit, ENC_PCNT_LIMIT) );
+    ESP_ERROR_CHECK( pcnt_unit_add_watch_point(s_unit, -ENC_PCNT_LIMIT) );
+    pcnt_event_callbacks_t cbs = {
+        .on_reach = encoder_on_reach,
+    };
+    ESP_ERROR_CHECK( pcnt_unit_register_event_callbacks(s_unit, &cbs, NULL) );
 
-    // optional glitch filter  
-    pcnt_set_filter_value(PCNT_UNIT, 100);
-    pcnt_filter_enable(PCNT_UNIT);
+    // software init  
+    atomic_store(&s_window, 0);
+    atomic_store(&s_overflow, 0);
+    atomic_store(&s_pos, 0);
+    s_last = 0;
 
     // clear & start  
-    pcnt_counter_pause (PCNT_UNIT);
-    pcnt_counter_clear (PCNT_UNIT);
-    pcnt_counter_resume(PCNT_UNIT);
+    ESP_ERROR_CHECK( pcnt_unit_enable(s_unit) );
+    ESP_ERROR_CHECK( pcnt_unit_clear_count(s_unit) );
+    ESP_ERROR_CHECK( pcnt_unit_start(s_unit) );
+}
 
-    // software init  
-    lastCnt    = 0;
-    totalCount = 0;
+int32_t encoder_sample(void) {
+    int total;
+    pcnt_unit_get_count(s_unit, &total);
+
+    // The counter may already have wrapped while its ISR (and so the driver's
+    // accumulation) is still pending; a jump of more than half the range
+    // between samples can only be that.
+    int32_t delta = total - s_last;
+    if      (delta >  ENC_PCNT_LIMIT / 2) total -= ENC_PCNT_LIMIT;
+    else if (delta < -ENC_PCNT_LIMIT / 2) total += ENC_PCNT_LIMIT;
+
+    s_last = total;
+    atomic_store_explicit(&s_pos, total, memory_order_release);
+    return total;
 }
 
 int32_t read_encoder(void) {
-    pcnt_get_counter_value(PCNT_UNIT, &rawCnt);
-    int16_t delta   = rawCnt - lastCnt;
-    totalCount     += delta;
-    lastCnt         = rawCnt;
-    return totalCount;
+    return atomic_load_explicit(&s_pos, memory_order_acquire);
+}
+
+esp_err_t encoder_watch_arm(int slot, int32_t pos, TaskHandle_t task, uint32_t notify_bits) {
+    ESP_RETURN_ON_FALSE(s_unit != NULL, ESP_ERR_INVALID_STATE, TAG, "encoder not initialized");
+    ESP_RETURN_ON_FALSE(slot >= 0 && slot < ENCODER_WATCH_SLOTS, ESP_ERR_INVALID_ARG, TAG, "bad slot %d", slot);
+
+    encoder_watch_disarm(slot);
+
+    // watch points live in raw counter space; valid until the next wrap
+    int hw = (int)(pos - atomic_load(&s_window));
+    ESP_RETURN_ON_FALSE(hw > -ENC_PCNT_LIMIT && hw < ENC_PCNT_LIMIT && hw != 0,
+                        ESP_ERR_INVALID_ARG, TAG, "threshold %ld not reachable in this counter window", (long)pos);
+    for (int i = 0; i < ENCODER_WATCH_SLOTS; i++) {
+        ESP_RETURN_ON_FALSE(!(s_watch[i].armed && s_watch[i].hw_value == hw),
+                            ESP_ERR_INVALID_STATE, TAG, "threshold %ld already armed", (long)pos);
+    }
+
+    // P4 updates thresholds at runtime (SOC_PCNT_SUPPORT_RUNTIME_THRES_UPDATE),
+    // so no counter clear is needed to make the new point take effect
+    ESP_RETURN_ON_ERROR(pcnt_unit_add_watch_point(s_unit, hw), TAG, "add watch point failed");
+
+    portENTER_CRITICAL(&s_watch_lock);
+    s_watch[slot] = (encoder_watch_t){
+        .armed       = true,
+        .hw_value    = hw,
+        .pos         = pos,
+        .task        = task,
+        .notify_bits = notify_bits,
+    };
+    portEXIT_CRITICAL(&s_watch_lock);
+    return ESP_OK;
+}
+
+esp_err_t encoder_watch_disarm(int slot) {
+    ESP_RETURN_ON_FALSE(slot >= 0 && slot < ENCODER_WATCH_SLOTS, ESP_ERR_INVALID_ARG, TAG, "bad slot %d", slot);
+    if (!s_watch[slot].armed) return ESP_OK;
+
+    portENTER_CRITICAL(&s_watch_lock);
+    s_watch[slot].armed = false;
+    int hw = s_watch[slot].hw_value;
+    portEXIT_CRITICAL(&s_watch_lock);
+    return pcnt_unit_remove_watch_point(s_unit, hw);
+}
+
+bool encoder_watch_last(int slot, int64_t *t_us) {
+    if (slot < 0 || slot >= ENCODER_WATCH_SLOTS) return false;
+    portENTER_CRITICAL(&s_watch_lock);
+    uint32_t hits = s_watch[slot].hits;
+    if (t_us) *t_us = s_watch[slot].t_us;
+    portEXIT_CRITICAL(&s_watch_lock);
+    return hits > 0;
+}
+
+uint32_t encoder_overflow_count(void) {
+    return atomic_load_explicit(&s_overflow, memory_order_relaxed);
+}
+
+esp_err_t encoder_limits(uint32_t poll_hz, encoder_limits_t *out) {
+    ESP_RETURN_ON_FALSE(s_unit != NULL, ESP_ERR_INVALID_STATE, TAG, "encoder not initialized");
+    ESP_RETURN_ON_FALSE(out != NULL && poll_hz > 0, ESP_ERR_INVALID_ARG, TAG, "bad args");
+
+    // 1) cost of a sample and of a read
+    const int n = 1000;
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    for (int i = 0; i < n; i++) (void)encoder_sample();
+    out->sample_cycles = (esp_cpu_get_cycle_count() - t0) / n;
+    t0 = esp_cpu_get_cycle_count();
+    for (int i = 0; i < n; i++) (void)read_encoder();
+    out->read_cycles = (esp_cpu_get_cycle_count() - t0) / n;
+
+    // 2) the glitch filter drops a level on A or B shorter than ENC_GLITCH_NS;
+    //    each channel holds its level for 2 counts in x4 decoding
+    out->filter_limit_cps = 2 * (1000000000u / ENC_GLITCH_NS);
+
+    // 3) wraps are counted in hardware, so the poll rate only matters for the
+    //    pending-wrap correction: it needs < ENC_PCNT_LIMIT/2 counts per poll
+    out->poll_limit_cps = (uint32_t)(ENC_PCNT_LIMIT / 2) * poll_hz;
+
+    out->max_cps = out->filter_limit_cps < out->poll_limit_cps
+                 ? out->filter_limit_cps : out->poll_limit_cps;
+    out->overflows = encoder_overflow_count();
+
+    ESP_LOGI(TAG, "sample %lu / read %lu cycles, filter limit %lu cps, poll limit %lu cps @ %lu Hz"
+                  " -> max trackable %lu counts/s (computed, not measured)",
+             (unsigned long)out->sample_cycles, (unsigned long)out->read_cycles,
+             (unsigned long)out->filter_limit_cps,
+             (unsigned long)out->poll_limit_cps, (unsigned long)poll_hz,
+             (unsigned long)out->max_cps);
+    return ESP_OK;
+}
+
+// One run of the speed test: ENC_TEST_CYCLES quadrature cycles at @p cps
+// counts/s (B lagging A by a count), started on both pins together.
+static esp_err_t speed_run(rmt_channel_handle_t tx[2], rmt_encoder_handle_t copy,
+                           pcnt_unit_handle_t unit, uint32_t cps, int *count)
+{
+    uint32_t t = ENC_TEST_RES_HZ / cps;          // ticks per count; rates divide evenly
+    ESP_RETURN_ON_FALSE(t >= 2 && t % 2 == 0 && 2 * t <= 32767, ESP_ERR_INVALID_ARG, TAG, "%lu cps out of range", (unsigned long)cps);
+    // A: high 2, low 2. B: low 1, high 2, low 1. Both 4 counts per loop.
+    const rmt_symbol_word_t sym_a[1] = {
+        { .level0 = 1, .duration0 = 2 * t, .level1 = 0, .duration1 = 2 * t },
+    };
+    const rmt_symbol_word_t sym_b[2] = {
+        { .level0 = 0, .duration0 = t,     .level1 = 1, .duration1 = 2 * t },
+        { .level0 = 0, .duration0 = t / 2, .level1 = 0, .duration1 = t / 2 },
+    };
+    rmt_transmit_config_t cfg = { .loop_count = ENC_TEST_CYCLES, .flags.eot_level = 0 };
+
+    ESP_RETURN_ON_ERROR(pcnt_unit_clear_count(unit), TAG, "clear");
+    ESP_RETURN_ON_ERROR(rmt_transmit(tx[0], copy, sym_a, sizeof(sym_a), &cfg), TAG, "A");
+    ESP_RETURN_ON_ERROR(rmt_transmit(tx[1], copy, sym_b, sizeof(sym_b), &cfg), TAG, "B");
+    int ms = (int)((uint64_t)ENC_TEST_CYCLES * 4 * 1000 / cps) + 10;
+    ESP_RETURN_ON_ERROR(rmt_tx_wait_all_done(tx[0], ms), TAG, "A done");
+    ESP_RETURN_ON_ERROR(rmt_tx_wait_all_done(tx[1], ms), TAG, "B done");
+    return pcnt_unit_get_count(unit, count);
+}
+
+esp_err_t encoder_speed_test(int a_gpio, int b_gpio, encoder_speed_t *out) {
+    ESP_RETURN_ON_FALSE(out != NULL && a_gpio >= 0 && b_gpio >= 0 && a_gpio != b_gpio,
+                        ESP_ERR_INVALID_ARG, TAG, "bad test pins %d/%d", a_gpio, b_gpio);
+    static const uint32_t rates[] = { 100000, 250000, 500000, 1000000, 1250000, 2000000, 2500000, 4000000 };
+    *out = (encoder_speed_t){ 0 };
+
+    pcnt_unit_handle_t    unit    = NULL;
+    pcnt_channel_handle_t chan[2] = { NULL, NULL };
+    rmt_channel_handle_t  tx[2]   = { NULL, NULL };
+    rmt_encoder_handle_t  copy    = NULL;
+    rmt_sync_manager_handle_t sync = NULL;
+    esp_err_t err;
+
+    // a unit like the encoder's, reading the test pins
+    pcnt_unit_config_t unit_cfg = { .high_limit = ENC_PCNT_LIMIT, .low_limit = -ENC_PCNT_LIMIT };
+    err = pcnt_new_unit(&unit_cfg, &unit);
+    if (err == ESP_OK) err = setup_quadrature(unit, a_gpio, b_gpio, chan);
+    if (err == ESP_OK) err = pcnt_unit_enable(unit);
+    if (err == ESP_OK) err = pcnt_unit_start(unit);
+
+    // the RMT drives the same pins; io_loop_back feeds them to the PCNT
+    // inside the GPIO matrix, so nothing has to be wired
+    const int pins[2] = { a_gpio, b_gpio };
+    for (int i = 0; i < 2 && err == ESP_OK; i++) {
+        rmt_tx_channel_config_t tx_cfg = {
+            .clk_src           = RMT_CLK_SRC_DEFAULT,
+            .gpio_num          = pins[i],
+            .mem_block_symbols = 48,
+            .resolution_hz     = ENC_TEST_RES_HZ,
+            .trans_queue_depth = 1,
+            .flags.io_loop_back = 1,
+        };
+        err = rmt_new_tx_channel(&tx_cfg, &tx[i]);
+        if (err == ESP_OK) err = rmt_enable(tx[i]);
+    }
+    if (err == ESP_OK) {
+        rmt_copy_encoder_config_t copy_cfg = {};
+        err = rmt_new_copy_encoder(&copy_cfg, &copy);
+    }
+    if (err == ESP_OK) {
+        // A and B start on the same RMT clock edge
+        rmt_sync_manager_config_t sync_cfg = { .tx_channel_array = tx, .array_size = 2 };
+        err = rmt_new_sync_manager(&sync_cfg, &sync);
+    }
+
+    for (size_t i = 0; err == ESP_OK && i < sizeof(rates) / sizeof(rates[0]); i++) {
+        int count = 0;
+        err = speed_run(tx, copy, unit, rates[i], &count);
+        if (err == ESP_OK) err = rmt_sync_reset(sync);
+        if (err != ESP_OK) break;
+        if (abs(count) != 4 * ENC_TEST_CYCLES) {
+            out->failed_cps   = rates[i];
+            out->failed_count = count;
+            break;
+        }
+        out->passed_cps = rates[i];
+    }
+
+    if (sync) rmt_del_sync_manager(sync);
+    if (copy) rmt_del_encoder(copy);
+    for (int i = 0; i < 2; i++) {
+        if (tx[i]) {
+            rmt_disable(tx[i]);
+            rmt_del_channel(tx[i]);
+        }
+    }
+    if (unit) {
+        pcnt_unit_stop(unit);
+        pcnt_unit_disable(unit);
+        for (int i = 0; i < 2; i++) {
+            if (chan[i]) pcnt_del_channel(chan[i]);
+        }
+        pcnt_del_unit(unit);
+    }
+    gpio_reset_pin(a_gpio);
+    gpio_reset_pin(b_gpio);
+    ESP_RETURN_ON_ERROR(err, TAG, "speed test");
+
+    if (out->failed_cps) {
+        ESP_LOGW(TAG, "speed test: counted exactly up to %lu counts/s; at %lu got %d of %d",
+                 (unsigned long)out->passed_cps, (unsigned long)out->failed_cps,
+                 (int)out->failed_count, 4 * ENC_TEST_CYCLES);
+    } else {
+        ESP_LOGI(TAG, "speed test: every count at up to %lu counts/s", (unsigned long)out->passed_cps);
+    }
+    return ESP_OK;
 }
 
 // debugging task to read the encoder counts. Not necessary if you have the readout of the encoder counts
@@ -2,15 +2,64 @@
 #define ENCODER_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#define ENCODER_WATCH_SLOTS  2   // PCNT threshold registers per unit
+
+typedef struct {
+    uint32_t sample_cycles;     // mean CPU cycles per encoder_sample()
+    uint32_t read_cycles;       // mean CPU cycles per read_encoder()
+    uint32_t filter_limit_cps;  // fastest count rate the glitch filter passes
+    uint32_t poll_limit_cps;    // fastest rate the wrap correction tolerates at poll_hz
+    uint32_t max_cps;           // max trackable speed: min of the two limits
+    uint32_t overflows;         // hardware wrap events accumulated so far
+} encoder_limits_t;
+
+typedef struct {
+    uint32_t passed_cps;        // fastest test rate counted exactly (0: none)
+    uint32_t failed_cps;        // first rate that miscounted (0: none did)
+    int32_t  failed_count;      // ... and what it counted (of 4000)
+} encoder_speed_t;
+
 // Call once at startup to wire up PCNT for your A/B pins.
 void init_encoder(void);
 
-// Returns the 32-bit accumulated count (can be +/–).
+// Reads the counter and returns the 32-bit accumulated count (can be +/–).
+// The pulse_cnt driver accumulates hardware wraps (accum_count), so the
+// sample rate no longer limits speed. Single caller at a time: the rtexec
+// input stage, or whoever drives the motor while it is stopped (friction.c).
+int32_t encoder_sample(void);
+
+// The last encoder_sample(): one atomic load, no driver call.
 int32_t read_encoder(void);
 
+// Arm a PCNT watch point at accumulated count `pos`. When the counter reaches
+// it, the ISR records a µs timestamp and sets `notify_bits` on `task` with
+// xTaskNotifyFromISR(eSetBits). Fires on reaching the value from either side.
+esp_err_t encoder_watch_arm(int slot, int32_t pos, TaskHandle_t task, uint32_t notify_bits);
+esp_err_t encoder_watch_disarm(int slot);
+
+// Timestamp of the latest crossing on `slot`; false if it has not fired since arming.
+bool encoder_watch_last(int slot, int64_t *t_us);
+
+// Number of ±limit wraps the watch-point callback has accumulated.
+uint32_t encoder_overflow_count(void);
+
+// Measure the sample and read cost, and work out the max trackable speed at
+// poll_hz from the glitch filter and wrap-correction limits. Arithmetic on
+// the configuration, not a test of counting at speed (encoder_speed_test is).
+esp_err_t encoder_limits(uint32_t poll_hz, encoder_limits_t *out);
+
+// Speed self-test: the RMT drives a quadrature signal out of two unconnected
+// pins, looped back inside the GPIO matrix into a second PCNT unit set up
+// like the encoder's (same glitch filter), at rising rates up to 4 M counts/s.
+// Stops at the first rate that loses a count. Takes 2 RMT TX channels and a
+// PCNT unit for a few tens of ms, then frees them.
+esp_err_t encoder_speed_test(int a_gpio, int b_gpio, encoder_speed_t *out);
+
 // Optional: a FreeRTOS task that samples and (optionally) prints.
 // If you want the sampling & printing inside the module, expose this.
 void encoder_task(void *arg);
@@ -8,7 +8,7 @@
 // Simple task: Read encoder, write to DAC
 void encoder_to_dac_task(void *pv) {
     while (1) {
-        int32_t encoder_val = read_encoder();
+        int32_t encoder_val = encoder_sample();
         printf("Encoder: %ld\n", encoder_val);
         encoder_out_update(200);
         vTaskDelay(pdMS_TO_TICKS(5));
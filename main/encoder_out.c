@@ -1,54 +1,44 @@
 #include "encoder_out.h"
-#include "driver/i2c.h"
+#include "driver/i2c_master.h"
+#include "esp_check.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <math.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include "encoder.h"
 
-#define I2C_MASTER_NUM              I2C_NUM_0
+#define I2C_MASTER_PORT             I2C_NUM_0
 #define I2C_MASTER_SDA_IO           32
 #define I2C_MASTER_SCL_IO           36
-#define I2C_MASTER_FREQ_HZ          100000
-#define I2C_MASTER_TX_BUF_DISABLE   0
-#define I2C_MASTER_RX_BUF_DISABLE   0
+#define I2C_MASTER_FREQ_HZ          400000   // 1000000 also works with short wiring
+#define I2C_XFER_TIMEOUT_MS         2
 
 #define MCP4725_ADDR                0x62
-#define MCP4725_CMD_WRITEDAC        0x40
+#define MCP4725_FAST_WRITE(dac)     ((uint8_t)(((dac) >> 8) & 0x0F))   // C2=C1=0, PD1=PD0=0, D11–D8
 
 #define ENCODER_MAX_RANGE           200
 
-static const char *TAG = "ENCODER_OUT";
+#define DAC_TASK_PRIO               4
+#define DAC_TASK_CORE               1        // keep I2C off the control-loop core
+#define DAC_STATS_PERIOD_US         10000000 // log rate/latency every 10 s
 
-esp_err_t encoder_out_init(void) {
-    i2c_config_t conf = {
-        .mode             = I2C_MODE_MASTER,
-        .sda_io_num       = I2C_MASTER_SDA_IO,
-        .scl_io_num       = I2C_MASTER_SCL_IO,
-        .sda_pullup_en    = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en    = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = I2C_MASTER_FREQ_HZ
-    };
-    esp_err_t ret;
-
-    ret = i2c_param_config(I2C_MASTER_NUM, &conf);
-    if (ret != ESP_OK) {
-        printf("I2C param config error: %d\n", ret);
-        return ret;
-    }
+static const char *TAG = "ENCODER_OUT";
 
-    ret = i2c_driver_install(I2C_MASTER_NUM, conf.mode,
-                             I2C_MASTER_RX_BUF_DISABLE,
-                             I2C_MASTER_TX_BUF_DISABLE, 0);
-    // if (ret != ESP_OK) {
-    //     printf("I2C driver install error: %d\n", ret);
-    //     return ret;
-    // }
-    // printf("SDA: %d, SCL: %d, FREQ: %d\n", I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO, I2C_MASTER_FREQ_HZ);
+static i2c_master_bus_handle_t s_bus  = NULL;
+static i2c_master_dev_handle_t s_dev  = NULL;
+static TaskHandle_t            s_task = NULL;
 
-    // printf("I2C initialized for MCP4725\n");
-    return ESP_OK;
-}
+// latest-value-wins mailbox: producers overwrite, the DAC task takes the newest
+static atomic_int              s_mail_val;
+static atomic_bool             s_mail_full;
+static volatile int64_t        s_mail_t_us;
+static atomic_uint             s_overwritten;
 
+static encoder_out_stats_t     s_stats;
+static portMUX_TYPE            s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
 
 static uint16_t scale_encoder_to_dac(int32_t encoder_val) { //  scale the voltage so we can read it on an analog in port on intan
     encoder_val = fminf(fmaxf(encoder_val, -ENCODER_MAX_RANGE),
@@ -57,27 +47,121 @@ static uint16_t scale_encoder_to_dac(int32_t encoder_val) { //  scale the voltag
     return (uint16_t)((shifted * 4095) / (2 * ENCODER_MAX_RANGE));
 }
 
-// rename to take *no* argument, and read from the encoder module directly
-esp_err_t encoder_out_update(int32_t encoder_val) {
-    
-    uint16_t dac = scale_encoder_to_dac(encoder_val);
+static void dac_task(void *pv)
+{
+    int64_t  window_start  = esp_timer_get_time();
+    uint32_t window_writes = 0;
+    uint64_t lat_sum_us    = 0;
 
-    uint8_t packet[3] = {
-        MCP4725_CMD_WRITEDAC,
-        (uint8_t)(dac >> 4),                     // D11–D4
-        (uint8_t)((dac & 0x0F) << 4)             // D3–D0
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!atomic_exchange(&s_mail_full, false)) continue;
+
+        int32_t  val    = atomic_load(&s_mail_val);
+        int64_t  posted = s_mail_t_us;
+        uint16_t dac    = scale_encoder_to_dac(val);
+
+        // MCP4725 fast-write: 2 bytes, no command byte
+        uint8_t packet[2] = {
+            MCP4725_FAST_WRITE(dac),                 // 0 0 PD1 PD0 D11–D8
+            (uint8_t)(dac & 0xFF)                    // D7–D0
+        };
+
+        int64_t   t0  = esp_timer_get_time();
+        esp_err_t ret = i2c_master_transmit(s_dev, packet, sizeof(packet), I2C_XFER_TIMEOUT_MS);
+        int64_t   t1  = esp_timer_get_time();
+        uint32_t  lat = (uint32_t)(t1 - t0);
+
+        portENTER_CRITICAL(&s_stats_lock);
+        if (ret == ESP_OK) {
+            s_stats.writes++;
+            if (s_stats.lat_min_us == 0 || lat < s_stats.lat_min_us) s_stats.lat_min_us = lat;
+            if (lat > s_stats.lat_max_us) s_stats.lat_max_us = lat;
+            uint32_t age = (uint32_t)(t1 - posted);
+            if (age > s_stats.age_max_us) s_stats.age_max_us = age;
+        } else {
+            s_stats.errors++;
+        }
+        portEXIT_CRITICAL(&s_stats_lock);
+
+        if (ret == ESP_OK) {
+            window_writes++;
+            lat_sum_us += lat;
+        }
+
+        int64_t span = t1 - window_start;
+        if (span >= DAC_STATS_PERIOD_US) {
+            portENTER_CRITICAL(&s_stats_lock);
+            s_stats.rate_hz     = (uint32_t)((uint64_t)window_writes * 1000000 / span);
+            s_stats.lat_mean_us = window_writes ? (uint32_t)(lat_sum_us / window_writes) : 0;
+            encoder_out_stats_t snap = s_stats;
+            portEXIT_CRITICAL(&s_stats_lock);
+            snap.overwritten = atomic_load_explicit(&s_overwritten, memory_order_relaxed);
+
+            ESP_LOGI(TAG, "%lu Hz, write %lu/%lu/%lu us (min/mean/max), age max %lu us, %lu overwritten, %lu errors",
+                     (unsigned long)snap.rate_hz, (unsigned long)snap.lat_min_us,
+                     (unsigned long)snap.lat_mean_us, (unsigned long)snap.lat_max_us,
+                     (unsigned long)snap.age_max_us, (unsigned long)snap.overwritten,
+                     (unsigned long)snap.errors);
+            window_start  = t1;
+            window_writes = 0;
+            lat_sum_us    = 0;
+        }
+    }
+}
+
+esp_err_t encoder_out_init(void) {
+    i2c_master_bus_config_t bus_cfg = {
+        .i2c_port          = I2C_MASTER_PORT,
+        .sda_io_num        = I2C_MASTER_SDA_IO,
+        .scl_io_num        = I2C_MASTER_SCL_IO,
+        .clk_source        = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags = { .enable_internal_pullup = true },
     };
-    // printf("i2c_master_write_to_device: port=%d, addr=0x%02X, buf_size=%d\n",
-    //    I2C_MASTER_NUM, MCP4725_ADDR, sizeof(packet));
-
-    esp_err_t ret = i2c_master_write_to_device(
-        I2C_MASTER_NUM,
-        MCP4725_ADDR,
-        packet, sizeof(packet),
-        pdMS_TO_TICKS(10) // time out after 10ms
-    );
-    if (ret != ESP_OK) {
-        printf("I2C error: %d\n", ret);
+    ESP_RETURN_ON_ERROR(i2c_new_master_bus(&bus_cfg, &s_bus), TAG, "I2C bus init failed");
+
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address  = MCP4725_ADDR,
+        .scl_speed_hz    = I2C_MASTER_FREQ_HZ,
+    };
+    ESP_RETURN_ON_ERROR(i2c_master_bus_add_device(s_bus, &dev_cfg, &s_dev), TAG, "MCP4725 add failed");
+
+    if (i2c_master_probe(s_bus, MCP4725_ADDR, 10) != ESP_OK) {
+        ESP_LOGW(TAG, "MCP4725 not answering at 0x%02X", MCP4725_ADDR);
     }
-    return ret;
+
+    atomic_store(&s_mail_full, false);
+    atomic_store(&s_overwritten, 0);
+    s_stats = (encoder_out_stats_t){ 0 };
+
+    BaseType_t ok = xTaskCreatePinnedToCore(dac_task, "dac", 3072, NULL,
+                                            DAC_TASK_PRIO, &s_task, DAC_TASK_CORE);
+    ESP_RETURN_ON_FALSE(ok == pdPASS, ESP_ERR_NO_MEM, TAG, "DAC task create failed");
+
+    ESP_LOGI(TAG, "MCP4725 on I2C%d @ %d Hz (SDA %d, SCL %d)",
+             I2C_MASTER_PORT, I2C_MASTER_FREQ_HZ, I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO);
+    return ESP_OK;
+}
+
+// Post the latest count; never blocks. A value the DAC task has not picked
+// up yet is simply replaced.
+esp_err_t encoder_out_update(int32_t encoder_val) {
+    if (s_task == NULL) return ESP_ERR_INVALID_STATE;
+
+    atomic_store(&s_mail_val, encoder_val);
+    s_mail_t_us = esp_timer_get_time();
+    if (atomic_exchange(&s_mail_full, true)) {
+        atomic_fetch_add_explicit(&s_overwritten, 1, memory_order_relaxed);
+    }
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+void encoder_out_get_stats(encoder_out_stats_t *out) {
+    portENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+    out->overwritten = atomic_load_explicit(&s_overwritten, memory_order_relaxed);
 }
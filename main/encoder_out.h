@@ -7,12 +7,26 @@
 extern "C" {
 #endif
 
-// Call once at startup
+typedef struct {
+    uint32_t writes;        // successful DAC updates
+    uint32_t errors;        // failed/timed-out I2C writes
+    uint32_t overwritten;   // mailbox values replaced before they were written
+    uint32_t rate_hz;       // achieved update rate over the last stats window
+    uint32_t lat_min_us;    // I2C write time
+    uint32_t lat_mean_us;   //   (mean over the last stats window)
+    uint32_t lat_max_us;
+    uint32_t age_max_us;    // worst post-to-DAC delay
+} encoder_out_stats_t;
+
+// Call once at startup: I2C master bus + MCP4725 device + DAC writer task
 esp_err_t encoder_out_init(void);
 
-// Call whenever you have an updated encoder count
+// Call whenever you have an updated encoder count (non-blocking, latest value wins)
 esp_err_t encoder_out_update(int32_t encoder_val);
 
+// Snapshot of the DAC write statistics
+void encoder_out_get_stats(encoder_out_stats_t *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,72 +1,341 @@
 // main/event.c
 #include "event.h"
+#include <stdatomic.h>
+#include <string.h>
 #include "driver/rmt_tx.h"
 #include "esp_check.h"
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "journal.h"
+#include "telemetry.h"
 
 static const char *TAG = "EVENT";
 
+#define EVENT_TX_DEPTH      8       // markers queued in the RMT driver
+#define EVENT_DURATION_MAX  32767   // rmt_symbol_word_t durations are 15 bits
+#define EVENT_LEAD_US       100     // low before each width pulse, so queued pulses never merge
+#define EVENT_WIDTH_SYMBOLS 6       // lead + 160 ms at 1.6 MHz: 9 halves
+#define EVENT_LEAD_BITS     3       // low bits before a word's start bit
+#define EVENT_WORD_SYMBOLS  ((2 + EVENT_WORD_BITS + 1) / 2)   // lead run, start bit, data
+
+// One marker handed to the driver, from submit until its tx-done interrupt
+typedef struct {
+    const rmt_symbol_word_t *sym;
+    uint8_t  nsym;
+    uint8_t  state;
+    uint8_t  seq;
+    uint8_t  flags;         // EVENT_MK_*
+    uint32_t trial;
+    uint32_t dur_us;        // whole transmission, lead included
+    uint32_t lead_us;       // transmission start to the marker's first rising edge
+    int64_t  t_req;         // when the marker was asked for
+    int64_t  t_sched;       // when it was expected to start on the wire
+    rmt_symbol_word_t word[EVENT_WORD_SYMBOLS];   // word encoding: the driver reads it in place
+} ev_slot_t;
+
 // RMT hardware handles
 static rmt_channel_handle_t   s_tx_chan   = NULL;
 static rmt_encoder_handle_t   s_copy_enc  = NULL;
 static gpio_num_t             s_pin       = GPIO_NUM_NC;
+static uint32_t               s_res_hz;
 
 // Queue for event markers
 static QueueHandle_t          s_event_queue = NULL;
 static TaskHandle_t           s_event_task_handle = NULL;
 
-// Pre-computed RMT symbols for each event state
-static rmt_symbol_word_t      s_event_symbols[EVENT_STATE_COUNT];
-
-// Pulse widths (in RMT ticks at 10MHz = 0.1µs resolution)
-// Converting from microseconds to 0.1µs ticks (multiply by 10)
-static const uint32_t EVENT_WIDTH_TICKS[EVENT_STATE_COUNT] = {
-    [INIT]     =  100000,   // 10000µs = 100000 ticks
-    [CUE_0]    =  300000,   // 30000µs = 300000 ticks
-    [CUE_1]    =  400000,   // 40000µs = 400000 ticks
-    [CUE_2]    =  500000,   // 50000µs = 500000 ticks
-    [CUE_3]    =  600000,   // 60000µs = 600000 ticks
-    [MOVING]   =  160000,   // 16000µs = 160000 ticks
-    [REWARD_0] =  700000,   // 70000µs = 700000 ticks
-    [REWARD_1] =  800000,   // 80000µs = 800000 ticks
-    [REWARD_2] =  900000,   // 90000µs = 900000 ticks
-    [REWARD_3] = 1000000,   // 100000µs = 1000000 ticks
-    [TIMEOUT]  = 1600000,   // 160000µs = 1600000 ticks
-    [RESET]    =  120000    // 12000µs = 120000 ticks
+// Marker scheduler. One sender at a time (trial task via sm_enter, or
+// event_marker_task) under s_tx_lock; the tx-done ISR retires slots in order.
+// Retiring (advancing s_done) is under s_retire_lock, shared by the ISR and
+// preempt(), so a slot is reported once whichever of them gets it.
+static SemaphoreHandle_t      s_tx_lock;
+static portMUX_TYPE           s_retire_lock = portMUX_INITIALIZER_UNLOCKED;
+static event_encoding_t       s_encoding = EVENT_ENC_WIDTH;
+static event_policy_t         s_policy[EVENT_STATE_COUNT];   // EVENT_DEFER unless set
+static ev_slot_t              s_slot[EVENT_TX_DEPTH];
+static ev_slot_t              s_requeue[EVENT_TX_DEPTH];
+static uint32_t               s_sent;           // slots handed to the driver
+static _Atomic uint32_t       s_done;           // ... and retired
+static int64_t                s_free_at;        // when the channel is expected to go idle
+static uint8_t                s_seq;
+static uint32_t               s_last_trial;
+static event_stats_t          s_stats;
+
+// Last edge of each state that reached the pin (stimulus commits read it back)
+static portMUX_TYPE           s_edge_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct { int64_t t; uint32_t trial; } s_edge[EVENT_STATE_COUNT];
+
+// Pre-computed RMT symbols for each event state (width encoding)
+static rmt_symbol_word_t      s_event_symbols[EVENT_STATE_COUNT][EVENT_WIDTH_SYMBOLS];
+static uint8_t                s_event_nsym[EVENT_STATE_COUNT];
+static uint32_t               s_event_dur_us[EVENT_STATE_COUNT];
+static uint32_t               s_lead_us, s_word_dur_us, s_word_lead_us;
+
+// Pulse widths in µs (width encoding)
+static const uint32_t EVENT_WIDTH_US[EVENT_STATE_COUNT] = {
+    [INIT]     =  10000,
+    [CUE_0]    =  30000,
+    [CUE_1]    =  40000,
+    [CUE_2]    =  50000,
+    [CUE_3]    =  60000,
+    [MOVING]   =  16000,
+    [REWARD_0] =  70000,
+    [REWARD_1] =  80000,
+    [REWARD_2] =  90000,
+    [REWARD_3] = 100000,
+    [TIMEOUT]  = 160000,
+    [RESET]    =  12000,
+    [SYNC_0]   =   1000,
+    [SYNC_1]   =   2000,
+    [SYNC_FRAME] = 3000
 };
 
+uint8_t event_word_crc4(uint32_t data28)
+{
+    // CRC-4/ITU (x^4 + x + 1, init 0) over the 28 bits above the check field
+    uint8_t crc = 0;
+    for (int i = 27; i >= 0; i--) {
+        uint8_t in = ((data28 >> i) & 1) ^ (crc >> 3);
+        crc = (uint8_t)((crc << 1) & 0xF);
+        if (in) crc ^= 0x3;
+    }
+    return crc;
+}
+
+uint32_t event_word_pack(event_state_t st, uint32_t trial, uint8_t seq)
+{
+    uint32_t w = ((uint32_t)st & 0x1F) << 27
+               | (trial & 0xFFFF) << 11
+               | ((uint32_t)seq & 0x7F) << 4;
+    return w | event_word_crc4(w >> 4);
+}
+
+// Builds a symbol list from (level, ticks) runs, two halves per symbol, runs
+// longer than a 15-bit half split across several halves.
+typedef struct {
+    rmt_symbol_word_t *sym;
+    int max, n, half;
+} sym_writer_t;
+
+static bool sym_put(sym_writer_t *w, uint32_t level, uint32_t ticks)
+{
+    while (ticks > 0) {
+        uint32_t d = ticks > EVENT_DURATION_MAX ? EVENT_DURATION_MAX : ticks;
+        ticks -= d;
+        if (w->half == 0) {
+            if (w->n == w->max) return false;
+            w->sym[w->n] = (rmt_symbol_word_t){ .level0 = level, .duration0 = d };
+            w->half = 1;
+        } else {
+            w->sym[w->n].level1    = level;
+            w->sym[w->n].duration1 = d;
+            w->n++;
+            w->half = 0;
+        }
+    }
+    return true;
+}
+
+static int sym_finish(sym_writer_t *w)
+{
+    if (w->half) {                      // 1-tick low closes an odd run count
+        w->sym[w->n].level1    = 0;
+        w->sym[w->n].duration1 = 1;
+        w->n++;
+        w->half = 0;
+    }
+    return w->n;
+}
+
+static int build_word(rmt_symbol_word_t *sym, uint32_t word)
+{
+    const uint32_t t = s_res_hz / (1000000 / EVENT_WORD_BIT_US);
+    sym_writer_t   w = { .sym = sym, .max = EVENT_WORD_SYMBOLS };
+
+    sym_put(&w, 0, EVENT_LEAD_BITS * t);
+    sym_put(&w, 1, t);                                  // start bit
+    for (int i = EVENT_WORD_BITS - 1; i >= 0; i--) {
+        sym_put(&w, (word >> i) & 1, t);
+    }
+    return sym_finish(&w);
+}
+
+static uint32_t ticks_to_us(uint64_t ticks)
+{
+    return (uint32_t)(ticks * 1000000 / s_res_hz);
+}
+
+// Emission record for a retired slot: t is the marker's first rising edge
+// (0 if it never reached the pin).
+static void report(const ev_slot_t *e, int64_t t, uint8_t extra)
+{
+    int64_t late = t ? t - (e->t_req + e->lead_us) : 0;
+    if (late < 0) late = 0;
+    if ((uint32_t)late > s_stats.max_late_us) s_stats.max_late_us = (uint32_t)late;
+    telemetry_marker(t, e->trial, e->state, e->seq, e->flags | extra, (uint32_t)late);
+    if (t == 0) return;
+    journal_post(t, JR_MARKER, e->state, (uint16_t)e->trial);
+    portENTER_CRITICAL_SAFE(&s_edge_lock);
+    s_edge[e->state].t     = t;
+    s_edge[e->state].trial = e->trial;
+    portEXIT_CRITICAL_SAFE(&s_edge_lock);
+}
+
+static bool tx_done_cb(rmt_channel_handle_t chan, const rmt_tx_done_event_data_t *edata, void *ctx)
+{
+    // Retirements are in submit order. The hardware timed the transmission,
+    // so its start is exactly dur_us before now (plus this ISR's latency).
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL_ISR(&s_retire_lock);
+    uint32_t done = atomic_load_explicit(&s_done, memory_order_relaxed);
+    if (done != s_sent) {               // else preempt() already retired it
+        const ev_slot_t *e = &s_slot[done % EVENT_TX_DEPTH];
+        report(e, now - e->dur_us + e->lead_us, 0);
+        atomic_store_explicit(&s_done, done + 1, memory_order_release);
+    }
+    portEXIT_CRITICAL_ISR(&s_retire_lock);
+    return false;
+}
+
+// Queue a filled slot on the channel, behind whatever is already there.
+static esp_err_t submit(ev_slot_t *e, int64_t now)
+{
+    if (s_sent - atomic_load_explicit(&s_done, memory_order_acquire) >= EVENT_TX_DEPTH) {
+        return ESP_ERR_TIMEOUT;
+    }
+    ev_slot_t *slot = &s_slot[s_sent % EVENT_TX_DEPTH];   // retired, so not in flight
+    if (slot != e) *slot = *e;
+    if (s_encoding == EVENT_ENC_WORD) slot->sym = slot->word;
+
+    bool busy = s_sent != atomic_load_explicit(&s_done, memory_order_acquire);
+    slot->t_sched = busy && s_free_at > now ? s_free_at : now;
+
+    rmt_transmit_config_t cfg = {
+        .loop_count = 0,
+        .flags = { .eot_level = 0, .queue_nonblocking = 1 }
+    };
+    esp_err_t err = rmt_transmit(s_tx_chan, s_copy_enc, slot->sym,
+                                 slot->nsym * sizeof(rmt_symbol_word_t), &cfg);
+    if (err == ESP_OK) {
+        s_free_at = slot->t_sched + slot->dur_us;
+        portENTER_CRITICAL(&s_retire_lock);
+        s_sent++;
+        portEXIT_CRITICAL(&s_retire_lock);
+    }
+    return err;
+}
+
+// Abort what is on the wire and flush the driver queue. The marker being sent
+// is reported truncated; the ones behind it never started and are returned in
+// s_requeue to go out again after the preempting marker. A marker that
+// finished while the channel was being stopped has been reported by the ISR.
+static int preempt(int64_t now)
+{
+    rmt_disable(s_tx_chan);             // stops the transmission, drops the queue
+
+    // Everything still outstanding is retired here in one step, so the ISR
+    // (already past rmt_disable, or spinning on the lock) finds nothing left.
+    portENTER_CRITICAL(&s_retire_lock);
+    uint32_t done = atomic_load_explicit(&s_done, memory_order_relaxed);
+    int      n    = 0;
+    for (uint32_t i = done; i != s_sent; i++) {
+        s_requeue[n++] = s_slot[i % EVENT_TX_DEPTH];
+    }
+    atomic_store_explicit(&s_done, s_sent, memory_order_release);
+    portEXIT_CRITICAL(&s_retire_lock);
+
+    if (n > 0) {
+        ev_slot_t *e = &s_requeue[0];
+        int64_t    t = e->t_sched + e->lead_us;
+        if (t <= now) {
+            report(e, t, EVENT_MK_TRUNCATED);
+            s_stats.truncated++;
+            memmove(&s_requeue[0], &s_requeue[1], --n * sizeof(s_requeue[0]));
+        }
+        // else still in its lead: it never reached the pin and goes out again
+    }
+    s_free_at = now;
+    rmt_enable(s_tx_chan);
+    return n;
+}
+
+static esp_err_t transmit(event_state_t st, uint32_t trial)
+{
+    if (xSemaphoreTake(s_tx_lock, 1) != pdTRUE) {
+        s_stats.dropped++;
+        return ESP_ERR_TIMEOUT;
+    }
+    int64_t   now = esp_timer_get_time();
+    ev_slot_t mk  = {
+        .state = st, .seq = s_seq, .trial = trial, .t_req = now,
+    };
+    if (s_encoding == EVENT_ENC_WORD) {
+        mk.nsym    = build_word(mk.word, event_word_pack(st, trial, s_seq));
+        mk.dur_us  = s_word_dur_us;
+        mk.lead_us = s_word_lead_us;
+    } else {
+        mk.sym     = s_event_symbols[st];
+        mk.nsym    = s_event_nsym[st];
+        mk.dur_us  = s_event_dur_us[st];
+        mk.lead_us = s_lead_us;
+    }
+    s_seq = (s_seq + 1) & 0x7F;
+
+    int n_requeue = 0;
+    if (s_sent != atomic_load_explicit(&s_done, memory_order_acquire)) {
+        s_stats.overlaps++;
+        if (s_policy[st] == EVENT_PREEMPT) {
+            s_stats.preempted++;
+            mk.flags |= EVENT_MK_PREEMPTED;
+            n_requeue = preempt(now);
+        } else {
+            s_stats.deferred++;
+            mk.flags |= EVENT_MK_DEFERRED;
+        }
+    }
+
+    esp_err_t err = submit(&mk, now);
+    if (err == ESP_OK) {
+        s_stats.sent++;
+    } else {
+        s_stats.dropped++;
+        report(&mk, 0, EVENT_MK_DROPPED);
+    }
+    for (int i = 0; i < n_requeue; i++) {
+        s_requeue[i].flags |= EVENT_MK_DEFERRED;
+        if (submit(&s_requeue[i], now) != ESP_OK) {
+            s_stats.dropped++;
+            report(&s_requeue[i], 0, EVENT_MK_DROPPED);
+        }
+    }
+    xSemaphoreGive(s_tx_lock);
+    return err;
+}
+
 // High-priority task dedicated to sending event markers
 static void event_marker_task(void *pvParameters)
 {
     event_state_t state;
-    
+
     ESP_LOGI(TAG, "Event marker task started on core %d", xPortGetCoreID());
-    
+
     while (1) {
         // Wait for event state from queue
         if (xQueueReceive(s_event_queue, &state, portMAX_DELAY) == pdTRUE) {
-            
+
             // Validate state
             if (state >= EVENT_STATE_COUNT) {
                 ESP_LOGW(TAG, "Invalid event state: %d", state);
                 continue;
             }
-            
-            // Send the pre-computed symbol immediately
-            rmt_transmit_config_t cfg = {
-                .loop_count = 0,
-                .flags = { .eot_level = 0 }
-            };
-            
-            esp_err_t ret = rmt_transmit(s_tx_chan, s_copy_enc, 
-                                       &s_event_symbols[state], 
-                                       sizeof(rmt_symbol_word_t), 
-                                       &cfg);
-            
+
+            esp_err_t ret = transmit(state, s_last_trial);
+
             if (ret != ESP_OK) {
                 ESP_LOGW(TAG, "Failed to send event %d: %s", state, esp_err_to_name(ret));
             }
@@ -76,46 +345,57 @@ static void event_marker_task(void *pvParameters)
 
 esp_err_t event_init_rmt(gpio_num_t pin, uint32_t resolution_hz)
 {
-    s_pin = pin;
-    
-    // Override resolution for optimal timing (10MHz = 0.1µs resolution)
-    const uint32_t optimal_resolution = 10000000;
-    
-    // 1) Create TX channel with optimized settings
+    ESP_RETURN_ON_FALSE(resolution_hz >= 1000000 / EVENT_WORD_BIT_US && resolution_hz <= 1600000,
+                        ESP_ERR_INVALID_ARG, TAG, "resolution %lu Hz out of range", resolution_hz);
+    s_pin    = pin;
+    s_res_hz = resolution_hz;
+
+    // 1) Create TX channel; a few markers may queue behind one on the wire
     rmt_tx_channel_config_t tx_cfg = {
         .clk_src           = RMT_CLK_SRC_DEFAULT,
         .gpio_num          = pin,
         .mem_block_symbols = 48,                 // Minimal memory allocation
-        .resolution_hz     = optimal_resolution, // 10MHz for 0.1µs precision
-        .trans_queue_depth = 1,                 // Minimal queue depth
+        .resolution_hz     = resolution_hz,
+        .trans_queue_depth = EVENT_TX_DEPTH,
         .flags = { .invert_out = false, .with_dma = false }
     };
-    
+
     ESP_RETURN_ON_ERROR(rmt_new_tx_channel(&tx_cfg, &s_tx_chan), TAG, "rmt_new_tx_channel failed");
+    rmt_tx_event_callbacks_t cbs = { .on_trans_done = tx_done_cb };
+    ESP_RETURN_ON_ERROR(rmt_tx_register_event_callbacks(s_tx_chan, &cbs, NULL), TAG, "tx callbacks");
     ESP_RETURN_ON_ERROR(rmt_enable(s_tx_chan), TAG, "rmt_enable failed");
-    
+
     // 2) Create copy encoder
     rmt_copy_encoder_config_t copy_cfg = {};
     ESP_RETURN_ON_ERROR(rmt_new_copy_encoder(&copy_cfg, &s_copy_enc),
                         TAG, "rmt_new_copy_encoder failed");
-    
-    // 3) Pre-compute all RMT symbols for zero-overhead transmission
+
+    // 3) Pre-compute the width-encoding symbols
+    s_lead_us = EVENT_LEAD_US;
     for (int i = 0; i < EVENT_STATE_COUNT; i++) {
-        s_event_symbols[i] = (rmt_symbol_word_t){
-            .level0    = 1,                      // High pulse
-            .duration0 = EVENT_WIDTH_TICKS[i],   // Event-specific duration
-            .level1    = 0,                      // Low level
-            .duration1 = 1                       // Minimal low duration (0.1µs)
-        };
-    }
-    
+        uint64_t     lead  = (uint64_t)EVENT_LEAD_US * resolution_hz / 1000000;
+        uint64_t     ticks = (uint64_t)EVENT_WIDTH_US[i] * resolution_hz / 1000000;
+        sym_writer_t w     = { .sym = s_event_symbols[i], .max = EVENT_WIDTH_SYMBOLS };
+        bool ok = sym_put(&w, 0, (uint32_t)lead) && sym_put(&w, 1, (uint32_t)ticks);
+        ESP_RETURN_ON_FALSE(ok, ESP_ERR_INVALID_ARG,
+                            TAG, "event %d too long at %lu Hz", i, resolution_hz);
+        s_event_nsym[i]   = sym_finish(&w);
+        s_event_dur_us[i] = ticks_to_us(lead + ticks);
+    }
+    uint32_t bit = resolution_hz / (1000000 / EVENT_WORD_BIT_US);
+    s_word_lead_us = ticks_to_us((uint64_t)EVENT_LEAD_BITS * bit);
+    s_word_dur_us  = ticks_to_us((uint64_t)(EVENT_LEAD_BITS + 1 + EVENT_WORD_BITS) * bit);
+
+    s_tx_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_tx_lock != NULL, ESP_ERR_NO_MEM, TAG, "tx lock");
+
     // 4) Create event queue (small size for low latency)
     s_event_queue = xQueueCreate(8, sizeof(event_state_t));
     if (s_event_queue == NULL) {
         ESP_LOGE(TAG, "Failed to create event queue");
         return ESP_ERR_NO_MEM;
     }
-    
+
     // 5) Create high-priority event marker task pinned to core 1
     BaseType_t task_ret = xTaskCreatePinnedToCore(
         event_marker_task,
@@ -126,17 +406,26 @@ esp_err_t event_init_rmt(gpio_num_t pin, uint32_t resolution_hz)
         &s_event_task_handle,    // Task handle
         1                        // Pin to core 1
     );
-    
+
     if (task_ret != pdPASS) {
         ESP_LOGE(TAG, "Failed to create event marker task");
         vQueueDelete(s_event_queue);
         s_event_queue = NULL;
         return ESP_ERR_NO_MEM;
     }
-    
+
     ESP_LOGI(TAG, "Event system initialized successfully");
-    ESP_LOGI(TAG, "RMT resolution: %lu Hz, Pin: %d", optimal_resolution, pin);
-    
+    ESP_LOGI(TAG, "RMT resolution: %lu Hz, Pin: %d", resolution_hz, pin);
+
+    return ESP_OK;
+}
+
+esp_err_t event_set_encoding(event_encoding_t enc)
+{
+    ESP_RETURN_ON_FALSE(enc == EVENT_ENC_WIDTH || enc == EVENT_ENC_WORD, ESP_ERR_INVALID_ARG,
+                        TAG, "bad encoding %d", enc);
+    s_encoding = enc;
+    ESP_LOGI(TAG, "markers as %s", enc == EVENT_ENC_WORD ? "binary words" : "pulse widths");
     return ESP_OK;
 }
 
@@ -146,41 +435,65 @@ esp_err_t event_send_state(event_state_t st)
     if (st >= EVENT_STATE_COUNT) {
         return ESP_ERR_INVALID_ARG;
     }
-    
+
     if (s_event_queue == NULL) {
         return ESP_ERR_INVALID_STATE;
     }
-    
+
     // Send to queue with minimal blocking (1 tick timeout)
     // This ensures we don't block the calling task if queue is full
     BaseType_t ret = xQueueSend(s_event_queue, &st, 1);
-    
+
     if (ret != pdTRUE) {
         ESP_LOGW(TAG, "Event queue full, dropping event %d", st);
         return ESP_ERR_TIMEOUT;
     }
-    
+
     return ESP_OK;
 }
 
-// New function for critical state transitions that need immediate marking
-esp_err_t event_send_state_immediate(event_state_t st)
+esp_err_t event_send_marker(event_state_t st, uint32_t trial)
 {
-    // Fast validation
     if (st >= EVENT_STATE_COUNT || s_tx_chan == NULL || s_copy_enc == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
-    
-    // Send immediately without queue (use sparingly for critical events)
-    rmt_transmit_config_t cfg = {
-        .loop_count = 0,
-        .flags = { .eot_level = 0 }
-    };
-    
-    return rmt_transmit(s_tx_chan, s_copy_enc, 
-                       &s_event_symbols[st], 
-                       sizeof(rmt_symbol_word_t), 
-                       &cfg);
+    if (st < SYNC_0) s_last_trial = trial;
+    return transmit(st, trial);
+}
+
+// For critical state transitions that need immediate marking
+esp_err_t event_send_state_immediate(event_state_t st)
+{
+    return event_send_marker(st, s_last_trial);
+}
+
+esp_err_t event_set_policy(event_state_t st, event_policy_t policy)
+{
+    ESP_RETURN_ON_FALSE(st < EVENT_STATE_COUNT && (policy == EVENT_DEFER || policy == EVENT_PREEMPT),
+                        ESP_ERR_INVALID_ARG, TAG, "bad policy %d for event %d", policy, st);
+    s_policy[st] = policy;
+    return ESP_OK;
+}
+
+void event_get_stats(event_stats_t *out)
+{
+    *out = s_stats;
+}
+
+bool event_last_edge(event_state_t st, int64_t *t_us, uint32_t *trial)
+{
+    if (st >= EVENT_STATE_COUNT) return false;
+    portENTER_CRITICAL(&s_edge_lock);
+    *t_us  = s_edge[st].t;
+    *trial = s_edge[st].trial;
+    portEXIT_CRITICAL(&s_edge_lock);
+    return *t_us != 0;
+}
+
+uint32_t event_marker_dur_us(event_state_t st)
+{
+    if (st >= EVENT_STATE_COUNT) return 0;
+    return s_encoding == EVENT_ENC_WORD ? s_word_dur_us : s_event_dur_us[st];
 }
 
 // Function to get queue status for debugging
@@ -200,24 +513,24 @@ esp_err_t event_deinit(void)
         vTaskDelete(s_event_task_handle);
         s_event_task_handle = NULL;
     }
-    
+
     // Delete queue
     if (s_event_queue != NULL) {
         vQueueDelete(s_event_queue);
         s_event_queue = NULL;
     }
-    
+
     // Disable RMT channel (no delete function exists in ESP-IDF v5.x)
     if (s_tx_chan != NULL) {
         rmt_disable(s_tx_chan);
         s_tx_chan = NULL;
     }
-    
+
     if (s_copy_enc != NULL) {
         rmt_del_encoder(s_copy_enc);
         s_copy_enc = NULL;
     }
-    
+
     ESP_LOGI(TAG, "Event system deinitialized");
     return ESP_OK;
-}
\ No newline at end of file
+}
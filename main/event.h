@@ -1,16 +1,100 @@
 #pragma once
 #include "esp_err.h"
+#include <stdbool.h>
 #include <stdint.h>
 #include "driver/gpio.h"
 
 typedef enum {
     INIT, CUE_0, CUE_1, CUE_2, CUE_3, MOVING,
     REWARD_0, REWARD_1, REWARD_2, REWARD_3,
-    TIMEOUT, RESET, EVENT_STATE_COUNT
+    TIMEOUT, RESET,
+    SYNC_0, SYNC_1, SYNC_FRAME, // clock-sync pulses (clocksync.h); trial field = pulse number
+    EVENT_STATE_COUNT
 } event_state_t;
 
+/*
+ * Marker encodings on the event pin.
+ *
+ * EVENT_ENC_WIDTH: one high pulse per state, 10-160 ms wide (the original
+ *   scheme; state only, and the pin is busy for up to 160 ms).
+ * EVENT_ENC_WORD: 3 low guard bits, a start bit, then a 32-bit word, NRZ,
+ *   MSB first, EVENT_WORD_BIT_US per bit (360 us in all):
+ *     [31:27] state  [26:11] trial (low 16 bits)  [10:4] sequence (rolling)
+ *     [3:0]   CRC-4 (x^4 + x + 1, init 0) over bits 31:4
+ *   event_decode.py decodes a logic-analyser or DAQ capture of the pin.
+ */
+typedef enum {
+    EVENT_ENC_WIDTH = 0,
+    EVENT_ENC_WORD
+} event_encoding_t;
+
+#define EVENT_WORD_BIT_US   10
+#define EVENT_WORD_BITS     32
+
+/*
+ * Marker scheduling. Every marker goes through one scheduler that knows what
+ * is on the wire. A marker asked for while the channel is busy (an overlap)
+ * is handled by its event's policy:
+ *   EVENT_DEFER    queue behind the markers already on the channel (default)
+ *   EVENT_PREEMPT  cut the marker on the wire short and go now; markers that
+ *                  were queued but had not started are sent after it
+ * Each marker's fate goes to the host as a TLM_MARKER record: the time of its
+ * first rising edge, taken from the RMT tx-done interrupt (the hardware timed
+ * the pulse, so start = done - duration), how late that was against the
+ * request, and EVENT_MK_* flags.
+ */
+typedef enum {
+    EVENT_DEFER = 0,
+    EVENT_PREEMPT
+} event_policy_t;
+
+#define EVENT_MK_DEFERRED   0x01    // waited for the channel
+#define EVENT_MK_PREEMPTED  0x02    // cut short the marker before it
+#define EVENT_MK_TRUNCATED  0x04    // was cut short (time = estimated start)
+#define EVENT_MK_DROPPED    0x08    // never sent: scheduler full (time = 0)
+
+typedef struct {
+    uint32_t sent;          // markers handed to the RMT driver
+    uint32_t overlaps;      // markers asked for while the channel was busy
+    uint32_t deferred;      // ... and queued behind it
+    uint32_t preempted;     // ... and sent at once, cutting the busy marker short
+    uint32_t truncated;     // markers cut short by a preempting one
+    uint32_t dropped;       // markers never sent
+    uint32_t max_late_us;   // largest request-to-edge delay seen
+} event_stats_t;
+
+/** @brief  resolution_hz: RMT tick rate, 100 kHz..1.6 MHz (the 160 ms width must fit 4 symbols). */
 esp_err_t event_init_rmt(gpio_num_t pin, uint32_t resolution_hz);
+esp_err_t event_set_encoding(event_encoding_t enc);
+esp_err_t event_set_policy(event_state_t st, event_policy_t policy);
 esp_err_t event_send_state(event_state_t st);
+
+/**
+ * @brief  Schedule a marker on the pin (see the policies above). Never waits
+ *         on the wire: up to 8 markers can be on the channel; past that (or if
+ *         the other sender holds the scheduler) the marker is dropped, counted,
+ *         reported, and ESP_ERR_TIMEOUT returned.
+ */
+esp_err_t event_send_marker(event_state_t st, uint32_t trial);
+
+/** @brief  event_send_marker() with the trial of the previous marker. */
 esp_err_t event_send_state_immediate(event_state_t st);
+
+void event_get_stats(event_stats_t *out);
+
+/**
+ * @brief  First rising edge of the last @p st marker that reached the pin, and
+ *         its trial; false if none has yet.
+ */
+bool event_last_edge(event_state_t st, int64_t *t_us, uint32_t *trial);
+
+/**
+ * @brief  How long an @p st marker occupies the pin in the current encoding,
+ *         lead included: its edge is reported (event_last_edge()) only after
+ *         that much, once the tx-done interrupt fires. 0 for a bad state.
+ */
+uint32_t event_marker_dur_us(event_state_t st);
+uint32_t event_word_pack(event_state_t st, uint32_t trial, uint8_t seq);
+uint8_t event_word_crc4(uint32_t data28);
 uint32_t event_get_queue_waiting(void);
 esp_err_t event_deinit(void);
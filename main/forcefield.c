@@ -0,0 +1,166 @@
+// main/forcefield.c
+//
+// Two banks: the loader (trial task) only ever writes the bank the control
+// loop is not using, publishes it with a generation number, and the control
+// loop switches banks at the top of ff_eval() and acknowledges the generation.
+
+#include "forcefield.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "esp_check.h"
+#include "esp_timer.h"
+
+static const char *TAG = "FF";
+
+static ff_set_t    s_bank[2];           // bank 0 starts empty: no force
+static atomic_int  s_published;         // bank of the last ff_load()
+static atomic_uint s_gen_pub;           // bumped by every ff_load()
+static atomic_uint s_gen_ack;           // last generation the control loop picked up
+static atomic_uint s_trigger_us;        // pulse reference, low 32 bits of esp_timer time
+
+// control loop only
+static int         s_active;
+static unsigned    s_gen_seen;
+
+static esp_err_t check_field(ff_field_t *f)
+{
+    switch (f->type) {
+    case FF_NONE:
+        return ESP_OK;
+    case FF_VISCOUS:
+        ESP_RETURN_ON_FALSE(isfinite(f->viscous.B), ESP_ERR_INVALID_ARG, TAG, "viscous B");
+        return ESP_OK;
+    case FF_SPRING:
+        ESP_RETURN_ON_FALSE(isfinite(f->spring.K), ESP_ERR_INVALID_ARG, TAG, "spring K");
+        return ESP_OK;
+    case FF_BIAS:
+        ESP_RETURN_ON_FALSE(isfinite(f->bias.u), ESP_ERR_INVALID_ARG, TAG, "bias u");
+        return ESP_OK;
+    case FF_LUT:
+        ESP_RETURN_ON_FALSE(f->lut.n >= 2 && f->lut.n <= FF_LUT_POINTS, ESP_ERR_INVALID_ARG,
+                            TAG, "lut needs 2…%d points", FF_LUT_POINTS);
+        ESP_RETURN_ON_FALSE(f->lut.x_max > f->lut.x_min, ESP_ERR_INVALID_ARG, TAG, "lut range");
+        f->lut.inv_dx = (float)(f->lut.n - 1) / (float)(f->lut.x_max - f->lut.x_min);
+        return ESP_OK;
+    case FF_WALL:
+        ESP_RETURN_ON_FALSE(f->wall.dir == 1 || f->wall.dir == -1, ESP_ERR_INVALID_ARG,
+                            TAG, "wall dir must be ±1");
+        ESP_RETURN_ON_FALSE(isfinite(f->wall.K) && isfinite(f->wall.B), ESP_ERR_INVALID_ARG,
+                            TAG, "wall gains");
+        return ESP_OK;
+    case FF_PULSE:
+        ESP_RETURN_ON_FALSE(isfinite(f->pulse.u), ESP_ERR_INVALID_ARG, TAG, "pulse u");
+        return ESP_OK;
+    }
+    ESP_LOGE(TAG, "unknown field type %d", (int)f->type);
+    return ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t ff_load(const ff_set_t *set)
+{
+    ESP_RETURN_ON_FALSE(set != NULL && set->n <= FF_MAX_FIELDS, ESP_ERR_INVALID_ARG,
+                        TAG, "at most %d fields", FF_MAX_FIELDS);
+
+    unsigned gen = atomic_load_explicit(&s_gen_pub, memory_order_relaxed);
+    ESP_RETURN_ON_FALSE(atomic_load_explicit(&s_gen_ack, memory_order_acquire) == gen,
+                        ESP_ERR_INVALID_STATE, TAG, "previous set not picked up yet");
+
+    int       idle = 1 - atomic_load_explicit(&s_published, memory_order_relaxed);
+    ff_set_t *dst  = &s_bank[idle];
+
+    memcpy(dst, set, sizeof(*dst));
+    for (int i = 0; i < dst->n; i++) {
+        esp_err_t err = check_field(&dst->f[i]);
+        if (err != ESP_OK) return err;
+    }
+
+    atomic_store_explicit(&s_published, idle, memory_order_relaxed);
+    atomic_store_explicit(&s_gen_pub, gen + 1, memory_order_release);
+    return ESP_OK;
+}
+
+bool ff_loaded(void)
+{
+    return atomic_load_explicit(&s_gen_ack, memory_order_acquire) ==
+           atomic_load_explicit(&s_gen_pub, memory_order_acquire);
+}
+
+void ff_trigger(void)
+{
+    atomic_store_explicit(&s_trigger_us, (uint32_t)esp_timer_get_time(), memory_order_relaxed);
+}
+
+float ff_eval(const kin_sample_t *kin)
+{
+    unsigned gen = atomic_load_explicit(&s_gen_pub, memory_order_acquire);
+    if (gen != s_gen_seen) {
+        s_active   = atomic_load_explicit(&s_published, memory_order_relaxed);
+        s_gen_seen = gen;
+        atomic_store_explicit(&s_trigger_us, (uint32_t)kin->t_us, memory_order_relaxed);
+        atomic_store_explicit(&s_gen_ack, gen, memory_order_release);
+    }
+
+    const ff_set_t *set  = &s_bank[s_active];
+    const int32_t   pos  = kin->pos;
+    const float     vel  = kin->vel;
+    const uint32_t  t_us = (uint32_t)kin->t_us;
+    float           u    = 0.0f;
+
+    for (int i = 0; i < set->n; i++) {
+        const ff_field_t *f = &set->f[i];
+        switch (f->type) {
+        case FF_VISCOUS:
+            u -= f->viscous.B * vel;
+            break;
+        case FF_SPRING:
+            u -= f->spring.K * (float)(pos - f->spring.x0);
+            break;
+        case FF_BIAS:
+            u += f->bias.u;
+            break;
+        case FF_LUT: {
+            float x = (float)(pos - f->lut.x_min) * f->lut.inv_dx;
+            int   last = f->lut.n - 1;
+            if (x <= 0.0f) {
+                u += f->lut.u[0];
+            } else if (x >= (float)last) {
+                u += f->lut.u[last];
+            } else {
+                int   k  = (int)x;
+                float fr = x - (float)k;
+                u += f->lut.u[k] + fr * (f->lut.u[k + 1] - f->lut.u[k]);
+            }
+            break;
+        }
+        case FF_WALL: {
+            float pen = (float)(pos - f->wall.pos) * (float)f->wall.dir;
+            if (pen > 0.0f) {
+                u -= (float)f->wall.dir * f->wall.K * pen + f->wall.B * vel;
+            }
+            break;
+        }
+        case FF_PULSE: {
+            uint32_t since = t_us - atomic_load_explicit(&s_trigger_us, memory_order_relaxed);
+            if (since >= f->pulse.delay_us && since - f->pulse.delay_us < f->pulse.dur_us) {
+                u += f->pulse.u;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    if (u >  FF_U_LIMIT) u =  FF_U_LIMIT;
+    if (u < -FF_U_LIMIT) u = -FF_U_LIMIT;
+    return u;
+}
+
+void ff_set_viscous(ff_set_t *set, float B)
+{
+    memset(set, 0, sizeof(*set));
+    set->n              = 1;
+    set->f[0].type      = FF_VISCOUS;
+    set->f[0].viscous.B = B;
+}
@@ -0,0 +1,94 @@
+// main/forcefield.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "kinbus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FF_MAX_FIELDS   6       // fields summed per set
+#define FF_LUT_POINTS   33      // samples in a lookup-table field
+#define FF_U_LIMIT      100.0f  // output clamp, same range as apply_control_mcpwm()
+
+typedef enum {
+    FF_NONE = 0,
+    FF_VISCOUS,     // u = -B·vel
+    FF_SPRING,      // u = -K·(pos − x0)
+    FF_BIAS,        // u = constant
+    FF_LUT,         // u = table(pos), linear between evenly spaced points
+    FF_WALL,        // one-sided spring + damper past a position
+    FF_PULSE,       // constant u for a window after the last ff_trigger()
+} ff_type_t;
+
+/**
+ * One field. Gains use the motorctrl units: output % per count (K),
+ * % per count/s (B). Velocity is the filtered kinbus velocity.
+ */
+typedef struct {
+    ff_type_t type;
+    union {
+        struct { float B; }                              viscous;
+        struct { float K; int32_t x0; }                  spring;
+        struct { float u; }                              bias;
+        struct {
+            int32_t x_min, x_max;                        // table spans x_min…x_max, clamped outside
+            uint8_t n;                                   // 2…FF_LUT_POINTS
+            float   u[FF_LUT_POINTS];
+            float   inv_dx;                              // filled in by ff_load()
+        }                                                lut;
+        struct {
+            int32_t pos;
+            int8_t  dir;                                 // +1: blocks pos > wall, −1: blocks pos < wall
+            float   K;                                   // stiffness inside the wall
+            float   B;                                   // damping inside the wall
+        }                                                wall;
+        struct { float u; uint32_t delay_us; uint32_t dur_us; } pulse;
+    };
+} ff_field_t;
+
+/**
+ * A complete field set, summed and clamped to ±FF_U_LIMIT.
+ */
+typedef struct {
+    uint8_t    n;
+    ff_field_t f[FF_MAX_FIELDS];
+} ff_set_t;
+
+/**
+ * @brief  Validate @p set, copy it into the idle bank and publish it. The
+ *         control loop switches over at its next ff_eval() and acknowledges;
+ *         until then a second ff_load() is refused with ESP_ERR_INVALID_STATE
+ *         so the bank still in use is never overwritten. Call between trials.
+ */
+esp_err_t ff_load(const ff_set_t *set);
+
+/**
+ * @brief  True once the control loop is evaluating the last loaded set.
+ */
+bool ff_loaded(void);
+
+/**
+ * @brief  Restart the FF_PULSE windows from now (e.g. at movement onset).
+ *         ff_load() also triggers, at the moment the new set takes effect.
+ */
+void ff_trigger(void);
+
+/**
+ * @brief  Sum of the active fields for this sample. Control loop only; no
+ *         locks, no divisions.
+ */
+float ff_eval(const kin_sample_t *kin);
+
+/**
+ * @brief  Convenience: a set with a single viscous field (the old
+ *         motorctrl_viscous behaviour).
+ */
+void ff_set_viscous(ff_set_t *set, float B);
+
+#ifdef __cplusplus
+}
+#endif
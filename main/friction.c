@@ -0,0 +1,186 @@
+// main/friction.c
+#include "friction.h"
+#include <math.h>
+#include <stdint.h>
+#include "encoder.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "motor_init.h"
+#include "nvs.h"
+
+static const char *TAG = "FRICTION";
+
+#define FRICTION_NVS_NS         "motor"
+#define FRICTION_NVS_KEY        "friction"
+#define FRICTION_NVS_VERSION    1
+
+// identification sweep (1 ms steps)
+#define ID_RAMP_UP_PCT          0.01f   // per ms: 0 → 30 % in 3 s
+#define ID_RAMP_DOWN_PCT        0.02f   // per ms
+#define ID_MAX_PCT              30.0f   // give up if it has not moved by here
+#define ID_MOVE_COUNTS          3       // travel that counts as breakaway
+#define ID_MAX_TRAVEL           40      // stop the down-ramp if it gets this far
+#define ID_STILL_MS             20      // no count change for this long = stopped
+#define ID_SETTLE_MS            300     // brake between runs
+#define ID_REPEATS              3
+
+typedef struct {
+    uint32_t          version;
+    friction_params_t p;
+} friction_blob_t;
+
+static friction_params_t s_p;
+static bool              s_valid;
+
+esp_err_t friction_init(void)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(FRICTION_NVS_NS, NVS_READONLY, &h);
+    if (err == ESP_ERR_NVS_NOT_FOUND) return ESP_ERR_NOT_FOUND;
+    ESP_RETURN_ON_ERROR(err, TAG, "nvs_open");
+
+    friction_blob_t blob;
+    size_t len = sizeof(blob);
+    err = nvs_get_blob(h, FRICTION_NVS_KEY, &blob, &len);
+    nvs_close(h);
+    if (err == ESP_ERR_NVS_NOT_FOUND || len != sizeof(blob) || blob.version != FRICTION_NVS_VERSION) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_RETURN_ON_ERROR(err, TAG, "nvs_get_blob");
+
+    s_p     = blob.p;
+    s_valid = true;
+    ESP_LOGI(TAG, "loaded: breakaway +%.2f/-%.2f %%, coulomb +%.2f/-%.2f %%",
+             s_p.breakaway_pos, s_p.breakaway_neg, s_p.coulomb_pos, s_p.coulomb_neg);
+    return ESP_OK;
+}
+
+esp_err_t friction_set(const friction_params_t *p, bool save)
+{
+    ESP_RETURN_ON_FALSE(p != NULL, ESP_ERR_INVALID_ARG, TAG, "null params");
+    ESP_RETURN_ON_FALSE(p->breakaway_pos >= 0.0f && p->breakaway_pos <= ID_MAX_PCT &&
+                        p->breakaway_neg >= 0.0f && p->breakaway_neg <= ID_MAX_PCT &&
+                        p->coulomb_pos >= 0.0f && p->coulomb_pos <= p->breakaway_pos &&
+                        p->coulomb_neg >= 0.0f && p->coulomb_neg <= p->breakaway_neg,
+                        ESP_ERR_INVALID_ARG, TAG, "parameters out of range");
+    s_p     = *p;
+    s_valid = true;
+    if (!save) return ESP_OK;
+
+    friction_blob_t blob = { .version = FRICTION_NVS_VERSION, .p = *p };
+    nvs_handle_t h;
+    ESP_RETURN_ON_ERROR(nvs_open(FRICTION_NVS_NS, NVS_READWRITE, &h), TAG, "nvs_open");
+    esp_err_t err = nvs_set_blob(h, FRICTION_NVS_KEY, &blob, sizeof(blob));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    ESP_RETURN_ON_ERROR(err, TAG, "nvs write");
+    return ESP_OK;
+}
+
+esp_err_t friction_clear(void)
+{
+    s_valid = false;
+    nvs_handle_t h;
+    ESP_RETURN_ON_ERROR(nvs_open(FRICTION_NVS_NS, NVS_READWRITE, &h), TAG, "nvs_open");
+    esp_err_t err = nvs_erase_key(h, FRICTION_NVS_KEY);
+    if (err == ESP_ERR_NVS_NOT_FOUND) err = ESP_OK;
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+bool friction_get(friction_params_t *out)
+{
+    *out = s_p;
+    return s_valid;
+}
+
+float friction_comp(float u, float vel)
+{
+    if (!s_valid || u == 0.0f) return u;
+
+    float off, mag;
+    if (u > 0.0f) {
+        off = (vel >  FRICTION_MOVING_CPS) ? s_p.coulomb_pos : s_p.breakaway_pos;
+        mag = u;
+    } else {
+        off = (vel < -FRICTION_MOVING_CPS) ? s_p.coulomb_neg : s_p.breakaway_neg;
+        mag = -u;
+    }
+    if (mag < FRICTION_SMOOTH_PCT) off *= mag * (1.0f / FRICTION_SMOOTH_PCT);
+
+    u += (u > 0.0f) ? off : -off;
+    if (u >  100.0f) u =  100.0f;
+    if (u < -100.0f) u = -100.0f;
+    return u;
+}
+
+// One run in direction @p dir (±1). Brakes before returning.
+static esp_err_t sweep(int dir, float *breakaway, float *coulomb)
+{
+    int32_t p0 = encoder_sample();
+    float   u  = 0.0f;
+
+    // up until it moves
+    while (1) {
+        u += ID_RAMP_UP_PCT;
+        if (u > ID_MAX_PCT) {
+            apply_control_mcpwm(0.0f);
+            ESP_LOGE(TAG, "no motion in %+d direction up to %.0f %%", dir, ID_MAX_PCT);
+            return ESP_ERR_TIMEOUT;
+        }
+        apply_control_mcpwm(dir * u);
+        vTaskDelay(1);
+        if (dir * (encoder_sample() - p0) >= ID_MOVE_COUNTS) break;
+    }
+    *breakaway = u;
+
+    // down until it stops; if it runs out of room first, u is an upper bound
+    int32_t last  = encoder_sample();
+    int     still = 0;
+    while (u > 0.0f && still < ID_STILL_MS) {
+        u -= ID_RAMP_DOWN_PCT;
+        apply_control_mcpwm(dir * fmaxf(u, 0.0f));
+        vTaskDelay(1);
+        int32_t pos = encoder_sample();
+        if (dir * (pos - p0) > ID_MAX_TRAVEL) break;
+        still = (pos == last) ? still + 1 : 0;
+        last  = pos;
+    }
+    *coulomb = fminf(fmaxf(u, 0.0f), *breakaway);
+
+    apply_control_mcpwm(0.0f);
+    vTaskDelay(pdMS_TO_TICKS(ID_SETTLE_MS));
+    return ESP_OK;
+}
+
+esp_err_t friction_identify(friction_params_t *out)
+{
+    ESP_RETURN_ON_FALSE(out != NULL, ESP_ERR_INVALID_ARG, TAG, "null params");
+    friction_params_t sum = { 0 };
+
+    ESP_LOGI(TAG, "identifying: %d runs per direction", ID_REPEATS);
+    apply_control_mcpwm(0.0f);
+    vTaskDelay(pdMS_TO_TICKS(ID_SETTLE_MS));
+
+    // alternate directions so the lever ends up roughly where it started
+    for (int i = 0; i < ID_REPEATS; i++) {
+        float b, c;
+        ESP_RETURN_ON_ERROR(sweep(+1, &b, &c), TAG, "+ sweep");
+        sum.breakaway_pos += b;  sum.coulomb_pos += c;
+        ESP_LOGI(TAG, "  run %d +: breakaway %.2f %%, coulomb %.2f %%", i, b, c);
+        ESP_RETURN_ON_ERROR(sweep(-1, &b, &c), TAG, "- sweep");
+        sum.breakaway_neg += b;  sum.coulomb_neg += c;
+        ESP_LOGI(TAG, "  run %d -: breakaway %.2f %%, coulomb %.2f %%", i, b, c);
+    }
+
+    out->breakaway_pos = sum.breakaway_pos / ID_REPEATS;
+    out->breakaway_neg = sum.breakaway_neg / ID_REPEATS;
+    out->coulomb_pos   = sum.coulomb_pos   / ID_REPEATS;
+    out->coulomb_neg   = sum.coulomb_neg   / ID_REPEATS;
+    ESP_LOGI(TAG, "result: breakaway +%.2f/-%.2f %%, coulomb +%.2f/-%.2f %%",
+             out->breakaway_pos, out->breakaway_neg, out->coulomb_pos, out->coulomb_neg);
+    return ESP_OK;
+}
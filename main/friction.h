@@ -0,0 +1,71 @@
+// main/friction.h
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Feedforward for static/Coulomb friction and the driver's deadband.
+ *
+ * Commands below the breakaway duty do nothing but heat the motor, so a PID
+ * that is a few counts off target stalls there. friction_comp() adds the
+ * identified offset in the direction of the command: the breakaway duty while
+ * the lever is still, the (lower) Coulomb duty once it moves that way. The
+ * offset fades in over the first FRICTION_SMOOTH_PCT of command so there is
+ * no step at u = 0 to chatter around the setpoint.
+ */
+
+#define FRICTION_SMOOTH_PCT     0.5f    // |u| over which the offset ramps in
+#define FRICTION_MOVING_CPS     200.0f  // |vel| above which kinetic friction applies
+
+typedef struct {
+    float breakaway_pos;    // % duty at which the lever starts to move, + direction
+    float breakaway_neg;    //   same, − direction (magnitude)
+    float coulomb_pos;      // % duty that just keeps it moving, + direction
+    float coulomb_neg;      //   same, − direction (magnitude)
+} friction_params_t;
+
+/**
+ * @brief  Load the stored parameters from NVS (nvs_flash_init() first).
+ * @return ESP_ERR_NOT_FOUND if none are stored; compensation stays off.
+ */
+esp_err_t friction_init(void);
+
+/**
+ * @brief  Identify the parameters: per direction, ramp the duty up until the
+ *         encoder moves (breakaway), then down until it stops (Coulomb);
+ *         averaged over a few runs. Blocks for ~10–20 s and drives the motor
+ *         directly, so the control loop must be stopped and the lever free.
+ *         Travel is bounded to a few tens of counts around the start.
+ */
+esp_err_t friction_identify(friction_params_t *out);
+
+/**
+ * @brief  Use @p p from now on (control loop stopped); optionally store it.
+ */
+esp_err_t friction_set(const friction_params_t *p, bool save);
+
+/**
+ * @brief  Forget the parameters, in RAM and NVS. Compensation turns off.
+ */
+esp_err_t friction_clear(void);
+
+/**
+ * @brief  Current parameters; false if compensation is off.
+ */
+bool friction_get(friction_params_t *out);
+
+/**
+ * @brief  Compensated command for @p u (%), given the lever velocity
+ *         (counts/s). Returns @p u unchanged while compensation is off.
+ *         Control-loop hot path.
+ */
+float friction_comp(float u, float vel);
+
+#ifdef __cplusplus
+}
+#endif
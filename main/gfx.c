@@ -0,0 +1,201 @@
+// main/gfx.c
+//
+// Both engines are used in blocking mode: the calling task sleeps on the
+// driver's semaphore while the PPA works, so the CPU is free for the other
+// tasks on its core. The PPA driver writes the sources back from the cache
+// and invalidates the destination itself; the CPU paths write their
+// destination back when done.
+#include "gfx.h"
+#include <string.h>
+#include "esp_cache.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#if CONFIG_GFX_USE_PPA
+#include "driver/ppa.h"
+#endif
+
+static const char *TAG = "GFX";
+
+#if CONFIG_GFX_USE_PPA
+static ppa_client_handle_t s_fill;
+static ppa_client_handle_t s_blend;
+#endif
+static bool s_ppa;                  // clients registered and in use
+
+static esp_err_t check_block(const gfx_pic_t *p, int x, int y, int w, int h)
+{
+    ESP_RETURN_ON_FALSE(p && p->buf && (size_t)p->w * p->h * 3 <= p->buf_size, ESP_ERR_INVALID_ARG,
+                        TAG, "bad picture");
+    ESP_RETURN_ON_FALSE(x >= 0 && y >= 0 && w > 0 && h > 0 && x + w <= p->w && y + h <= p->h,
+                        ESP_ERR_INVALID_ARG, TAG, "block %dx%d at %d,%d outside %dx%d", w, h, x, y, p->w, p->h);
+    return ESP_OK;
+}
+
+static uint8_t *pixel(const gfx_pic_t *p, int x, int y)
+{
+    return p->buf + ((size_t)y * p->w + x) * 3;
+}
+
+// Write back the rows of a block the CPU wrote
+static void writeback(const gfx_pic_t *p, int x, int y, int w, int h)
+{
+    size_t len = ((size_t)(h - 1) * p->w + w) * 3;
+    esp_cache_msync(pixel(p, x, y), len, ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_UNALIGNED);
+}
+
+// The first row by pixel, the rest copied from it
+static void fill_cpu(const gfx_pic_t *dst, int x, int y, int w, int h, uint32_t rgb)
+{
+    uint8_t *row = pixel(dst, x, y);
+    for (int i = 0; i < w; i++) {
+        row[i * 3 + 0] = rgb & 0xFF;
+        row[i * 3 + 1] = (rgb >> 8) & 0xFF;
+        row[i * 3 + 2] = (rgb >> 16) & 0xFF;
+    }
+    for (int j = 1; j < h; j++) memcpy(pixel(dst, x, y + j), row, (size_t)w * 3);
+    writeback(dst, x, y, w, h);
+}
+
+static void key_over_cpu(const gfx_pic_t *dst, int dx, int dy,
+                         const gfx_pic_t *under, int ux, int uy, int w, int h, uint32_t key)
+{
+    const uint8_t kb = key & 0xFF, kg = (key >> 8) & 0xFF, kr = (key >> 16) & 0xFF;
+    for (int j = 0; j < h; j++) {
+        uint8_t *p = pixel(dst, dx, dy + j);
+        const uint8_t *u = pixel(under, ux, uy + j);
+        for (int i = 0; i < w; i++, p += 3, u += 3) {
+            if (p[0] == kb && p[1] == kg && p[2] == kr) {
+                p[0] = u[0];
+                p[1] = u[1];
+                p[2] = u[2];
+            }
+        }
+    }
+    writeback(dst, dx, dy, w, h);
+}
+
+#if CONFIG_GFX_USE_PPA
+static bool use_ppa(int w, int h)
+{
+    return s_ppa && w * h >= GFX_PPA_MIN_PX;
+}
+#endif
+
+esp_err_t gfx_fill(const gfx_pic_t *dst, int x, int y, int w, int h, uint32_t rgb)
+{
+    ESP_RETURN_ON_ERROR(check_block(dst, x, y, w, h), TAG, "fill");
+#if CONFIG_GFX_USE_PPA
+    if (use_ppa(w, h)) {
+        ppa_fill_oper_config_t op = {
+            .out = {
+                .buffer         = dst->buf,
+                .buffer_size    = dst->buf_size,
+                .pic_w          = dst->w,
+                .pic_h          = dst->h,
+                .block_offset_x = x,
+                .block_offset_y = y,
+                .fill_cm        = PPA_FILL_COLOR_MODE_RGB888,
+            },
+            .fill_block_w    = w,
+            .fill_block_h    = h,
+            .fill_argb_color = { .val = 0xFF000000 | rgb },
+            .mode            = PPA_TRANS_MODE_BLOCKING,
+        };
+        return ppa_do_fill(s_fill, &op);
+    }
+#endif
+    fill_cpu(dst, x, y, w, h, rgb);
+    return ESP_OK;
+}
+
+esp_err_t gfx_key_over(const gfx_pic_t *dst, int dx, int dy,
+                       const gfx_pic_t *under, int ux, int uy, int w, int h, uint32_t key)
+{
+    ESP_RETURN_ON_ERROR(check_block(dst, dx, dy, w, h), TAG, "key over");
+    ESP_RETURN_ON_ERROR(check_block(under, ux, uy, w, h), TAG, "key under");
+#if CONFIG_GFX_USE_PPA
+    if (use_ppa(w, h)) {
+        // dst is the opaque foreground with the key colour keyed out, under
+        // the background; the result goes back over dst
+        const color_pixel_rgb888_data_t ck = { .b = key & 0xFF, .g = (key >> 8) & 0xFF, .r = (key >> 16) & 0xFF };
+        ppa_blend_oper_config_t op = {
+            .in_bg = {
+                .buffer         = under->buf,
+                .pic_w          = under->w,
+                .pic_h          = under->h,
+                .block_w        = w,
+                .block_h        = h,
+                .block_offset_x = ux,
+                .block_offset_y = uy,
+                .blend_cm       = PPA_BLEND_COLOR_MODE_RGB888,
+            },
+            .in_fg = {
+                .buffer         = dst->buf,
+                .pic_w          = dst->w,
+                .pic_h          = dst->h,
+                .block_w        = w,
+                .block_h        = h,
+                .block_offset_x = dx,
+                .block_offset_y = dy,
+                .blend_cm       = PPA_BLEND_COLOR_MODE_RGB888,
+            },
+            .out = {
+                .buffer         = dst->buf,
+                .buffer_size    = dst->buf_size,
+                .pic_w          = dst->w,
+                .pic_h          = dst->h,
+                .block_offset_x = dx,
+                .block_offset_y = dy,
+                .blend_cm       = PPA_BLEND_COLOR_MODE_RGB888,
+            },
+            .bg_alpha_update_mode = PPA_ALPHA_NO_CHANGE,
+            .fg_alpha_update_mode = PPA_ALPHA_NO_CHANGE,
+            .fg_ck_en             = true,
+            .fg_ck_rgb_low_thres  = ck,
+            .fg_ck_rgb_high_thres = ck,
+            .mode                 = PPA_TRANS_MODE_BLOCKING,
+        };
+        return ppa_do_blend(s_blend, &op);
+    }
+#endif
+    key_over_cpu(dst, dx, dy, under, ux, uy, w, h, key);
+    return ESP_OK;
+}
+
+bool gfx_accelerated(void)
+{
+    return s_ppa;
+}
+
+void gfx_set_accelerated(bool on)
+{
+#if CONFIG_GFX_USE_PPA
+    s_ppa = on && s_fill && s_blend;
+#endif
+}
+
+esp_err_t gfx_init(void)
+{
+#if CONFIG_GFX_USE_PPA
+    if (s_fill == NULL) {
+        ppa_client_config_t fill_config = {
+            .oper_type             = PPA_OPERATION_FILL,
+            .max_pending_trans_num = GFX_PPA_PENDING,
+        };
+        ESP_RETURN_ON_ERROR(ppa_register_client(&fill_config, &s_fill), TAG, "PPA fill client");
+    }
+    if (s_blend == NULL) {
+        ppa_client_config_t blend_config = {
+            .oper_type             = PPA_OPERATION_BLEND,
+            .max_pending_trans_num = GFX_PPA_PENDING,
+        };
+        ESP_RETURN_ON_ERROR(ppa_register_client(&blend_config, &s_blend), TAG, "PPA blend client");
+    }
+    s_ppa = true;
+    ESP_LOGI(TAG, "fills and keyed blends on the PPA");
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
@@ -0,0 +1,71 @@
+// main/gfx.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 2D operations on RGB888 pictures (LVGL's byte order, rows packed), on the
+ * P4's pixel-processing accelerator (PPA: fill and blend engines with their
+ * own 2D-DMA) when CONFIG_GFX_USE_PPA is set and gfx_init() got its clients,
+ * on the CPU otherwise. Either way the destination is in memory, not only in
+ * the cache, when a call returns, ready for the display DMA.
+ *
+ * The PPA writes by DMA and its driver invalidates the destination's cache
+ * lines, so a destination must start on a cache line and its buf_size be a
+ * whole number of them (GFX_ALIGN); frame buffers and heap_caps_aligned_alloc()
+ * buffers are. Blocks under GFX_PPA_MIN_PX pixels stay on the CPU, which
+ * beats a PPA transaction's set-up at that size (gfx_bench.c).
+ *
+ * Several tasks may call in at once: each call is its own PPA transaction,
+ * queued by the driver (up to GFX_PPA_PENDING per engine).
+ */
+
+#define GFX_ALIGN           64      // PSRAM cache line
+#define GFX_PPA_MIN_PX      4096
+#define GFX_PPA_PENDING     4
+
+typedef struct {
+    uint8_t *buf;
+    size_t   buf_size;              // bytes, at least w * h * 3
+    int      w, h;
+} gfx_pic_t;
+
+/**
+ * @brief  Register the PPA fill and blend clients. Without it (or with
+ *         CONFIG_GFX_USE_PPA off) every operation runs on the CPU.
+ */
+esp_err_t gfx_init(void);
+
+/** @brief  True while operations go to the PPA. */
+bool gfx_accelerated(void);
+
+/**
+ * @brief  Route operations to the PPA (@p on, if gfx_init() succeeded) or
+ *         to the CPU; for comparisons (gfx_bench.c).
+ */
+void gfx_set_accelerated(bool on);
+
+/**
+ * @brief  Fill the block @p w x @p h at (@p x, @p y) of @p dst with @p rgb
+ *         (0xRRGGBB).
+ */
+esp_err_t gfx_fill(const gfx_pic_t *dst, int x, int y, int w, int h, uint32_t rgb);
+
+/**
+ * @brief  Colour-keyed composite in place: in the block @p w x @p h at
+ *         (@p dx, @p dy) of @p dst, pixels of colour @p key (0xRRGGBB) take
+ *         the pixel of @p under at the same offset from (@p ux, @p uy).
+ */
+esp_err_t gfx_key_over(const gfx_pic_t *dst, int dx, int dy,
+                       const gfx_pic_t *under, int ux, int uy, int w, int h, uint32_t key);
+
+#ifdef __cplusplus
+}
+#endif
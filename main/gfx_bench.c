@@ -0,0 +1,155 @@
+// main/gfx_bench.c
+//
+// Full-frame fill and colour-key composite on the CPU vs the PPA (gfx.h).
+// Mode "bench-gfx" (app_mode.h); it draws nothing on the display, only into
+// frames the size of the panel's in PSRAM.
+//
+// Times are wall time per call, including the cache write-back the CPU path
+// needs before a display DMA may read its result. The CPU is busy for all
+// of a CPU call; during a PPA call the task sleeps on the driver and the
+// core runs other tasks. The small-block rows show where GFX_PPA_MIN_PX
+// comes from.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "app_mode.h"
+#include "gfx.h"
+
+#define BENCH_W             1024    // the panel, landscape (graphics.h)
+#define BENCH_H             600
+#define BENCH_CALLS         20
+#define BENCH_KEY           0x010001    // LCD_KEY_COLOR
+
+typedef struct {
+    uint32_t n;
+    uint64_t sum;
+    uint32_t max;
+} bench_stat_t;
+
+typedef esp_err_t (*bench_op_t)(const gfx_pic_t *dst, int w, int h);
+
+static gfx_pic_t s_under;
+
+static void stat_add(bench_stat_t *st, uint32_t us)
+{
+    st->n++;
+    st->sum += us;
+    if (us > st->max) st->max = us;
+}
+
+static void print_stat(const char *name, const char *engine, const bench_stat_t *st)
+{
+    float mean = st->n ? (float)st->sum / st->n : 0.0f;
+    printf("  %-22s %-4s n=%-3lu mean=%9.1f us  max=%7lu us\n",
+           name, engine, (unsigned long)st->n, mean, (unsigned long)st->max);
+}
+
+static void alloc_pic(gfx_pic_t *p)
+{
+    *p = (gfx_pic_t){ .buf_size = (size_t)BENCH_W * BENCH_H * 3, .w = BENCH_W, .h = BENCH_H };
+    p->buf = heap_caps_aligned_alloc(GFX_ALIGN, p->buf_size, MALLOC_CAP_SPIRAM);
+    ESP_ERROR_CHECK(p->buf ? ESP_OK : ESP_ERR_NO_MEM);
+}
+
+static esp_err_t op_fill(const gfx_pic_t *dst, int w, int h)
+{
+    return gfx_fill(dst, 0, 0, w, h, 0x00FF00);
+}
+
+// Half the block keyed: the overlay's background over a stimulus frame
+static esp_err_t prep_key(const gfx_pic_t *dst, int w, int h)
+{
+    ESP_ERROR_CHECK(gfx_fill(dst, 0, 0, w, h, 0xFFFFFF));
+    return gfx_fill(dst, 0, 0, w / 2, h, BENCH_KEY);
+}
+
+static esp_err_t op_key(const gfx_pic_t *dst, int w, int h)
+{
+    return gfx_key_over(dst, 0, 0, &s_under, 0, 0, w, h, BENCH_KEY);
+}
+
+// The PPA's result is in memory (the driver invalidated the cache): check
+// the block's corners and a pixel outside it against the CPU's
+static bool same_result(const gfx_pic_t *dst, const gfx_pic_t *ref, int w, int h)
+{
+    const int xs[] = { 0, w - 1, 0, w - 1, w < BENCH_W ? w : 0 };
+    const int ys[] = { 0, 0, h - 1, h - 1, 0 };
+    for (int i = 0; i < 5; i++) {
+        const uint8_t *a = dst->buf + ((size_t)ys[i] * BENCH_W + xs[i]) * 3;
+        const uint8_t *b = ref->buf + ((size_t)ys[i] * BENCH_W + xs[i]) * 3;
+        if (a[0] != b[0] || a[1] != b[1] || a[2] != b[2]) return false;
+    }
+    return true;
+}
+
+// @p prep (untimed, may be NULL) sets the block up before each @p op
+static void run(const char *name, bench_op_t prep, bench_op_t op, int w, int h, gfx_pic_t *cpu, gfx_pic_t *ppa)
+{
+    bench_stat_t st;
+    for (int accel = 0; accel <= 1; accel++) {
+        gfx_pic_t *dst = accel ? ppa : cpu;
+        gfx_set_accelerated(accel);
+        if (accel && !gfx_accelerated()) {
+            printf("  %-22s ppa  not available\n", name);
+            return;
+        }
+        ESP_ERROR_CHECK(gfx_fill(dst, 0, 0, BENCH_W, BENCH_H, 0x000000));
+        st = (bench_stat_t){ 0 };
+        for (int i = 0; i < BENCH_CALLS; i++) {
+            if (prep) ESP_ERROR_CHECK(prep(dst, w, h));
+            int64_t t0 = esp_timer_get_time();
+            ESP_ERROR_CHECK(op(dst, w, h));
+            stat_add(&st, (uint32_t)(esp_timer_get_time() - t0));
+            vTaskDelay(1);
+        }
+        print_stat(name, accel ? "ppa" : "cpu", &st);
+    }
+    if (!same_result(ppa, cpu, w, h)) printf("  %-22s MISMATCH between cpu and ppa\n", name);
+}
+
+static void bench_task(void *pv)
+{
+    gfx_pic_t cpu, ppa;
+    alloc_pic(&cpu);
+    alloc_pic(&ppa);
+    alloc_pic(&s_under);
+    if (gfx_init() != ESP_OK) printf("PPA unavailable, CPU only\n");   // lcd_init() registered it already
+    gfx_set_accelerated(false);
+    ESP_ERROR_CHECK(gfx_fill(&s_under, 0, 0, BENCH_W, BENCH_H, 0x00FF00));
+
+    printf("2D benchmark: %dx%d RGB888 in PSRAM, %d calls per row\n", BENCH_W, BENCH_H, BENCH_CALLS);
+    run("fill full frame", NULL, op_fill, BENCH_W, BENCH_H, &cpu, &ppa);
+    run("fill 128x40 (lever)", NULL, op_fill, 128, 40, &cpu, &ppa);
+    run("fill 64x64", NULL, op_fill, 64, 64, &cpu, &ppa);
+    run("fill 32x32", NULL, op_fill, 32, 32, &cpu, &ppa);
+    run("key over full frame", prep_key, op_key, BENCH_W, BENCH_H, &cpu, &ppa);
+    run("key over 128x40", prep_key, op_key, 128, 40, &cpu, &ppa);
+    printf("Done.\n");
+    vTaskDelete(NULL);
+}
+
+// ───────────── mode "bench-gfx" ─────────────
+
+static esp_err_t bench_gfx_init(void)
+{
+    return ESP_OK;
+}
+
+static esp_err_t bench_gfx_run(void)
+{
+    // the UI core, at the priority of the stimulus commit task (stim.h)
+    xTaskCreatePinnedToCore(bench_task, "gfx_bench", 4096, NULL, 5, NULL, 1);
+    return ESP_OK;
+}
+
+const app_mode_t mode_bench_gfx = {
+    .name     = "bench-gfx",
+    .help     = "2D fill and colour-key cost, CPU vs. PPA",
+    .init     = bench_gfx_init,
+    .run      = bench_gfx_run,
+};
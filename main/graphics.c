@@ -11,22 +11,100 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "esp_timer.h"
+#include "esp_cache.h"
+#include "esp_async_memcpy.h"
 #include "esp_lcd_panel_ops.h"
 #include "esp_lcd_mipi_dsi.h"
 #include "esp_lcd_ek79007.h"
 #include "esp_ldo_regulator.h"
 #include "driver/gpio.h"
 #include "esp_err.h"
+#include "esp_check.h"
 #include "esp_log.h"
 #include "lvgl.h"
 #include "graphics.h"
+#include "gfx.h"
+#include "journal.h"
 
 static const char* TAG = "GRPH";
 SemaphoreHandle_t lvgl_api_mux = NULL;
+static lcd_vsync_cb_t s_vsync_cb;
+static void *s_vsync_ctx;
+static esp_lcd_panel_handle_t s_panel;
+static SemaphoreHandle_t s_blit_done;
+#if !CONFIG_DISPLAY_DOUBLE_BUFFER
+static volatile bool s_flush_busy;          // an LVGL flush is being copied
+static volatile bool s_blit_busy;           // an lcd_blit() is being copied
+#endif
+static const uint8_t *s_underlay;           // shows through LCD_KEY_COLOR pixels
+static int s_hres, s_vres;
+static size_t s_draw_buf_sz;                // bytes in each of LVGL's buffers
 
+#if CONFIG_DISPLAY_DOUBLE_BUFFER
+static lv_display_t *s_disp;
+static uint8_t *s_fb[LCD_NUM_FBS];          // the DPI panel's own frame buffers
+static const void *s_fb_src[LCD_NUM_FBS];   // last lcd_blit() frame each one holds
+static const void *s_blit_src;              // last lcd_blit() frame
+static async_memcpy_handle_t s_copier;
+// flips, under s_flip_lock
+static portMUX_TYPE s_flip_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_vsync_count;
+static uint32_t s_flip_at;                  // vsync that shows the handed-over buffer, 0: none
+static uint8_t  s_flip_fb;
+static uint32_t s_flips;
+static int64_t  s_flip_us;
+#endif
+
+// LVGL's pixels of the key colour in @p area take the underlay's. @p pic
+// holds the area at (@p x, @p y): the frame buffer (direct mode) or the draw
+// buffer the area was rendered to.
+static void key_over_underlay(const lv_area_t *area, const gfx_pic_t *pic, int x, int y)
+{
+    const gfx_pic_t under = {
+        .buf = (uint8_t *)s_underlay, .buf_size = (size_t)s_hres * s_vres * 3, .w = s_hres, .h = s_vres,
+    };
+    gfx_key_over(pic, x, y, &under, area->x1, area->y1,
+                 area->x2 - area->x1 + 1, area->y2 - area->y1 + 1, LCD_KEY_COLOR);
+}
+
+#if CONFIG_DISPLAY_DOUBLE_BUFFER
+// Direct mode: LVGL has drawn @p area straight into one of the panel's frame
+// buffers (@p px_map is its start). Nothing is copied. After the last area of
+// a refresh the buffer is written back from the cache (LVGL also copies the
+// areas it drew into the other buffer by CPU) and handed to the DPI driver,
+// which scans it from the next vsync on. LVGL gets flush-ready at that
+// vsync, once the other buffer is no longer on screen.
+void lvgl_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
+{
+    esp_lcd_panel_handle_t panel_handle = lv_display_get_user_data(disp);
+    if (s_underlay) {
+        const gfx_pic_t fb = { .buf = px_map, .buf_size = s_draw_buf_sz, .w = s_hres, .h = s_vres };
+        key_over_underlay(area, &fb, area->x1, area->y1);
+    }
+    if (!lv_display_flush_is_last(disp)) {
+        lv_display_flush_ready(disp);
+        return;
+    }
+    esp_cache_msync(px_map, s_draw_buf_sz, ESP_CACHE_MSYNC_FLAG_DIR_C2M);
+    portENTER_CRITICAL(&s_flip_lock);
+    s_flip_at = s_vsync_count + 1;
+    s_flip_fb = (px_map == s_fb[1]);
+    portEXIT_CRITICAL(&s_flip_lock);
+    // one row: the driver only needs the pointer, its own write-back stays short
+    esp_lcd_panel_draw_bitmap(panel_handle, 0, 0, s_hres, 1, px_map);
+}
+#else
 void lvgl_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
 {
     esp_lcd_panel_handle_t panel_handle = lv_display_get_user_data(disp);
+    if (s_underlay) {
+        const gfx_pic_t draw = {
+            .buf = px_map, .buf_size = s_draw_buf_sz,
+            .w = area->x2 - area->x1 + 1, .h = area->y2 - area->y1 + 1,
+        };
+        key_over_underlay(area, &draw, 0, 0);
+    }
+    s_flush_busy = true;
     int offsetx1 = area->x1;
     int offsetx2 = area->x2;
     int offsety1 = area->y1;
@@ -34,6 +112,7 @@ void lvgl_flush_cb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
     // pass the draw buffer to the driver
     esp_lcd_panel_draw_bitmap(panel_handle, offsetx1, offsety1, offsetx2 + 1, offsety2 + 1, px_map);
 }
+#endif
 
 void increase_lvgl_tick(void *arg)
 {
@@ -76,9 +155,195 @@ void lvgl_port_task(void *arg)
 
 bool notify_lvgl_flush_ready(esp_lcd_panel_handle_t panel, esp_lcd_dpi_panel_event_data_t *edata, void *user_ctx)
 {
+#if CONFIG_DISPLAY_DOUBLE_BUFFER
+    // a buffer hand-over, not a copy: LVGL is released by its flip
+    return false;
+#else
+    if (s_blit_busy) {
+        BaseType_t woken = pdFALSE;
+        s_blit_busy = false;
+        xSemaphoreGiveFromISR(s_blit_done, &woken);
+        return woken == pdTRUE;
+    }
+    s_flush_busy = false;
     lv_display_t *disp = (lv_display_t *)user_ctx;
     lv_display_flush_ready(disp);
     return false;
+#endif
+}
+
+// After a blit: the overlay has to go back over the new frame
+static void invalidate_overlay(void)
+{
+    lv_obj_t *scr = lv_screen_active();
+#if CONFIG_DISPLAY_DOUBLE_BUFFER
+    // The whole screen, not just the overlay objects: in DIRECT mode LVGL
+    // starts each refresh by copying the areas it redrew last time from the
+    // other buffer, which still holds the old frame, except where the screen
+    // is invalid now. The redraw keys the frame back in (key_over_underlay).
+    lv_obj_invalidate(scr);
+#else
+    for (uint32_t i = 0; i < lv_obj_get_child_count(scr); i++) {
+        lv_obj_invalidate(lv_obj_get_child(scr, i));
+    }
+#endif
+}
+
+void lcd_redraw_overlay(void)
+{
+    invalidate_overlay();
+    lv_refr_now(NULL);
+}
+
+#if CONFIG_DISPLAY_DOUBLE_BUFFER
+static bool copy_done(async_memcpy_handle_t mcp, async_memcpy_event_t *event, void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(s_blit_done, &woken);
+    return woken == pdTRUE;
+}
+
+static bool flip_pending(void)
+{
+    portENTER_CRITICAL(&s_flip_lock);
+    bool p = s_flip_at != 0;
+    portEXIT_CRITICAL(&s_flip_lock);
+    return p;
+}
+
+// Full frame @p src into frame buffer @p fb by GDMA, in LCD_COPY_CHUNK pieces
+static esp_err_t copy_frame(uint8_t *fb, const void *src)
+{
+    size_t sz = (size_t)s_hres * s_vres * 3;
+    // whatever the cache holds of the old contents must not be written back over the copy
+    esp_cache_msync(fb, sz, ESP_CACHE_MSYNC_FLAG_DIR_M2C);
+    xSemaphoreTake(s_blit_done, 0);     // stale give from a timed-out copy
+    for (size_t off = 0; off < sz; off += LCD_COPY_CHUNK) {
+        size_t n = (sz - off < LCD_COPY_CHUNK) ? sz - off : LCD_COPY_CHUNK;
+        ESP_RETURN_ON_ERROR(esp_async_memcpy(s_copier, fb + off, (uint8_t *)src + off, n, copy_done, NULL),
+                            TAG, "frame copy");
+        if (xSemaphoreTake(s_blit_done, pdMS_TO_TICKS(LCD_BLIT_TIMEOUT_MS)) != pdTRUE) return ESP_ERR_TIMEOUT;
+    }
+    esp_cache_msync(fb, sz, ESP_CACHE_MSYNC_FLAG_DIR_M2C);
+    return ESP_OK;
+}
+
+// Double-buffered: the frame goes into the buffer LVGL renders next, which
+// is off screen once the last flip is done; the next LVGL refresh puts it on
+// screen (callers redraw the overlay: lcd_redraw_overlay()). The other
+// buffer is brought up to it before LVGL next draws there (on_refr_start).
+esp_err_t lcd_blit(int x1, int y1, int x2, int y2, const void *px)
+{
+    if (s_disp == NULL) return ESP_ERR_INVALID_STATE;
+    if (x1 != 0 || y1 != 0 || x2 != s_hres || y2 != s_vres) return ESP_ERR_NOT_SUPPORTED;
+    for (int ms = 0; flip_pending(); ms++) {
+        if (ms == LCD_BLIT_TIMEOUT_MS) return ESP_ERR_TIMEOUT;
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    uint8_t *fb = lv_display_get_buf_active(s_disp)->data;
+    int i = (fb == s_fb[1]);
+    s_blit_src  = px;
+    s_fb_src[i] = NULL;
+    esp_err_t err = copy_frame(fb, px);
+    if (err == ESP_OK) s_fb_src[i] = px;
+    return err;
+}
+
+// Before each LVGL refresh: wait out a flip still pending (LVGL is about to
+// draw into the buffer on screen until then) and give the buffer it draws
+// into the last lcd_blit() frame if it missed it, with the overlay redrawn
+static void on_refr_start(lv_event_t *e)
+{
+    for (int ms = 0; flip_pending() && ms < LCD_BLIT_TIMEOUT_MS; ms++) vTaskDelay(pdMS_TO_TICKS(1));
+    uint8_t *fb = lv_display_get_buf_active(s_disp)->data;
+    int i = (fb == s_fb[1]);
+    if (s_blit_src == NULL || s_fb_src[i] == s_blit_src) return;
+    if (copy_frame(fb, s_blit_src) != ESP_OK) {
+        ESP_LOGW(TAG, "frame buffer %d missed the stimulus frame", i);
+        return;
+    }
+    s_fb_src[i] = s_blit_src;
+    invalidate_overlay();
+}
+
+bool lcd_last_flip(int64_t *t_us, uint32_t *count)
+{
+    portENTER_CRITICAL(&s_flip_lock);
+    int64_t t = s_flip_us;
+    uint32_t n = s_flips;
+    portEXIT_CRITICAL(&s_flip_lock);
+    if (t_us) *t_us = t;
+    if (count) *count = n;
+    return n != 0;
+}
+#else
+esp_err_t lcd_blit(int x1, int y1, int x2, int y2, const void *px)
+{
+    if (s_panel == NULL) return ESP_ERR_INVALID_STATE;
+    // LVGL's last flush of a refresh may still be copying
+    for (int ms = 0; s_flush_busy; ms++) {
+        if (ms == LCD_BLIT_TIMEOUT_MS) return ESP_ERR_TIMEOUT;
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    xSemaphoreTake(s_blit_done, 0);     // stale give from a timed-out copy
+    s_blit_busy = true;
+    esp_err_t err = esp_lcd_panel_draw_bitmap(s_panel, x1, y1, x2, y2, px);
+    if (err != ESP_OK) {
+        s_blit_busy = false;
+        return err;
+    }
+    if (xSemaphoreTake(s_blit_done, pdMS_TO_TICKS(LCD_BLIT_TIMEOUT_MS)) != pdTRUE) {
+        s_blit_busy = false;
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+bool lcd_last_flip(int64_t *t_us, uint32_t *count)
+{
+    return false;
+}
+#endif
+
+void lcd_set_underlay(const uint8_t *frame)
+{
+    s_underlay = frame;
+}
+
+// The DPI DMA has read the whole frame buffer; the panel starts the next frame
+bool notify_refresh_done(esp_lcd_panel_handle_t panel, esp_lcd_dpi_panel_event_data_t *edata, void *user_ctx)
+{
+    int64_t now = esp_timer_get_time();
+#if CONFIG_DISPLAY_DOUBLE_BUFFER
+    // the driver has just pointed the DMA at the buffer it was last handed:
+    // a flip queued before this vsync is on screen from now
+    bool flipped = false;
+    uint8_t fb = 0;
+    uint32_t n = 0;
+    portENTER_CRITICAL_ISR(&s_flip_lock);
+    s_vsync_count++;
+    if (s_flip_at != 0 && s_vsync_count >= s_flip_at) {
+        s_flip_at = 0;
+        s_flip_us = now;
+        n = ++s_flips;
+        fb = s_flip_fb;
+        flipped = true;
+    }
+    portEXIT_CRITICAL_ISR(&s_flip_lock);
+    if (flipped) {
+        journal_post(now, JR_FLIP, fb, (uint16_t)n);
+        lv_display_flush_ready((lv_display_t *)user_ctx);
+    }
+#endif
+    lcd_vsync_cb_t cb = s_vsync_cb;
+    return cb ? cb(now, s_vsync_ctx) : false;
+}
+
+void lcd_set_vsync_cb(lcd_vsync_cb_t cb, void *ctx)
+{
+    s_vsync_cb  = NULL;
+    s_vsync_ctx = ctx;
+    s_vsync_cb  = cb;
 }
 
 void bsp_enable_dsi_phy_power(void)
@@ -130,7 +395,10 @@ lv_display_t* lcd_init()
 
     ESP_LOGI(TAG, "Install EK79007S panel driver");
     esp_lcd_panel_handle_t panel_handle = NULL;
-    const esp_lcd_dpi_panel_config_t dpi_config = EK79007_1024_600_PANEL_60HZ_CONFIG(LCD_COLOR_PIXEL_FORMAT_RGB888);
+    esp_lcd_dpi_panel_config_t dpi_config = EK79007_1024_600_PANEL_60HZ_CONFIG(LCD_COLOR_PIXEL_FORMAT_RGB888);
+#if CONFIG_DISPLAY_DOUBLE_BUFFER
+    dpi_config.num_fbs = LCD_NUM_FBS;
+#endif
     ek79007_vendor_config_t vendor_config = {
         .flags = {
             .use_mipi_interface = 1,
@@ -149,6 +417,14 @@ lv_display_t* lcd_init()
     ESP_ERROR_CHECK(esp_lcd_new_panel_ek79007(mipi_dbi_io, &panel_config, &panel_handle));
     ESP_ERROR_CHECK(esp_lcd_panel_reset(panel_handle));
     ESP_ERROR_CHECK(esp_lcd_panel_init(panel_handle));
+#if CONFIG_EXAMPLE_USE_DMA2D_COPY_FRAME && !CONFIG_DISPLAY_DOUBLE_BUFFER
+    // frame-buffer copies (LVGL flushes, lcd_blit) by 2D-DMA instead of memcpy
+    ESP_ERROR_CHECK(esp_lcd_dpi_panel_enable_dma2d(panel_handle));
+#endif
+    s_panel = panel_handle;
+    s_blit_done = xSemaphoreCreateBinary();
+    assert(s_blit_done);
+    if (gfx_init() != ESP_OK) ESP_LOGW(TAG, "2D fills and keying on the CPU");
 
     //ESP_ERROR_CHECK(esp_lcd_panel_disp_on_off(panel_handle, true));
 
@@ -156,8 +432,24 @@ lv_display_t* lcd_init()
     lv_init();
     // create a lvgl display
     lv_display_t *display = lv_display_create(MIPI_DSI_LCD_V_RES, MIPI_DSI_LCD_H_RES);
+    s_hres = MIPI_DSI_LCD_V_RES;
+    s_vres = MIPI_DSI_LCD_H_RES;
     // associate the mipi panel handle to the display
     lv_display_set_user_data(display, panel_handle);
+#if CONFIG_DISPLAY_DOUBLE_BUFFER
+    ESP_LOGI(TAG, "Render straight into the panel's %d frame buffers", LCD_NUM_FBS);
+    void *fb0 = NULL;
+    void *fb1 = NULL;
+    ESP_ERROR_CHECK(esp_lcd_dpi_panel_get_frame_buffer(panel_handle, LCD_NUM_FBS, &fb0, &fb1));
+    s_fb[0] = fb0;
+    s_fb[1] = fb1;
+    s_disp = display;
+    s_draw_buf_sz = (size_t)s_hres * s_vres * 3;
+    lv_display_set_buffers(display, fb0, fb1, s_draw_buf_sz, LV_DISPLAY_RENDER_MODE_DIRECT);
+    lv_display_add_event_cb(display, on_refr_start, LV_EVENT_REFR_START, NULL);
+    async_memcpy_config_t copier_config = ASYNC_MEMCPY_DEFAULT_CONFIG();
+    ESP_ERROR_CHECK(esp_async_memcpy_install_gdma_axi(&copier_config, &s_copier));
+#else
     // create draw buffer
     void *buf1 = NULL;
     void *buf2 = NULL;
@@ -166,21 +458,25 @@ lv_display_t* lcd_init()
     // Note:
     // Keep the display buffer in **internal** RAM can speed up the UI because LVGL uses it a lot and it should have a fast access time
     // This example allocate the buffer from PSRAM mainly because we want to save the internal RAM
+    // Cache-line aligned: the PPA writes keyed areas back into them (gfx.h)
     size_t draw_buffer_sz = MIPI_DSI_LCD_H_RES * LVGL_DRAW_BUF_LINES * sizeof(lv_color_t);
-    buf1 = heap_caps_malloc(draw_buffer_sz, MALLOC_CAP_SPIRAM);
+    s_draw_buf_sz = draw_buffer_sz;
+    buf1 = heap_caps_aligned_alloc(GFX_ALIGN, draw_buffer_sz, MALLOC_CAP_SPIRAM);
     assert(buf1);
-    buf2 = heap_caps_malloc(draw_buffer_sz, MALLOC_CAP_SPIRAM);
+    buf2 = heap_caps_aligned_alloc(GFX_ALIGN, draw_buffer_sz, MALLOC_CAP_SPIRAM);
     assert(buf2);
     // initialize LVGL draw buffers
     lv_display_set_buffers(display, buf1, buf2, draw_buffer_sz, LV_DISPLAY_RENDER_MODE_PARTIAL);
+#endif
     // set color depth
     lv_display_set_color_format(display, LV_COLOR_FORMAT_RGB888);
     // set the callback which can copy the rendered image to an area of the display
     lv_display_set_flush_cb(display, lvgl_flush_cb);
 
-    ESP_LOGI(TAG, "Register DPI panel event callback for LVGL flush ready notification");
+    ESP_LOGI(TAG, "Register DPI panel event callbacks for LVGL flush ready and vsync");
     esp_lcd_dpi_panel_event_callbacks_t cbs = {
         .on_color_trans_done = notify_lvgl_flush_ready,
+        .on_refresh_done = notify_refresh_done,
    };
     ESP_ERROR_CHECK(esp_lcd_dpi_panel_register_event_callbacks(panel_handle, &cbs, display));
 
@@ -198,7 +494,8 @@ lv_display_t* lcd_init()
     assert(lvgl_api_mux);
 
     ESP_LOGI(TAG, "Create LVGL task");
-    xTaskCreate(lvgl_port_task, "LVGL", LVGL_TASK_STACK_SIZE, NULL, LVGL_TASK_PRIORITY, NULL);
+    xTaskCreatePinnedToCore(lvgl_port_task, "LVGL", LVGL_TASK_STACK_SIZE, NULL,
+                            LVGL_TASK_PRIORITY, NULL, LVGL_TASK_CORE);
 
     return display;
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "lvgl.h"
 
@@ -22,10 +24,36 @@
 #define LVGL_TASK_MAX_DELAY_MS 20
 #define LVGL_TASK_MIN_DELAY_MS 1
 #define LVGL_TASK_STACK_SIZE   (8 * 1024)
-#define LVGL_TASK_PRIORITY     7
+#define LVGL_TASK_PRIORITY     3    // below the trial/UI rate groups
+#define LVGL_TASK_CORE         1    // core 0 belongs to the input/control groups
+#define LCD_KEY_COLOR          0x010001 // LVGL pixels of this colour show the underlay (stimfb.h)
+#define LCD_BLIT_TIMEOUT_MS    100
+#define LCD_NUM_FBS            2    // CONFIG_DISPLAY_DOUBLE_BUFFER: the DPI panel's frame buffers
+#define LCD_COPY_CHUNK         (MIPI_DSI_LCD_V_RES * 3 * 64) // bytes per GDMA frame-copy request (64 rows)
+
+// Called from the panel's refresh-done interrupt once per frame (vsync),
+// with the esp_timer time; return true if a higher-priority task was woken.
+typedef bool (*lcd_vsync_cb_t)(int64_t t_us, void *ctx);
 
 extern SemaphoreHandle_t lvgl_api_mux;
 bool lvgl_lock(int timeout_ms);
 void lvgl_unlock(void);
 void bsp_set_lcd_backlight(uint32_t level);
-lv_display_t* lcd_init();
\ No newline at end of file
+lv_display_t* lcd_init();
+void lcd_set_vsync_cb(lcd_vsync_cb_t cb, void *ctx);
+// Copy pixels (RGB888, LVGL byte order) to the rectangle x1..x2-1, y1..y2-1
+// of the panel frame buffer, outside LVGL. Call with the LVGL lock held so
+// no new LVGL flush starts; returns once the copy is done. Double-buffered
+// (CONFIG_DISPLAY_DOUBLE_BUFFER) only full frames, which go to the back
+// buffer and show from the flip of the next LVGL refresh.
+esp_err_t lcd_blit(int x1, int y1, int x2, int y2, const void *px);
+// Full-screen frame shown wherever LVGL draws LCD_KEY_COLOR; NULL for none.
+void lcd_set_underlay(const uint8_t *frame);
+// Redraw the active screen's objects over what lcd_blit() left, at once
+// (lv_refr_now); double-buffered this redraws the whole screen over the
+// frame and is the refresh that flips. LVGL lock held.
+void lcd_redraw_overlay(void);
+// Double-buffered: vsync time from which the last flip was on screen, and
+// the number of flips so far; false before the first (or single-buffered).
+// Every flip also goes to the journal (JR_FLIP).
+bool lcd_last_flip(int64_t *t_us, uint32_t *count);
\ No newline at end of file
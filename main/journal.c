@@ -0,0 +1,96 @@
+// main/journal.c
+//
+// Entries come from interrupts (RMT tx-done, GPIO edges) as well as tasks on
+// both cores, and are only 8 bytes, so the ring is guarded by a spinlock
+// rather than telemetry's per-slot sequence numbers. The writer task packs
+// what has accumulated into TLM_JOURNAL records every JOURNAL_FLUSH_MS.
+#include "journal.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "telemetry.h"
+
+static const char *TAG = "JOURNAL";
+
+#define JOURNAL_MASK    (JOURNAL_SLOTS - 1)
+
+_Static_assert((JOURNAL_SLOTS & JOURNAL_MASK) == 0, "ring size must be a power of two");
+_Static_assert(sizeof(tlm_journal_t) <= TELEMETRY_MAX_PAYLOAD, "tlm_journal_t too large");
+_Static_assert(sizeof(journal_entry_t) == sizeof(((tlm_journal_t *)0)->e[0]), "entry layout");
+
+static journal_entry_t s_ring[JOURNAL_SLOTS];
+static unsigned        s_head, s_tail;
+static uint32_t        s_dropped;
+static portMUX_TYPE    s_lock = portMUX_INITIALIZER_UNLOCKED;
+static atomic_bool     s_ready;
+
+void journal_post(int64_t t_us, journal_kind_t kind, uint8_t val, uint16_t arg)
+{
+    if (!atomic_load_explicit(&s_ready, memory_order_acquire)) return;
+
+    journal_entry_t e = { .t_us = (uint32_t)t_us, .kind = kind, .val = val, .arg = arg };
+    portENTER_CRITICAL_SAFE(&s_lock);
+    if (s_head - s_tail < JOURNAL_SLOTS) {
+        s_ring[s_head++ & JOURNAL_MASK] = e;
+    } else {
+        s_dropped++;
+    }
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+static void journal_task(void *pv)
+{
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(JOURNAL_FLUSH_MS));
+
+        for (;;) {
+            tlm_journal_t r = { 0 };
+            portENTER_CRITICAL(&s_lock);
+            while (r.n < JOURNAL_BATCH && s_tail != s_head) {
+                memcpy(&r.e[r.n++], &s_ring[s_tail++ & JOURNAL_MASK], sizeof(journal_entry_t));
+            }
+            portEXIT_CRITICAL(&s_lock);
+            if (r.n == 0) break;
+            // a full telemetry ring already counts the loss there
+            telemetry_post(TLM_JOURNAL, &r, sizeof(r));
+        }
+    }
+}
+
+esp_err_t journal_init(void)
+{
+    ESP_RETURN_ON_FALSE(!atomic_load(&s_ready), ESP_ERR_INVALID_STATE, TAG, "already initialized");
+    BaseType_t ok = xTaskCreatePinnedToCore(journal_task, "journal", 3072, NULL,
+                                            JOURNAL_TASK_PRIO, NULL, JOURNAL_TASK_CORE);
+    ESP_RETURN_ON_FALSE(ok == pdPASS, ESP_ERR_NO_MEM, TAG, "journal task create failed");
+    atomic_store_explicit(&s_ready, true, memory_order_release);
+    return ESP_OK;
+}
+
+static void gpio_edge_isr(void *arg)
+{
+    gpio_num_t pin = (gpio_num_t)(intptr_t)arg;
+    journal_post(esp_timer_get_time(), JR_TTL, (uint8_t)gpio_get_level(pin), (uint16_t)pin);
+}
+
+esp_err_t journal_watch_gpio(gpio_num_t pin)
+{
+    // the ISR service may already be installed by another driver
+    esp_err_t err = gpio_install_isr_service(0);
+    ESP_RETURN_ON_FALSE(err == ESP_OK || err == ESP_ERR_INVALID_STATE, err, TAG, "gpio isr service");
+    ESP_RETURN_ON_ERROR(gpio_set_direction(pin, GPIO_MODE_INPUT_OUTPUT), TAG, "GPIO%d loopback", pin);
+    ESP_RETURN_ON_ERROR(gpio_set_intr_type(pin, GPIO_INTR_ANYEDGE), TAG, "GPIO%d edges", pin);
+    ESP_RETURN_ON_ERROR(gpio_isr_handler_add(pin, gpio_edge_isr, (void *)(intptr_t)pin),
+                        TAG, "GPIO%d handler", pin);
+    return gpio_intr_enable(pin);
+}
+
+uint32_t journal_dropped(void)
+{
+    return s_dropped;
+}
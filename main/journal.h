@@ -0,0 +1,79 @@
+// main/journal.h
+#pragma once
+
+#include <stdint.h>
+#include "driver/gpio.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Event journal: the device time of everything the acquisition system sees
+ * on its digital and audio inputs, for offline alignment.
+ *
+ *   JR_MARKER   event pin, first rising edge of a marker; taken in the RMT
+ *               tx-done interrupt (done time minus the transmission length)
+ *   JR_TTL      a watched output pin changed level (reward TTL); taken in the
+ *               pin's own edge interrupt, the pin reading itself back
+ *   JR_TONE     speaker on/off; the sample-exact time the audio interrupt
+ *               scheduled it for (audio.h)
+ *   JR_SYNC     clock-sync pulse on a dedicated pin (clocksync.h)
+ *   JR_VISUAL   first frame that shows a committed stimulus whole; the
+ *               panel's vsync interrupt (stim.h)
+ *   JR_FLIP     double-buffered display switched frame buffers; the vsync
+ *               interrupt the new one is scanned from (graphics.h)
+ *
+ * Entries are posted from interrupts or tasks on either core into a small
+ * ring; a writer task sends them JOURNAL_BATCH to a TLM_JOURNAL record.
+ */
+
+#define JOURNAL_SLOTS       256     // power of two
+#define JOURNAL_BATCH       3       // entries per TLM_JOURNAL record
+#define JOURNAL_FLUSH_MS    10
+#define JOURNAL_TASK_PRIO   2
+#define JOURNAL_TASK_CORE   1
+
+typedef enum {
+    JR_MARKER = 1,      // val: event_state_t, arg: low 16 bits of the trial
+    JR_TTL    = 2,      // val: new level, arg: GPIO number
+    JR_TONE   = 3,      // val: 1 on / 0 off, arg: frequency in Hz (0 when off)
+    JR_SYNC   = 4,      // clock-sync pulse on its own pin, arg: low 16 bits of its number
+    JR_VISUAL = 5,      // val: STIM_F_* flags, arg: low 16 bits of the trial
+    JR_FLIP   = 6,      // val: frame buffer now on screen, arg: low 16 bits of the flip count
+} journal_kind_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t t_us;      // esp_timer time (low 32 bits)
+    uint8_t  kind;      // journal_kind_t
+    uint8_t  val;
+    uint16_t arg;
+} journal_entry_t;
+
+/**
+ * @brief  Start the writer task. Until this is called journal_post() is a
+ *         no-op, so modes without a journal pay nothing.
+ */
+esp_err_t journal_init(void);
+
+/**
+ * @brief  Record one entry. Safe from interrupts and tasks on either core;
+ *         drops (and counts) the entry if the ring is full.
+ */
+void journal_post(int64_t t_us, journal_kind_t kind, uint8_t val, uint16_t arg);
+
+/**
+ * @brief  Journal every level change of an output pin from its own edge
+ *         interrupt (the pin's input is enabled so it reads itself back).
+ */
+esp_err_t journal_watch_gpio(gpio_num_t pin);
+
+/**
+ * @brief  Entries lost to a full ring since boot.
+ */
+uint32_t journal_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,71 @@
+// main/kinbus.c
+//
+// Single-writer / multi-reader seqlock. The sequence number is odd while the
+// writer is updating the payload; a reader that sees an odd sequence, or a
+// different sequence before and after its copy, simply copies again.
+#include "kinbus.h"
+#include <stdatomic.h>
+
+static atomic_uint           s_seq;
+static volatile kin_sample_t s_sample;
+static atomic_uint           s_retries;
+
+void kinbus_init(void)
+{
+    atomic_store_explicit(&s_seq, 0, memory_order_relaxed);
+    atomic_store_explicit(&s_retries, 0, memory_order_relaxed);
+    s_sample.pos   = 0;
+    s_sample.vel   = 0.0f;
+    s_sample.t_us  = 0;
+    s_sample.index = 0;
+}
+
+void kinbus_publish(const kin_sample_t *sample)
+{
+    unsigned seq = atomic_load_explicit(&s_seq, memory_order_relaxed);
+
+    atomic_store_explicit(&s_seq, seq + 1, memory_order_relaxed);   // odd: write in progress
+    atomic_thread_fence(memory_order_release);
+
+    s_sample.pos   = sample->pos;
+    s_sample.vel   = sample->vel;
+    s_sample.t_us  = sample->t_us;
+    s_sample.index = sample->index;
+
+    atomic_store_explicit(&s_seq, seq + 2, memory_order_release);   // even: stable
+}
+
+void kinbus_read(kin_sample_t *out)
+{
+    unsigned s1, s2;
+
+    for (;;) {
+        s1 = atomic_load_explicit(&s_seq, memory_order_acquire);
+        if (s1 & 1u) {
+            atomic_fetch_add_explicit(&s_retries, 1, memory_order_relaxed);
+            continue;
+        }
+
+        out->pos   = s_sample.pos;
+        out->vel   = s_sample.vel;
+        out->t_us  = s_sample.t_us;
+        out->index = s_sample.index;
+
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&s_seq, memory_order_relaxed);
+        if (s1 == s2) return;
+        atomic_fetch_add_explicit(&s_retries, 1, memory_order_relaxed);
+    }
+}
+
+int32_t kinbus_pos(void)
+{
+    kin_sample_t s;
+    kinbus_read(&s);
+    return s.pos;
+}
+
+uint32_t kinbus_read_retries(void)
+{
+    return atomic_load_explicit(&s_retries, memory_order_relaxed);
+}
@@ -0,0 +1,50 @@
+// main/kinbus.h
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * One kinematic sample, published as a unit so readers never see a
+ * position from one tick paired with a velocity/timestamp from another.
+ */
+typedef struct {
+    int32_t  pos;     // accumulated encoder count
+    float    vel;     // low-pass filtered velocity, counts/s
+    int64_t  t_us;    // esp_timer_get_time() when the encoder was read
+    uint32_t index;   // sample number since kinbus_init()
+} kin_sample_t;
+
+/**
+ * @brief  Clear the bus (sample index 0, everything zeroed).
+ */
+void kinbus_init(void);
+
+/**
+ * @brief  Publish a new sample. Single writer only (the rtexec input stage);
+ *         never blocks.
+ */
+void kinbus_publish(const kin_sample_t *sample);
+
+/**
+ * @brief  Copy the latest sample. Lock-free: retries only while a publish is
+ *         in flight, so readers never block the writer (or each other).
+ */
+void kinbus_read(kin_sample_t *out);
+
+/**
+ * @brief  Shortcut for kinbus_read(&s), s.pos.
+ */
+int32_t kinbus_pos(void);
+
+/**
+ * @brief  Number of reads that had to retry because they overlapped a publish.
+ */
+uint32_t kinbus_read_retries(void);
+
+#ifdef __cplusplus
+}
+#endif
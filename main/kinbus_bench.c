@@ -0,0 +1,197 @@
+// main/kinbus_bench.c
+//
+// Contention benchmark: kinbus seqlock vs. the old encoder_mutex design.
+// Mode "bench-kin" (app_mode.h): MODE bench-kin, results on the console.
+//
+// One writer publishes at 5 kHz (core 0, prio 10, like the control loop)
+// while two readers hammer the latest sample: one on the writer's core at a
+// lower priority (so it can be preempted while holding the mutex) and one on
+// core 1. Reports per-call cost of publish and read for both designs.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_cpu.h"
+#include "esp_err.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "app_mode.h"
+#include "kinbus.h"
+
+#define BENCH_DURATION_MS   2000
+#define WRITER_PERIOD_US    200     // 5 kHz
+#define READER_YIELD_EVERY  256     // let IDLE run so the task WDT stays fed
+
+typedef struct {
+    uint32_t n;
+    uint64_t sum;
+    uint32_t max;
+} bench_stat_t;
+
+static volatile bool         s_run;
+static bool                  s_use_mutex;
+static SemaphoreHandle_t     s_mutex;
+static volatile kin_sample_t s_locked;      // mutex-protected copy (old design)
+static TaskHandle_t          s_writer;
+static esp_timer_handle_t    s_tick;
+static bench_stat_t          s_write;
+static bench_stat_t          s_read[2];
+
+static void stat_add(bench_stat_t *st, uint32_t cycles)
+{
+    st->n++;
+    st->sum += cycles;
+    if (cycles > st->max) st->max = cycles;
+}
+
+static void bench_publish(const kin_sample_t *k)
+{
+    if (s_use_mutex) {
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        s_locked.pos   = k->pos;
+        s_locked.vel   = k->vel;
+        s_locked.t_us  = k->t_us;
+        s_locked.index = k->index;
+        xSemaphoreGive(s_mutex);
+    } else {
+        kinbus_publish(k);
+    }
+}
+
+static void bench_read(kin_sample_t *out)
+{
+    if (s_use_mutex) {
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        out->pos   = s_locked.pos;
+        out->vel   = s_locked.vel;
+        out->t_us  = s_locked.t_us;
+        out->index = s_locked.index;
+        xSemaphoreGive(s_mutex);
+    } else {
+        kinbus_read(out);
+    }
+}
+
+static void writer_tick_cb(void *arg)
+{
+    xTaskNotifyGive(s_writer);
+}
+
+static void writer_task(void *pv)
+{
+    kin_sample_t k = { 0 };
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!s_run) continue;
+        k.pos++;
+        k.vel   = (float)k.pos;
+        k.t_us  = esp_timer_get_time();
+        k.index++;
+
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        bench_publish(&k);
+        stat_add(&s_write, esp_cpu_get_cycle_count() - t0);
+    }
+}
+
+static void reader_task(void *pv)
+{
+    bench_stat_t *st = &s_read[(int)(intptr_t)pv];
+    kin_sample_t  k;
+    uint32_t      n = 0;
+
+    while (1) {
+        if (!s_run) {
+            vTaskDelay(1);
+            continue;
+        }
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        bench_read(&k);
+        stat_add(st, esp_cpu_get_cycle_count() - t0);
+        if (++n % READER_YIELD_EVERY == 0) vTaskDelay(1);
+    }
+}
+
+static void print_stat(const char *name, const bench_stat_t *st, uint32_t cyc_per_us)
+{
+    float mean = st->n ? (float)st->sum / st->n : 0.0f;
+    printf("  %-16s n=%-9lu mean=%7.2f us  max=%8.2f us\n",
+           name, (unsigned long)st->n,
+           mean / cyc_per_us, (float)st->max / cyc_per_us);
+}
+
+static void run_one(bool use_mutex)
+{
+    s_use_mutex = use_mutex;
+    s_write   = (bench_stat_t){ 0 };
+    s_read[0] = (bench_stat_t){ 0 };
+    s_read[1] = (bench_stat_t){ 0 };
+    kinbus_init();
+
+    s_run = true;
+    vTaskDelay(pdMS_TO_TICKS(BENCH_DURATION_MS));
+    s_run = false;
+    vTaskDelay(pdMS_TO_TICKS(50));
+
+    uint32_t cyc_per_us = esp_rom_get_cpu_ticks_per_us();
+    printf("%s:\n", use_mutex ? "mutex (encoder_mutex design)" : "seqlock (kinbus)");
+    print_stat("publish", &s_write, cyc_per_us);
+    print_stat("read core0/p5", &s_read[0], cyc_per_us);
+    print_stat("read core1/p5", &s_read[1], cyc_per_us);
+    if (!use_mutex) {
+        printf("  read retries     %lu\n", (unsigned long)kinbus_read_retries());
+    }
+}
+
+static void bench_task(void *pv)
+{
+    ESP_ERROR_CHECK(esp_timer_start_periodic(s_tick, WRITER_PERIOD_US));
+
+    printf("kinbus contention benchmark: writer %d Hz, %d ms per design\n",
+           1000000 / WRITER_PERIOD_US, BENCH_DURATION_MS);
+    run_one(true);
+    run_one(false);
+
+    esp_timer_stop(s_tick);
+    printf("Done.\n");
+    vTaskDelete(NULL);
+}
+
+// ───────────── mode "bench-kin" ─────────────
+
+static esp_err_t bench_kin_init(void)
+{
+    s_mutex = xSemaphoreCreateMutex();
+    if (s_mutex == NULL) return ESP_ERR_NO_MEM;
+
+    const esp_timer_create_args_t tick_args = {
+        .callback = writer_tick_cb,
+        .name     = "bench_tick",
+    };
+    return esp_timer_create(&tick_args, &s_tick);
+}
+
+static esp_err_t bench_kin_run(void)
+{
+    xTaskCreatePinnedToCore(writer_task, "bench_w",  4096, NULL,      10, &s_writer, 0);
+    xTaskCreatePinnedToCore(reader_task, "bench_r0", 4096, (void *)0,  5, NULL,      0);
+    xTaskCreatePinnedToCore(reader_task, "bench_r1", 4096, (void *)1,  5, NULL,      1);
+    xTaskCreatePinnedToCore(bench_task,  "bench_kin", 4096, NULL,      4, NULL,      1);
+    return ESP_OK;
+}
+
+static void bench_kin_teardown(void)
+{
+    s_run = false;
+    esp_timer_stop(s_tick);
+}
+
+const app_mode_t mode_bench_kin = {
+    .name     = "bench-kin",
+    .help     = "kinbus seqlock vs. mutex contention benchmark",
+    .init     = bench_kin_init,
+    .run      = bench_kin_run,
+    .teardown = bench_kin_teardown,
+};
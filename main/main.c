@@ -0,0 +1,83 @@
+// main/main.c
+//
+// One image for every task mode: shared bring-up here, then the mode stored
+// in NVS (MODE <name> over the serial console switches it, see app_mode.h).
+#include <stdio.h>
+#include <strings.h>
+#include "app_mode.h"
+#include "audio.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "event.h"
+#include "graphics.h"
+#include "journal.h"
+#include "nvs_flash.h"
+#include "rtexec.h"
+#include "rtstats.h"
+#include "sdkconfig.h"
+#include "serial_cmd.h"
+#include "stim.h"
+#include "telemetry.h"
+
+static const char *TAG = "MAIN";
+
+// STATS [HIST|RESET]: rate-group counters and timing histograms
+static void cmd_stats(const char *args)
+{
+    if (strcasecmp(args, "RESET") == 0) {
+        rtstats_reset_all();
+        printf("stats cleared\n");
+        return;
+    }
+    rtexec_dump();
+    rtstats_dump(strcasecmp(args, "HIST") == 0);
+
+    event_stats_t ev;
+    event_get_stats(&ev);
+    printf("markers: %lu sent, %lu overlaps (%lu deferred, %lu preempted), %lu truncated, "
+           "%lu dropped, max late %lu us\n",
+           (unsigned long)ev.sent, (unsigned long)ev.overlaps, (unsigned long)ev.deferred,
+           (unsigned long)ev.preempted, (unsigned long)ev.truncated, (unsigned long)ev.dropped,
+           (unsigned long)ev.max_late_us);
+    printf("journal: %lu dropped\n", (unsigned long)journal_dropped());
+
+    audio_stats_t au;
+    audio_get_stats(&au);
+    printf("audio: %lu plays, scheduled %d us after request (rounding max %lu us), %lu late (max %lu us)\n",
+           (unsigned long)au.plays, AUDIO_LATENCY_US, (unsigned long)au.max_round_us,
+           (unsigned long)au.late, (unsigned long)au.max_late_us);
+
+    stim_stats_t st;
+    stim_get_stats(&st);
+    printf("stimuli: %lu commits, %lu slipped a frame, %lu without vsync, %lu cancelled, %lu cut short, "
+           "max |audio - vsync| %lu us, max |marker - vsync| %lu us\n",
+           (unsigned long)st.commits, (unsigned long)st.slipped, (unsigned long)st.no_vsync,
+           (unsigned long)st.cancelled, (unsigned long)st.cut_short,
+           (unsigned long)st.max_audio_us, (unsigned long)st.max_marker_us);
+}
+
+void app_main(void)
+{
+    esp_err_t nvs_err = nvs_flash_init();
+    if (nvs_err == ESP_ERR_NVS_NO_FREE_PAGES || nvs_err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        nvs_err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(nvs_err);
+    ESP_ERROR_CHECK(telemetry_init());   // console UART → TELEMETRY_UART_BAUD from here on
+    ESP_ERROR_CHECK(serial_cmd_init());
+    ESP_ERROR_CHECK(serial_cmd_register("STATS", cmd_stats, "[HIST|RESET] timing report"));
+
+    // display; modes draw on lv_display_get_default()
+    lcd_init();
+    bsp_set_lcd_backlight(1);
+
+    ESP_ERROR_CHECK(app_mode_register(&mode_task));
+    ESP_ERROR_CHECK(app_mode_register(&mode_pidtune));
+    ESP_ERROR_CHECK(app_mode_register(&mode_levertest));
+    ESP_ERROR_CHECK(app_mode_register(&mode_bench_kin));
+    ESP_ERROR_CHECK(app_mode_register(&mode_bench_motor));
+    ESP_ERROR_CHECK(app_mode_register(&mode_bench_gfx));
+    ESP_LOGI(TAG, "modes registered, default '%s'", CONFIG_APP_DEFAULT_MODE);
+    ESP_ERROR_CHECK(app_mode_boot(CONFIG_APP_DEFAULT_MODE));
+}
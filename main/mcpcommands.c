@@ -1,30 +1,8 @@
 #include <stdint.h>
 #include "driver/uart.h"
+#include "crc16.h"
+#include "mcpcommands.h"
 
-enum{
-    LEVER_PULL_BACK = 0,
-    LEVER_PUSH_FORWARDS = 1,
-    LEVER_NOT_ACTUATED = 2
-};
-
-
-uint16_t crc16(uint8_t *packet, int nBytes) {
-	uint16_t crc=0;
-    for (int byte = 0; byte < nBytes; byte++) {
-        crc = crc ^ ((uint16_t)packet[byte] << 8);
-        for (unsigned char bit = 0; bit < 8; bit++) {
-            if (crc & 0x8000)
-            {
-                crc = (crc << 1) ^ 0x1021;
-            }
-            else
-            {
-                    crc = crc << 1;
-            }
-        }
-    }
-    return crc;
-}
 
 void send_message(uint8_t command, uint8_t value){
 	uint8_t send_buffer[5];
@@ -32,7 +10,7 @@ void send_message(uint8_t command, uint8_t value){
 	send_buffer[0] = 128;
 	send_buffer[1] = command;
 	send_buffer[2] = value;
-	crc = crc16(send_buffer, 3);
+	crc = crc16_xmodem(send_buffer, 3);
 	send_buffer[4] = crc;
 	send_buffer[3] = crc >> 8;
 
@@ -91,7 +69,7 @@ void drive_M1(int accel, int speed, int deccel, int position){
 	send_buffer[16] = position >> 8;
 	send_buffer[17] = position;
 
-	crc = crc16(send_buffer, 18);
+	crc = crc16_xmodem(send_buffer, 18);
 
 	send_buffer[18] = crc >> 8;
 	send_buffer[19] = crc;
@@ -151,7 +129,7 @@ void update_PID(float P_fp, float I_fp, float D_fp, uint32_t maxI, uint32_t dead
 	send_buffer[28] = maxpos>>8;
 	send_buffer[29] = maxpos;
 
-	crc = crc16(send_buffer, 30);
+	crc = crc16_xmodem(send_buffer, 30);
 
 	send_buffer[30] = crc>>8;
 	send_buffer[31] = crc;
@@ -160,7 +138,7 @@ void update_PID(float P_fp, float I_fp, float D_fp, uint32_t maxI, uint32_t dead
 }
 
 
-void reset_encoder_counter()
+void reset_encoder_counter(void)
 {
     
     uint8_t send_buffer[4];
@@ -168,7 +146,7 @@ void reset_encoder_counter()
     send_buffer[0] = 128;
     send_buffer[1] = 20;
 
-    crc = crc16(send_buffer, 2);
+    crc = crc16_xmodem(send_buffer, 2);
     send_buffer[2] = crc >> 8;
     send_buffer[3] = crc;
     uart_write_bytes(UART_NUM_2, send_buffer, 4);
@@ -176,7 +154,7 @@ void reset_encoder_counter()
 }
 
 
-void read_PID(){
+void read_PID(void){
     uint8_t receive_buffer[30];
 
     uint8_t send_buffer[2];
@@ -246,7 +224,7 @@ void set_position(uint32_t accel, uint32_t speed, uint32_t deccel, uint32_t posi
 
     send_buffer[18] = buffer;
 
-    crc = crc16(send_buffer, 19);
+    crc = crc16_xmodem(send_buffer, 19);
 
     send_buffer[19] = crc>>8;
     send_buffer[20] = crc;
@@ -310,7 +288,7 @@ void read_mcp(uint8_t command, uint8_t* receive_buffer, uint8_t length){
 
 }
 
-void reset_position(){
+void reset_position(void){
 
     update_PID(600, 0.0, 0, 200, 10, -5000, 5000);
     set_position(800,100, 2000, 0, 1);
@@ -0,0 +1,35 @@
+// main/mcpcommands.h
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * RoboClaw packet-serial commands (address 128) on UART2, for the lever test
+ * rig. The caller installs the UART2 driver.
+ */
+
+enum{
+    LEVER_PULL_BACK = 0,
+    LEVER_PUSH_FORWARDS = 1,
+    LEVER_NOT_ACTUATED = 2
+};
+
+void     send_message(uint8_t command, uint8_t value);
+uint32_t read_encoder_value(uint8_t command);
+void     drive_M1(int accel, int speed, int deccel, int position);
+void     update_PID(float P_fp, float I_fp, float D_fp, uint32_t maxI, uint32_t deadzone, uint32_t minpos, uint32_t maxpos);
+void     reset_encoder_counter(void);
+void     read_PID(void);
+void     set_position(uint32_t accel, uint32_t speed, uint32_t deccel, uint32_t position, uint8_t buffer);
+void     read_mcp(uint8_t command, uint8_t* receive_buffer, uint8_t length);
+uint8_t  get_lever_state(int thresh_position);
+void     reset_position(void);
+void     unlock_lever(uint32_t range);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,157 @@
+// main/motor_bench.c
+//
+// Per-call cost of apply_control_mcpwm(): MCPWM prelude driver (motor_init.c)
+// vs. the legacy driver/mcpwm.h implementation it replaced.
+// Mode "bench-motor" (app_mode.h) times the prelude driver. The legacy rows
+// need their own image: IDF aborts at boot if the legacy and prelude MCPWM
+// drivers are linked together, so set MOTOR_BENCH_LEGACY 1 and drop
+// motor_init.c, and the modes that use it, from main/CMakeLists.txt.
+//
+// Runs from a core-0 task at the control-loop priority with the motor driver
+// board disabled (or the motor disconnected): the sweep below really drives
+// the PWM and direction pins.
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_cpu.h"
+#include "esp_err.h"
+#include "esp_rom_sys.h"
+#include "app_mode.h"
+
+#define MOTOR_BENCH_LEGACY  0
+
+#define BENCH_CALLS         20000
+#define BENCH_YIELD_EVERY   1000    // let IDLE run so the task WDT stays fed
+
+typedef struct {
+    uint32_t n;
+    uint64_t sum;
+    uint32_t max;
+} bench_stat_t;
+
+#if MOTOR_BENCH_LEGACY
+#include "driver/gpio.h"
+#include "driver/mcpwm.h"
+
+// the pre-migration motor_init.c, verbatim apart from the names
+#define PWM_GPIO    33
+#define INA_GPIO    53
+#define INB_GPIO    23
+
+static void bench_init(void)
+{
+    gpio_set_direction(INA_GPIO, GPIO_MODE_OUTPUT);
+    gpio_set_direction(INB_GPIO, GPIO_MODE_OUTPUT);
+    mcpwm_gpio_init(MCPWM_UNIT_0, MCPWM_OPR_A, PWM_GPIO);
+    mcpwm_config_t cfg = {
+        .frequency    = 18000,
+        .cmpr_a       = 50,
+        .cmpr_b       = 50,
+        .duty_mode    = MCPWM_DUTY_MODE_0,
+        .counter_mode = MCPWM_UP_COUNTER
+    };
+    ESP_ERROR_CHECK(mcpwm_init(MCPWM_UNIT_0, MCPWM_TIMER_0, &cfg));
+    ESP_ERROR_CHECK(mcpwm_stop(MCPWM_UNIT_0, MCPWM_TIMER_0));
+}
+
+static void bench_apply(float u)
+{
+    if      (u > 0) { gpio_set_level(INA_GPIO, 1); gpio_set_level(INB_GPIO, 0); }
+    else if (u < 0) { gpio_set_level(INA_GPIO, 0); gpio_set_level(INB_GPIO, 1); }
+    else            { gpio_set_level(INA_GPIO, 0); gpio_set_level(INB_GPIO, 0); }
+
+    if (u == 0.0f) {
+        ESP_ERROR_CHECK(mcpwm_stop(MCPWM_UNIT_0, MCPWM_TIMER_0));
+        return;
+    }
+    ESP_ERROR_CHECK(mcpwm_start(MCPWM_UNIT_0, MCPWM_TIMER_0));
+    float mag = fabsf(u);
+    if (mag > 100.0f) mag = 100.0f;
+    ESP_ERROR_CHECK(mcpwm_set_duty(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_OPR_A, mag));
+}
+
+#define BENCH_NAME  "legacy driver/mcpwm.h"
+#else
+#include "motor_init.h"
+
+static void bench_init(void)     { init_mcpwm_highres(); }
+static void bench_apply(float u) { apply_control_mcpwm(u); }
+
+#define BENCH_NAME  "mcpwm prelude (motor_init.c)"
+#endif
+
+static void stat_add(bench_stat_t *st, uint32_t cycles)
+{
+    st->n++;
+    st->sum += cycles;
+    if (cycles > st->max) st->max = cycles;
+}
+
+static void print_stat(const char *name, const bench_stat_t *st, uint32_t cyc_per_us)
+{
+    float mean = st->n ? (float)st->sum / st->n : 0.0f;
+    printf("  %-16s n=%-7lu mean=%7.3f us  max=%7.3f us\n",
+           name, (unsigned long)st->n,
+           mean / cyc_per_us, (float)st->max / cyc_per_us);
+}
+
+// one pattern per row: what a control loop typically feeds the driver
+static void run_pattern(const char *name, float (*u_of)(uint32_t i))
+{
+    bench_stat_t st = { 0 };
+    for (uint32_t i = 0; i < BENCH_CALLS; i++) {
+        float    u  = u_of(i);
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        bench_apply(u);
+        stat_add(&st, esp_cpu_get_cycle_count() - t0);
+        if ((i + 1) % BENCH_YIELD_EVERY == 0) vTaskDelay(1);
+    }
+    bench_apply(0.0f);
+    print_stat(name, &st, esp_rom_get_cpu_ticks_per_us());
+}
+
+static float u_constant(uint32_t i) { return 25.0f; }
+static float u_ramp(uint32_t i)     { return 5.0f + (float)(i % 900) * 0.1f; }
+static float u_sine(uint32_t i)     { return 40.0f * sinf((float)i * 0.01f); }   // crosses zero
+static float u_reverse(uint32_t i)  { return (i & 1) ? 30.0f : -30.0f; }
+
+static void bench_task(void *pv)
+{
+    printf("motor driver benchmark: %s, %d calls per pattern\n", BENCH_NAME, BENCH_CALLS);
+    run_pattern("constant 25%", u_constant);
+    run_pattern("ramp 5..95%", u_ramp);
+    run_pattern("sine ±40%", u_sine);
+    run_pattern("reverse ±30%", u_reverse);
+    printf("Done.\n");
+    vTaskDelete(NULL);
+}
+
+// ───────────── mode "bench-motor" ─────────────
+
+static esp_err_t bench_motor_init(void)
+{
+    bench_init();
+    return ESP_OK;
+}
+
+static esp_err_t bench_motor_run(void)
+{
+    // core 0, priority of the "ctrl" rate group
+    xTaskCreatePinnedToCore(bench_task, "motor_bench", 4096, NULL, 11, NULL, 0);
+    return ESP_OK;
+}
+
+static void bench_motor_teardown(void)
+{
+    bench_apply(0.0f);
+}
+
+const app_mode_t mode_bench_motor = {
+    .name     = "bench-motor",
+    .help     = "apply_control_mcpwm() cost (drives the motor pins)",
+    .init     = bench_motor_init,
+    .run      = bench_motor_run,
+    .teardown = bench_motor_teardown,
+};
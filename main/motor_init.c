@@ -1,68 +1,114 @@
 // main/motor_init.c
 
 #include "motor_init.h"
-#include "driver/gpio.h"
-#include "driver/mcpwm.h"
+#include "driver/mcpwm_prelude.h"
 #include "esp_err.h"
-#include <math.h>
 
 // motor driver board pins
-#define PWM_GPIO    33   // PWM → MCPWM0A
+#define PWM_GPIO    33   // PWM
 #define INA_GPIO    53   // direction A
 #define INB_GPIO    23  // direction B
 
-#define MCPWM_UNIT   MCPWM_UNIT_0
-#define MCPWM_TIMER  MCPWM_TIMER_0
-#define MCPWM_OP     MCPWM_OPR_A
+#define MCPWM_GROUP  0
+
+static mcpwm_timer_handle_t s_timer;
+static mcpwm_cmpr_handle_t  s_duty;          // PWM compare, latched on timer-empty
+static mcpwm_gen_handle_t   s_gen_pwm;
+static mcpwm_gen_handle_t   s_gen_ina;       // direction pins: level set by the
+static mcpwm_gen_handle_t   s_gen_inb;       //   timer-empty action, latched on timer-empty
+
+static int32_t  s_dir;                       // −1, 0 (brake), +1 currently programmed
+static uint32_t s_ticks;                     // duty currently programmed
+
+static void set_dir_level(mcpwm_gen_handle_t gen, int level)
+{
+    mcpwm_generator_set_action_on_timer_event(gen,
+        MCPWM_GEN_TIMER_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, MCPWM_TIMER_EVENT_EMPTY,
+                                     level ? MCPWM_GEN_ACTION_HIGH : MCPWM_GEN_ACTION_LOW));
+}
+
+static mcpwm_gen_handle_t new_gen(mcpwm_oper_handle_t oper, int gpio)
+{
+    mcpwm_gen_handle_t gen;
+    mcpwm_generator_config_t gcfg = { .gen_gpio_num = gpio };
+    ESP_ERROR_CHECK(mcpwm_new_generator(oper, &gcfg, &gen));
+    return gen;
+}
 
 void init_mcpwm_highres(void) {
-    // 1) Direction pins
-    gpio_set_direction(INA_GPIO, GPIO_MODE_OUTPUT);
-    gpio_set_direction(INB_GPIO, GPIO_MODE_OUTPUT);
-
-    // 2) Route PWM pin into MCPWM0A
-    mcpwm_gpio_init(MCPWM_UNIT, MCPWM_OP, PWM_GPIO);
-
-    // 3) Configure MCPWM timer for 18 kHz, but 0% on startup
-    mcpwm_config_t cfg = {
-        .frequency    = 18000,        // 18 kHz
-        .cmpr_a       = 50,            // ← 0% duty (motor off)
-        .cmpr_b       = 50,
-        .duty_mode    = MCPWM_DUTY_MODE_0,
-        .counter_mode = MCPWM_UP_COUNTER
+    // 1) 18 kHz up-counting timer
+    mcpwm_timer_config_t tcfg = {
+        .group_id      = MCPWM_GROUP,
+        .clk_src       = MCPWM_TIMER_CLK_SRC_DEFAULT,
+        .resolution_hz = MOTOR_PWM_RESOLUTION_HZ,
+        .count_mode    = MCPWM_TIMER_COUNT_MODE_UP,
+        .period_ticks  = MOTOR_PWM_PERIOD_TICKS,
+    };
+    ESP_ERROR_CHECK(mcpwm_new_timer(&tcfg, &s_timer));
+
+    // 2) two operators (two generators each) on the same timer, so one
+    //    timer-empty event latches duty and direction together
+    mcpwm_oper_handle_t oper, oper_dir;
+    mcpwm_operator_config_t ocfg = {
+        .group_id                       = MCPWM_GROUP,
+        .flags.update_gen_action_on_tez = true,
     };
-    ESP_ERROR_CHECK(mcpwm_init(MCPWM_UNIT, MCPWM_TIMER, &cfg));
+    ESP_ERROR_CHECK(mcpwm_new_operator(&ocfg, &oper));
+    ESP_ERROR_CHECK(mcpwm_new_operator(&ocfg, &oper_dir));
+    ESP_ERROR_CHECK(mcpwm_operator_connect_timer(oper, s_timer));
+    ESP_ERROR_CHECK(mcpwm_operator_connect_timer(oper_dir, s_timer));
+
+    mcpwm_comparator_config_t ccfg = { .flags.update_cmp_on_tez = true };
+    ESP_ERROR_CHECK(mcpwm_new_comparator(oper, &ccfg, &s_duty));
+    ESP_ERROR_CHECK(mcpwm_comparator_set_compare_value(s_duty, 0));
 
-    // 4) Stop the timer entirely so no PWM until you call apply_control_mcpwm
-    ESP_ERROR_CHECK(mcpwm_stop(MCPWM_UNIT, MCPWM_TIMER));
+    // 3) PWM: high at the start of the period, low at the compare (0 = off)
+    s_gen_pwm = new_gen(oper, PWM_GPIO);
+    ESP_ERROR_CHECK(mcpwm_generator_set_action_on_timer_event(s_gen_pwm,
+        MCPWM_GEN_TIMER_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, MCPWM_TIMER_EVENT_EMPTY,
+                                     MCPWM_GEN_ACTION_HIGH)));
+    ESP_ERROR_CHECK(mcpwm_generator_set_action_on_compare_event(s_gen_pwm,
+        MCPWM_GEN_COMPARE_EVENT_ACTION(MCPWM_TIMER_DIRECTION_UP, s_duty, MCPWM_GEN_ACTION_LOW)));
+
+    // 4) INA/INB start low: brake to ground
+    s_gen_ina = new_gen(oper_dir, INA_GPIO);
+    s_gen_inb = new_gen(oper_dir, INB_GPIO);
+    set_dir_level(s_gen_ina, 0);
+    set_dir_level(s_gen_inb, 0);
+    s_dir   = 0;
+    s_ticks = 0;
+
+    ESP_ERROR_CHECK(mcpwm_timer_enable(s_timer));
+    ESP_ERROR_CHECK(mcpwm_timer_start_stop(s_timer, MCPWM_TIMER_START_NO_STOP));
 }
 
-void apply_control_mcpwm(float u) {
-    // 1) Set direction pins
-    if      (u > 0) { gpio_set_level(INA_GPIO, 1); gpio_set_level(INB_GPIO, 0); }
-    else if (u < 0) { gpio_set_level(INA_GPIO, 0); gpio_set_level(INB_GPIO, 1); }
-    else            { gpio_set_level(INA_GPIO, 0); gpio_set_level(INB_GPIO, 0); }
-
-    // 2) If u==0, brake (stop PWM) and return immediately
-    if (u == 0.0f) {
-        ESP_ERROR_CHECK(mcpwm_stop(MCPWM_UNIT, MCPWM_TIMER));
-        return;
+void motor_set_ticks(int32_t ticks) {
+    int32_t  dir = (ticks > 0) - (ticks < 0);
+    uint32_t mag = (uint32_t)(dir < 0 ? -ticks : ticks);
+    if (mag > MOTOR_PWM_PERIOD_TICKS) mag = MOTOR_PWM_PERIOD_TICKS;
+
+    if (dir != s_dir) {
+        // The two writes below can straddle a period boundary. Going through
+        // brake on a reversal makes either ordering harmless: the worst case
+        // is one period of brake, never one period of drive the wrong way.
+        if (s_dir != 0 && dir != 0) {
+            dir = 0;
+            mag = 0;
+        }
+        set_dir_level(s_gen_ina, dir > 0);
+        set_dir_level(s_gen_inb, dir < 0);
+        s_dir = dir;
     }
 
-    // 3) Nonzero drive: ensure PWM timer is running
-    ESP_ERROR_CHECK(mcpwm_start(MCPWM_UNIT, MCPWM_TIMER));
-
-    // 4) Compute magnitude 0–100%
-    float mag = fabsf(u);
-    if (mag > 100.0f) mag = 100.0f;
-
-    // 5) Update duty cycle
-    ESP_ERROR_CHECK(
-        mcpwm_set_duty(
-            MCPWM_UNIT,
-            MCPWM_TIMER,
-            MCPWM_OP,
-            mag      // 0.0–100.0%
-        )
-    );
+    // arguments are clamped above, so the driver's range check cannot fail
+    if (mag != s_ticks) {
+        mcpwm_comparator_set_compare_value(s_duty, mag);
+        s_ticks = mag;
+    }
+}
+
+void apply_control_mcpwm(float u) {
+    if (u >  100.0f) u =  100.0f;
+    if (u < -100.0f) u = -100.0f;
+    motor_set_ticks((int32_t)(u * (MOTOR_PWM_PERIOD_TICKS / 100.0f)));
 }
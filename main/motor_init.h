@@ -1,13 +1,29 @@
 #pragma once
 #include <stdint.h>
 
+// PWM timebase: 40 MHz / 2222 ticks ≈ 18 kHz
+#define MOTOR_PWM_RESOLUTION_HZ  40000000
+#define MOTOR_PWM_FREQ_HZ        18000
+#define MOTOR_PWM_PERIOD_TICKS   (MOTOR_PWM_RESOLUTION_HZ / MOTOR_PWM_FREQ_HZ)
+
 void init_mcpwm_highres(void);
 /**
-    @brief initialize the MCPWM peripheral for motor driving via the VNH 5019A-E board
+    @brief initialize the MCPWM peripheral for motor driving via the VNH 5019A-E board.
+           PWM, INA and INB are all MCPWM generators on one timer; duty and
+           direction are shadowed and take effect together at the start of a period.
+           The outputs start in brake (INA = INB = 0, 0 % duty).
+ */
+
+void motor_set_ticks(int32_t ticks);
+/**
+    @brief drive the motor with a signed duty in timer ticks (±MOTOR_PWM_PERIOD_TICKS,
+           clamped). Control-loop hot path: no float math, no error checks, and
+           registers are only written when the value changes. A sign reversal
+           spends one call in brake so direction and duty never latch apart.
  */
 
 void apply_control_mcpwm(float u);
  /**
     @brief drive the motor via the VNH 5019A-E board with direction and PWM
-    @param u signed value of the duty cycle 0.00-100.0% 
-  */
\ No newline at end of file
+    @param u signed value of the duty cycle 0.00-100.0%
+  */
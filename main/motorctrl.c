@@ -2,6 +2,7 @@
 
 #include "motorctrl.h"
 #include "motor_init.h"
+#include "friction.h"
 #include <math.h>
 #include <stdlib.h>    // for abs()
 
@@ -16,6 +17,9 @@ static int   last_pos;
 static float kp, ki, kd, integral, deriv;
 static int   lastError, deadzone;
 
+// trajectory-tracking controller state
+static float trk_kp, trk_ki, trk_kd, trk_kff, trk_dt, trk_integral;
+
 void motorctrl_init_viscous(float dt_call,
                             float tau_vel_call,
                             float B_call)
@@ -71,7 +75,7 @@ void pid_init(float kp_call,
     lastError = 0;
 }
 
-void pid_step(int32_t encoder_count,
+float pid_step(int32_t encoder_count,
               int32_t target_count)
 {
     float pos   = (float)encoder_count;
@@ -105,7 +109,9 @@ void pid_step(int32_t encoder_count,
         }
 
         lastError = error;
+        u = friction_comp(u, -deriv);   // d(error)/dt = -velocity
         apply_control_mcpwm(u);
+        return u;
     }
     else {
         // inside deadzone: actively brake and clear integrator
@@ -113,6 +119,7 @@ void pid_step(int32_t encoder_count,
         integral  = 0.0f;
         deriv     = 0.0f;
         lastError = 0;
+        return 0.0f;
     }
 }
 
@@ -136,3 +143,49 @@ void pid_clear_state(void) {
     deriv     = 0.0f;
 }
 
+void track_init(float kp_call,
+                float ki_call,
+                float kd_call,
+                float kff_call,
+                float dt_call)
+{
+    trk_kp       = kp_call;
+    trk_ki       = ki_call;
+    trk_kd       = kd_call;
+    trk_kff      = kff_call;
+    trk_dt       = dt_call;
+    trk_integral = 0.0f;
+}
+
+void track_clear_state(void)
+{
+    trk_integral = 0.0f;
+}
+
+float track_step(int32_t encoder_count,
+                 float   vel,
+                 float   x_ref,
+                 float   v_ref)
+{
+    float error   = x_ref - (float)encoder_count;
+    float v_error = v_ref - vel;
+
+    float tentative_integral = trk_integral + error * trk_dt;
+    float u = trk_kff * v_ref
+            + trk_kp * error
+            + trk_ki * tentative_integral
+            + trk_kd * v_error;
+
+    // same windup rule as pid_step: integrate only while unsaturated
+    if (u > MAX_OUTPUT) {
+        u = MAX_OUTPUT;
+    } else if (u < MIN_OUTPUT) {
+        u = MIN_OUTPUT;
+    } else {
+        trk_integral = tentative_integral;
+    }
+
+    u = friction_comp(u, vel);
+    apply_control_mcpwm(u);
+    return u;
+}
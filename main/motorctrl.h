@@ -54,9 +54,11 @@ void pid_init(float kp,
  * @param  target_count   Desired setpoint (same units)  
  *
  * If |error| ≤ deadzone, this will hold integrator and output zero.
- * Otherwise it computes P+I+D and calls apply_control_mcpwm(u).
+ * Otherwise it computes P+I+D, adds the friction feedforward
+ * (friction_comp) and calls apply_control_mcpwm(u).
+ * @return The command that was applied (0 inside the deadzone)
  */
-void pid_step(int32_t encoder_count,
+float pid_step(int32_t encoder_count,
               int32_t target_count);
 
 /**  
@@ -80,6 +82,38 @@ void pid_set_deadzone(int new_deadzone);
 void pid_clear_state(void);
 
 
+/**
+ * @brief  Initialize the trajectory-tracking controller (see traj.h).
+ * @param  kp    Position gain (% per count)
+ * @param  ki    Integral gain (% per count·s)
+ * @param  kd    Velocity-error gain (% per count/s)
+ * @param  kff   Velocity feedforward (% per count/s of reference velocity)
+ * @param  dt_s  Control‐loop interval, in seconds
+ */
+void track_init(float kp,
+                float ki,
+                float kd,
+                float kff,
+                float dt_s);
+
+/**
+ * @brief  Clear the integrator before a new move.
+ */
+void track_clear_state(void);
+
+/**
+ * @brief  One tracking update toward a moving reference; drives the motor.
+ * @param  encoder_count  Latest encoder count
+ * @param  vel            Filtered velocity (counts/s, from the kinbus)
+ * @param  x_ref, v_ref   Reference position and velocity at this step
+ * @return The command that was applied (friction feedforward included)
+ */
+float track_step(int32_t encoder_count,
+                 float   vel,
+                 float   x_ref,
+                 float   v_ref);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,507 @@
+// main/paradigm.c
+//
+// Compiler and interpreter for the paradigm tables in paradigm.h. All run-time
+// state is static; pd_step() is the only entry point from the trial group and
+// everything it calls is bounded (no allocation, no blocking, no waiting).
+#include "paradigm.h"
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "driver/gpio.h"
+#include "encoder.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "forcefield.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "state_machine.h"
+#include "stim.h"
+#include "tone.h"
+#include "trial_capture.h"
+
+static const char *TAG = "PARADIGM";
+
+// watch points: both slots belong to the state's first encoder transition
+#define WATCH_SLOT_A        0
+#define WATCH_SLOT_B        1
+#define PD_EVT_ENTER        (1u << 0)   // crossed into the BELOW/ABOVE zone
+#define PD_EVT_EXIT         (1u << 1)   // reached the zone edge
+#define PD_EVT_NEAR         (1u << 2)   // reached the NEAR/SETTLED band
+#define PD_EVT_ENC_ALL      (PD_EVT_ENTER | PD_EVT_EXIT | PD_EVT_NEAR)
+#define PD_EVT_PHASE        (1u << 3)   // state timeout (from the wheel)
+
+#define NO_WATCH            0xFF
+#define RT_NONE             UINT32_MAX
+
+typedef struct {
+    uint8_t  tag, mark, marker;
+    uint8_t  act_first, act_n;
+    uint8_t  tr_first, tr_n;
+    uint8_t  watch;             // tr[] index owning the watch points, or NO_WATCH
+    uint32_t timeout_us;
+} pd_cstate_t;
+
+typedef struct {
+    uint8_t cond, next;
+    int32_t a;
+    int32_t b;                  // BELOW/ABOVE: hold in µs; NEAR/SETTLED: band in counts
+} pd_ctrans_t;
+
+typedef struct {
+    const pd_def_t *def;
+    uint8_t         n_states, n_variants;
+    pd_cstate_t     st[PD_MAX_STATES];
+    pd_action_t     act[PD_MAX_ACTIONS];
+    pd_ctrans_t     tr[PD_MAX_TRANS];
+    pd_variant_t    var[PD_MAX_VARIANTS];
+} pd_prog_t;
+
+static const pd_def_t      *s_defs[PD_MAX_PARADIGMS];
+static int                  s_ndefs;
+static pd_prog_t            s_prog[2];
+static pd_prog_t           *s_run;                  // trial task only
+static _Atomic(pd_prog_t *) s_pending;              // compiled, waiting for a trial start
+
+static pd_hooks_t           s_hooks;
+static twheel_t            *s_wheel;
+static int                  s_gpio;
+
+// interpreter state (trial task only)
+static int                  s_state;
+static uint32_t             s_trial;
+static const pd_variant_t  *s_var;
+static uint8_t              s_var_idx;
+static uint8_t              s_outcome;
+static int64_t              s_hold_us;              // entry time into the BELOW/ABOVE zone
+static int64_t              s_rt_start_us;
+static uint32_t             s_rt_ms;
+static bool                 s_cue_staged;           // CUE_ON staged a commit for this entry
+static uint32_t             s_events;               // PD_EVT_PHASE from the wheel
+static twheel_timer_t       s_tm_phase;
+static twheel_timer_t       s_tm_pulse;
+
+// reward pulse train
+static int                  s_pulses_left;
+static bool                 s_pulse_high;
+static uint32_t             s_pulse_hz, s_pulse_ms;
+static bool                 s_reward_done;
+
+// ───────────── compiler ─────────────
+
+static int find_state(const pd_def_t *d, const char *name)
+{
+    for (int i = 0; i < d->n_states; i++) {
+        if (strcmp(d->states[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static esp_err_t compile(const pd_def_t *d, pd_prog_t *p)
+{
+    ESP_RETURN_ON_FALSE(d->n_states >= 1 && d->n_states <= PD_MAX_STATES, ESP_ERR_INVALID_ARG,
+                        TAG, "%s: 1…%d states", d->name, PD_MAX_STATES);
+    ESP_RETURN_ON_FALSE(d->n_variants >= 1 && d->n_variants <= PD_MAX_VARIANTS, ESP_ERR_INVALID_ARG,
+                        TAG, "%s: 1…%d variants", d->name, PD_MAX_VARIANTS);
+
+    memset(p, 0, sizeof(*p));
+    p->def        = d;
+    p->n_states   = d->n_states;
+    p->n_variants = d->n_variants;
+    memcpy(p->var, d->variants, d->n_variants * sizeof(pd_variant_t));
+
+    int na = 0, nt = 0;
+    for (int i = 0; i < d->n_states; i++) {
+        const pd_state_def_t *s  = &d->states[i];
+        pd_cstate_t          *cs = &p->st[i];
+
+        cs->tag        = s->tag;
+        cs->mark       = s->mark;
+        cs->marker     = s->marker;
+        cs->timeout_us = s->timeout_ms * 1000;
+        cs->watch      = NO_WATCH;
+
+        cs->act_first = na;
+        for (int k = 0; k < PD_STATE_ACTIONS && s->entry[k].op != PD_A_NONE; k++) {
+            ESP_RETURN_ON_FALSE(s->entry[k].op <= PD_A_REPORT, ESP_ERR_INVALID_ARG,
+                                TAG, "%s.%s: bad action %d", d->name, s->name, s->entry[k].op);
+            ESP_RETURN_ON_FALSE(na < PD_MAX_ACTIONS, ESP_ERR_NO_MEM, TAG, "%s: too many actions", d->name);
+            p->act[na++] = s->entry[k];
+        }
+        cs->act_n = na - cs->act_first;
+
+        cs->tr_first = nt;
+        for (int k = 0; k < PD_STATE_TRANS && s->trans[k].cond != PD_C_NONE; k++) {
+            const pd_trans_def_t *t = &s->trans[k];
+            int next = find_state(d, t->next);
+            ESP_RETURN_ON_FALSE(t->cond <= PD_C_ALWAYS, ESP_ERR_INVALID_ARG,
+                                TAG, "%s.%s: bad condition %d", d->name, s->name, t->cond);
+            ESP_RETURN_ON_FALSE(next >= 0, ESP_ERR_NOT_FOUND,
+                                TAG, "%s.%s: no state '%s'", d->name, s->name, t->next);
+            ESP_RETURN_ON_FALSE(t->cond != PD_C_TIMER || s->timeout_ms > 0, ESP_ERR_INVALID_ARG,
+                                TAG, "%s.%s: TIMER without timeout_ms", d->name, s->name);
+            ESP_RETURN_ON_FALSE(nt < PD_MAX_TRANS, ESP_ERR_NO_MEM, TAG, "%s: too many transitions", d->name);
+
+            pd_ctrans_t *ct = &p->tr[nt];
+            ct->cond = t->cond;
+            ct->next = next;
+            ct->a    = t->a;
+            ct->b    = (t->cond == PD_C_BELOW || t->cond == PD_C_ABOVE) ? t->b * 1000 : t->b;
+            if (cs->watch == NO_WATCH && t->cond >= PD_C_BELOW && t->cond <= PD_C_SETTLED) {
+                cs->watch = nt;
+            }
+            nt++;
+        }
+        cs->tr_n = nt - cs->tr_first;
+        ESP_RETURN_ON_FALSE(cs->tr_n > 0, ESP_ERR_INVALID_ARG,
+                            TAG, "%s.%s: no way out", d->name, s->name);
+    }
+    // render every tone the tables can ask for, so none is rendered mid-trial
+    for (int k = 0; k < na; k++) {
+        const pd_action_t *a = &p->act[k];
+        for (int v = 0; v < p->n_variants; v++) {
+            esp_err_t err = ESP_OK;
+            if (a->op == PD_A_CUE_ON && p->var[v].cue_hz) {
+                err = tone_prepare(p->var[v].cue_hz, a->a);
+            } else if (a->op == PD_A_REWARD && a->a && p->var[v].pulses) {
+                err = tone_prepare(a->a, a->b);
+            } else if (a->op == PD_A_TONE && v == 0) {
+                err = tone_prepare(a->a, a->b);
+            }
+            if (err != ESP_OK) ESP_LOGW(TAG, "%s: tone not prepared", d->name);
+        }
+    }
+    ESP_LOGI(TAG, "%s: %d states, %d actions, %d transitions, %d variants",
+             d->name, p->n_states, na, nt, p->n_variants);
+    return ESP_OK;
+}
+
+// ───────────── reward pulse train ─────────────
+
+static void pulse_cb(void *arg);
+
+static void pulse_on(void)
+{
+    gpio_set_level(s_gpio, 1);
+    if (s_pulse_hz) tone_start(s_pulse_hz, s_pulse_ms);
+    s_pulse_high = true;
+    twheel_arm(s_wheel, &s_tm_pulse, s_pulse_ms * 1000, pulse_cb, NULL);
+}
+
+static void pulse_cb(void *arg)
+{
+    if (s_pulse_high) {
+        gpio_set_level(s_gpio, 0);
+        s_pulse_high = false;
+        twheel_arm(s_wheel, &s_tm_pulse, s_pulse_ms * 1000, pulse_cb, NULL);
+    } else if (--s_pulses_left > 0) {
+        pulse_on();
+    } else {
+        s_reward_done = true;
+    }
+}
+
+static void phase_cb(void *arg)
+{
+    s_events |= PD_EVT_PHASE;
+}
+
+// ───────────── interpreter ─────────────
+
+static void run_action(const pd_action_t *a, const kin_sample_t *kin, int64_t now_us)
+{
+    switch (a->op) {
+    case PD_A_NEW_TRIAL:
+        s_trial++;
+        s_var_idx     = esp_random() % s_run->n_variants;
+        s_var         = &s_run->var[s_var_idx];
+        s_outcome     = PD_OUT_TIMEOUT;
+        s_rt_start_us = 0;
+        s_rt_ms       = RT_NONE;
+        sm_set_trial(s_trial);
+        if (s_hooks.new_trial) s_hooks.new_trial(s_trial, s_var);
+        break;
+    case PD_A_CTRL:
+        s_hooks.ctrl((pd_ctrl_t)a->a, a->b);
+        break;
+    case PD_A_LOCK:
+        s_hooks.lock(a->a != 0);
+        break;
+    case PD_A_FIELD: {
+        ff_set_t set;
+        ff_set_viscous(&set, s_var->field_B);
+        if (ff_load(&set) != ESP_OK) {
+            ESP_LOGW(TAG, "trial %" PRIu32 ": field set not loaded, keeping previous", s_trial);
+        }
+        break;
+    }
+    case PD_A_FIELD_TRIGGER:
+        ff_trigger();
+        break;
+    case PD_A_CUE_ON:
+        if (stim_ready()) {
+            // released with the state's marker once the entry actions are done
+            const audio_buf_t *buf = s_var->cue_hz ? tone_buffer(s_var->cue_hz, a->a) : NULL;
+            if (buf) stim_stage_audio(buf);
+            if (s_var->grating) stim_stage_visual(s_hooks.visual, s_var->grating);
+            s_cue_staged = true;
+            break;
+        }
+        // no commit task, so no display to draw on: sound only (the trial
+        // group never renders)
+        if (s_var->cue_hz) tone_start(s_var->cue_hz, a->a);
+        break;
+    case PD_A_CUE_OFF:
+        stim_cancel();
+        tone_stop();
+        stim_post_visual(s_hooks.visual, 0);   // rendered by the commit task
+        break;
+    case PD_A_TONE:
+        tone_start(a->a, a->b);
+        break;
+    case PD_A_REWARD:
+        s_pulse_hz    = a->a;
+        s_pulse_ms    = a->b;
+        s_pulses_left = s_var->pulses;
+        s_reward_done = (s_pulses_left == 0);
+        if (!s_reward_done) pulse_on();
+        break;
+    case PD_A_CAPTURE_BEGIN:
+        trial_capture_begin(s_trial);
+        break;
+    case PD_A_CAPTURE_END:
+        trial_capture_end();
+        break;
+    case PD_A_RT_START:
+        s_rt_start_us = now_us;
+        s_rt_ms       = RT_NONE;
+        break;
+    case PD_A_RT_STOP:
+        if (s_rt_ms == RT_NONE && s_rt_start_us != 0) {
+            // from the cue's measured onset when it came after the clock started
+            int64_t t0 = stim_onset(s_trial);
+            if (t0 < s_rt_start_us || t0 > now_us) t0 = s_rt_start_us;
+            s_rt_ms = (uint32_t)((now_us - t0) / 1000);
+        }
+        break;
+    case PD_A_OUTCOME:
+        s_outcome = (a->a == PD_OUTCOME_VARIANT) ? s_var->reward_outcome : (uint8_t)a->a;
+        break;
+    case PD_A_REPORT: {
+        pd_report_t r = {
+            .trial   = s_trial,
+            .outcome = s_outcome,
+            .variant = s_var_idx,
+            .rt_ms   = (s_rt_ms == RT_NONE) ? 0 : s_rt_ms,
+            .pos     = kin->pos,
+        };
+        s_hooks.report(&r);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void arm_watch(const pd_cstate_t *cs)
+{
+    if (cs->watch == NO_WATCH) {
+        encoder_watch_disarm(WATCH_SLOT_A);
+        encoder_watch_disarm(WATCH_SLOT_B);
+        return;
+    }
+    const pd_ctrans_t *t    = &s_run->tr[cs->watch];
+    TaskHandle_t       self = xTaskGetCurrentTaskHandle();
+    esp_err_t          ea, eb;
+    switch (t->cond) {
+    case PD_C_BELOW:
+        ea = encoder_watch_arm(WATCH_SLOT_A, t->a - 1, self, PD_EVT_ENTER);
+        eb = encoder_watch_arm(WATCH_SLOT_B, t->a,     self, PD_EVT_EXIT);
+        break;
+    case PD_C_ABOVE:
+        ea = encoder_watch_arm(WATCH_SLOT_A, t->a + 1, self, PD_EVT_ENTER);
+        eb = encoder_watch_arm(WATCH_SLOT_B, t->a,     self, PD_EVT_EXIT);
+        break;
+    default:    // NEAR / SETTLED
+        ea = encoder_watch_arm(WATCH_SLOT_A, t->a + t->b, self, PD_EVT_NEAR);
+        eb = encoder_watch_arm(WATCH_SLOT_B, t->a - t->b, self, PD_EVT_NEAR);
+        break;
+    }
+    // conditions are re-checked from kin->pos every release, so a missing
+    // watch point only costs the ISR entry timestamp
+    if (ea != ESP_OK || eb != ESP_OK) ESP_LOGW(TAG, "watch points not armed");
+}
+
+static bool same_watch(const pd_cstate_t *x, const pd_cstate_t *y)
+{
+    if (x == y || x->watch == NO_WATCH || y->watch == NO_WATCH) return false;
+    const pd_ctrans_t *a = &s_run->tr[x->watch], *b = &s_run->tr[y->watch];
+    return a->cond == b->cond && a->a == b->a && a->b == b->b;
+}
+
+static void enter(int idx, const kin_sample_t *kin, int64_t now_us)
+{
+    // a newly selected paradigm takes over at a trial boundary only
+    if (idx == 0) {
+        pd_prog_t *next = atomic_exchange(&s_pending, NULL);
+        if (next) {
+            s_run   = next;
+            s_state = 0;        // nothing carries over from the old program
+            ESP_LOGI(TAG, "running '%s'", s_run->def->name);
+        }
+    }
+
+    const pd_cstate_t *prev = &s_run->st[s_state];
+    const pd_cstate_t *cs   = &s_run->st[idx];
+    s_state = idx;
+
+    s_events &= ~PD_EVT_PHASE;      // a deadline from the previous state is stale
+    if (cs->timeout_us) {
+        twheel_arm(s_wheel, &s_tm_phase, cs->timeout_us, phase_cb, NULL);
+    } else {
+        twheel_cancel(s_wheel, &s_tm_phase);
+    }
+    // same encoder predicate as the state we left (CUE → MOVING): the watch
+    // points and a hold already under way carry over
+    if (!same_watch(prev, cs)) {
+        s_hold_us = 0;
+        arm_watch(cs);
+    }
+
+    for (int i = 0; i < cs->act_n; i++) {
+        run_action(&s_run->act[cs->act_first + i], kin, now_us);
+    }
+
+    // marker last, so NEW_TRIAL's trial number and variant are already in place
+    int mk = -1;
+    switch (cs->mark) {
+    case PD_MARK_FIXED:  mk = cs->marker;          break;
+    case PD_MARK_CUE:    mk = s_var->cue_marker;    break;
+    case PD_MARK_REWARD: mk = s_var->reward_marker; break;
+    default:                                        break;
+    }
+    if (s_cue_staged) {
+        // sound, grating and marker go out together on the next frame (stim.h)
+        s_cue_staged = false;
+        if (mk >= 0) stim_stage_marker((event_state_t)mk);
+        stim_commit(s_trial);
+        if (mk >= 0) sm_enter_staged((sm_state_t)cs->tag, (event_state_t)mk);
+        else         sm_enter_no_emit((sm_state_t)cs->tag);
+    } else if (mk >= 0) {
+        sm_enter((sm_state_t)cs->tag, (event_state_t)mk);
+    } else {
+        sm_enter_no_emit((sm_state_t)cs->tag);
+    }
+}
+
+// BELOW/ABOVE with a hold time. The zone entry time is the watch-point ISR
+// timestamp when this transition owns the watch points, else when we noticed.
+static bool held(const pd_ctrans_t *t, bool owns_watch, int32_t pos, uint32_t ev, int64_t now_us)
+{
+    bool inside = (t->cond == PD_C_BELOW) ? (pos < t->a) : (pos > t->a);
+    if (!inside) {
+        s_hold_us = 0;
+        return false;
+    }
+    // fresh entry, or left and came back since the last release
+    if (s_hold_us == 0 || (owns_watch && (ev & PD_EVT_EXIT))) {
+        int64_t t_enter;
+        s_hold_us = (owns_watch && encoder_watch_last(WATCH_SLOT_A, &t_enter)) ? t_enter : now_us;
+    }
+    return now_us - s_hold_us >= t->b;
+}
+
+void pd_step(const kin_sample_t *kin)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    if (s_run == NULL) {
+        if (atomic_load(&s_pending) == NULL) return;   // nothing selected yet
+        s_run = atomic_load(&s_pending);               // enter(0) adopts it
+        enter(0, kin, now_us);
+        return;
+    }
+
+    // expired deadlines (phase ends, pulse edges, tone stops) fire here
+    twheel_advance(s_wheel, now_us);
+
+    uint32_t ev = 0;
+    xTaskNotifyWait(0, PD_EVT_ENC_ALL, &ev, 0);        // never blocks
+    ev       |= s_events;
+    s_events  = 0;
+
+    const pd_cstate_t *cs  = &s_run->st[s_state];
+    int32_t            pos = kin->pos;
+
+    for (int i = 0; i < cs->tr_n; i++) {
+        int                tix = cs->tr_first + i;
+        const pd_ctrans_t *t   = &s_run->tr[tix];
+        bool               go;
+
+        switch (t->cond) {
+        case PD_C_TIMER:   go = (ev & PD_EVT_PHASE) != 0;                                  break;
+        case PD_C_BELOW:
+        case PD_C_ABOVE:   go = held(t, tix == cs->watch, pos, ev, now_us);                break;
+        case PD_C_NEAR:    go = abs(pos - t->a) <= t->b;                                   break;
+        case PD_C_SETTLED: go = s_hooks.ctrl_done() && abs(pos - t->a) <= t->b;            break;
+        case PD_C_DONE:    go = s_reward_done;                                             break;
+        case PD_C_ALWAYS:  go = true;                                                      break;
+        default:           go = false;                                                     break;
+        }
+        if (go) {
+            enter(t->next, kin, now_us);
+            break;
+        }
+    }
+}
+
+// ───────────── setup ─────────────
+
+esp_err_t pd_init(const pd_hooks_t *hooks, twheel_t *wheel, int reward_gpio)
+{
+    ESP_RETURN_ON_FALSE(hooks && hooks->ctrl && hooks->ctrl_done && hooks->lock &&
+                        hooks->visual && hooks->report && wheel,
+                        ESP_ERR_INVALID_ARG, TAG, "missing hook");
+    s_hooks = *hooks;
+    s_wheel = wheel;
+    s_gpio  = reward_gpio;
+    return ESP_OK;
+}
+
+esp_err_t pd_register(const pd_def_t *def)
+{
+    ESP_RETURN_ON_FALSE(def != NULL && def->name != NULL, ESP_ERR_INVALID_ARG, TAG, "bad paradigm");
+    ESP_RETURN_ON_FALSE(s_ndefs < PD_MAX_PARADIGMS, ESP_ERR_NO_MEM, TAG, "paradigm table full");
+    s_defs[s_ndefs++] = def;
+    return ESP_OK;
+}
+
+esp_err_t pd_select(const char *name)
+{
+    const pd_def_t *def = NULL;
+    for (int i = 0; i < s_ndefs; i++) {
+        if (strcasecmp(s_defs[i]->name, name) == 0) def = s_defs[i];
+    }
+    ESP_RETURN_ON_FALSE(def != NULL, ESP_ERR_NOT_FOUND, TAG, "no paradigm '%s'", name);
+    ESP_RETURN_ON_FALSE(atomic_load(&s_pending) == NULL, ESP_ERR_INVALID_STATE,
+                        TAG, "a selection is already waiting for the next trial");
+
+    // the program not running is free: the trial task only ever reads s_run
+    pd_prog_t *idle = (s_run == &s_prog[0]) ? &s_prog[1] : &s_prog[0];
+    ESP_RETURN_ON_ERROR(compile(def, idle), TAG, "compile %s", def->name);
+    atomic_store(&s_pending, idle);
+    return ESP_OK;
+}
+
+const char *pd_current(void)
+{
+    pd_prog_t *p = s_run;
+    return p ? p->def->name : NULL;
+}
+
+const char *pd_name(int i)
+{
+    return (i >= 0 && i < s_ndefs) ? s_defs[i]->name : NULL;
+}
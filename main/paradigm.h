@@ -0,0 +1,179 @@
+// main/paradigm.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "kinbus.h"
+#include "twheel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Table-driven trial paradigms.
+ *
+ * A paradigm is a const table of states. Each state has an event marker, an
+ * optional phase timeout, a list of entry actions and an ordered list of
+ * transitions (the first condition that holds wins). Per-trial parameters
+ * (cue tone, grating, reward pulses, field, markers) come from a variant drawn
+ * at random by PD_A_NEW_TRIAL.
+ *
+ * pd_select() compiles a registered table into a flat program: names
+ * resolved to indices, times converted to µs, everything in fixed arrays.
+ * pd_step() runs that program from the trial rate group with no allocation
+ * and no waiting; timers live on the caller's timer wheel and encoder
+ * conditions use the PCNT watch points (notification index 0 of the caller).
+ * A newly selected program takes over at the next trial start.
+ */
+
+#define PD_MAX_PARADIGMS    8
+#define PD_MAX_STATES       16
+#define PD_MAX_VARIANTS     8
+#define PD_MAX_ACTIONS      64      // entry actions, all states together
+#define PD_MAX_TRANS        48      // transitions, all states together
+#define PD_STATE_ACTIONS    8       // per state in a definition (PD_A_NONE-terminated)
+#define PD_STATE_TRANS      4       // per state in a definition (PD_C_NONE-terminated)
+
+typedef enum {
+    PD_MARK_NONE = 0,   // state change without a marker
+    PD_MARK_FIXED,      // the state's own marker
+    PD_MARK_CUE,        // the variant's cue marker
+    PD_MARK_REWARD,     // the variant's reward marker
+} pd_mark_t;
+
+typedef enum {
+    PD_C_NONE = 0,
+    PD_C_TIMER,         // the state's timeout_ms has passed
+    PD_C_BELOW,         // pos < a, continuously for b ms
+    PD_C_ABOVE,         // pos > a, continuously for b ms
+    PD_C_NEAR,          // |pos − a| ≤ b
+    PD_C_SETTLED,       // controller move finished and |pos − a| ≤ b
+    PD_C_DONE,          // reward pulse train finished
+    PD_C_ALWAYS,
+} pd_cond_t;
+
+typedef enum {
+    PD_CTRL_HOLD = 0,   // hold at home (PID toward 0)
+    PD_CTRL_FIELD,      // force field from the variant
+    PD_CTRL_TRACK,      // minimum-jerk move to a target, then track it
+    PD_CTRL_STAY,       // hold where the lever is on entry (PID, no homing)
+} pd_ctrl_t;
+
+typedef enum {
+    PD_A_NONE = 0,
+    PD_A_NEW_TRIAL,     // count the trial, draw a variant, reset outcome/RT
+    PD_A_CTRL,          // a = pd_ctrl_t, b = target count for PD_CTRL_TRACK
+    PD_A_LOCK,          // a = 1: no field output, 0: release
+    PD_A_FIELD,         // load the variant's viscous field
+    PD_A_FIELD_TRIGGER, // restart pulse fields (movement onset)
+    PD_A_CUE_ON,        // variant's cue tone for a ms (0 = until CUE_OFF) + its grating
+    PD_A_CUE_OFF,       // tone off, grating hidden
+    PD_A_TONE,          // a Hz for b ms
+    PD_A_REWARD,        // variant's pulse train: b ms TTL high with an a Hz tone, b ms low
+    PD_A_CAPTURE_BEGIN, // start the full-rate trajectory capture
+    PD_A_CAPTURE_END,
+    PD_A_RT_START,      // reaction-time clock starts
+    PD_A_RT_STOP,       // and stops (first stop wins)
+    PD_A_OUTCOME,       // a = outcome code, or PD_OUTCOME_VARIANT
+    PD_A_REPORT,        // trial record + counters/display (pd_hooks_t.report)
+} pd_op_t;
+
+// trial outcomes, as in the TLM_TRIAL record (telemetry.py OUTCOME_NAMES)
+enum { PD_OUT_CORRECT = 0, PD_OUT_TIMEOUT };
+#define PD_OUTCOME_VARIANT  (-1)
+
+typedef struct {
+    uint16_t cue_hz;
+    uint8_t  grating;           // 0 = none
+    uint8_t  pulses;            // reward pulses
+    uint8_t  cue_marker;        // event_state_t
+    uint8_t  reward_marker;     // event_state_t
+    uint8_t  reward_outcome;    // outcome for PD_A_OUTCOME(PD_OUTCOME_VARIANT)
+    float    field_B;           // viscous field for PD_A_FIELD
+} pd_variant_t;
+
+typedef struct {
+    pd_op_t op;
+    int32_t a, b;
+} pd_action_t;
+
+typedef struct {
+    pd_cond_t   cond;
+    int32_t     a, b;
+    const char *next;
+} pd_trans_def_t;
+
+typedef struct {
+    const char     *name;
+    uint8_t         tag;            // sm_state_t reported in TLM_STATE records
+    pd_mark_t       mark;
+    uint8_t         marker;         // event_state_t for PD_MARK_FIXED
+    uint32_t        timeout_ms;     // arms PD_C_TIMER on entry (0 = never)
+    pd_action_t     entry[PD_STATE_ACTIONS];
+    pd_trans_def_t  trans[PD_STATE_TRANS];
+} pd_state_def_t;
+
+typedef struct {
+    const char           *name;
+    const pd_variant_t   *variants;
+    uint8_t               n_variants;
+    const pd_state_def_t *states;   // states[0] starts every trial
+    uint8_t               n_states;
+} pd_def_t;
+
+typedef struct {
+    uint32_t trial;
+    uint8_t  outcome;
+    uint8_t  variant;
+    uint32_t rt_ms;
+    int32_t  pos;
+} pd_report_t;
+
+// What the engine needs from the application; all called from pd_step(),
+// except visual, which runs in the stimulus commit task (stim.h).
+typedef struct {
+    void (*ctrl)(pd_ctrl_t mode, int32_t target);
+    bool (*ctrl_done)(void);                // PD_CTRL_TRACK move finished
+    void (*lock)(bool locked);
+    void (*visual)(int grating);            // 0 hides
+    void (*new_trial)(uint32_t trial, const pd_variant_t *v);
+    void (*report)(const pd_report_t *r);
+} pd_hooks_t;
+
+/**
+ * @brief  Bind the engine to the application hooks, the trial task's timer
+ *         wheel and the reward TTL pin (configured as an output by the caller).
+ */
+esp_err_t pd_init(const pd_hooks_t *hooks, twheel_t *wheel, int reward_gpio);
+
+/**
+ * @brief  Make a paradigm selectable by name (the table must stay valid).
+ */
+esp_err_t pd_register(const pd_def_t *def);
+
+/**
+ * @brief  Compile the named paradigm and queue it; it starts with the next
+ *         trial. ESP_ERR_INVALID_STATE if an earlier selection is still queued.
+ */
+esp_err_t pd_select(const char *name);
+
+/**
+ * @brief  Name of the running paradigm (NULL before the first trial).
+ */
+const char *pd_current(void);
+
+/**
+ * @brief  Registered paradigms, for listings: NULL past the end.
+ */
+const char *pd_name(int i);
+
+/**
+ * @brief  One release of the engine. Trial rate group only.
+ */
+void pd_step(const kin_sample_t *kin);
+
+#ifdef __cplusplus
+}
+#endif
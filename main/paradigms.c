@@ -0,0 +1,218 @@
+// main/paradigms.c
+//
+// Built-in paradigm tables. Positions are accumulated encoder counts (a pull
+// is negative), times are ms. Every table starts a trial in states[0].
+#include "paradigms.h"
+#include "esp_check.h"
+#include "event.h"
+#include "paradigm.h"
+#include "state_machine.h"
+
+static const char *TAG = "PARADIGMS";
+
+// shared by the tables below
+#define REWARD_THRESHOLD    -27     // reward zone: pos < REWARD_THRESHOLD
+#define REWARD_TONE_HZ      5000
+#define REWARD_PHASE_MS     500     // reward pulse: TTL high + tone, then low, each this long
+#define HOME_BAND           5       // "home" is within ±HOME_BAND of 0
+#define ITI_MS              1000
+
+#define ACT(op_, ...)       { .op = (op_), ##__VA_ARGS__ }
+
+// Home the lever, report once it is there, then the inter-trial interval.
+// REWARD and TIMEOUT hold the lever where it is (PD_CTRL_STAY), so this
+// minimum-jerk move is the only homing.
+// Both states share the S_RESET tag; only the first emits the RESET marker.
+#define RESET_STATES                                                            \
+    {                                                                           \
+        .name = "reset", .tag = S_RESET, .mark = PD_MARK_FIXED, .marker = RESET,\
+        .entry = { ACT(PD_A_CTRL, .a = PD_CTRL_TRACK, .b = 0) },                \
+        .trans = { { PD_C_SETTLED, 0, HOME_BAND, "iti" } },                     \
+    },                                                                          \
+    {                                                                           \
+        .name = "iti", .tag = S_RESET, .timeout_ms = ITI_MS,                    \
+        .entry = { ACT(PD_A_REPORT), ACT(PD_A_CAPTURE_END) },                   \
+        .trans = { { PD_C_TIMER, .next = "init" } },                            \
+    }
+
+// ───────────── tiered: four cue/reward levels ─────────────
+//
+// INIT 50 ms → CUE 500 ms → MOVING ≤ 3 s → REWARD (level+1 pulses) or TIMEOUT
+// → RESET. Holding past the threshold for 100 ms during the cue goes straight
+// to REWARD. Level 0 has no grating and is scored as a timeout.
+
+static const pd_variant_t tiered_variants[] = {
+    { .cue_hz =  500, .grating = 0, .pulses = 1, .cue_marker = CUE_0, .reward_marker = REWARD_0,
+      .reward_outcome = PD_OUT_TIMEOUT, .field_B = 0.003f },
+    { .cue_hz = 1000, .grating = 1, .pulses = 2, .cue_marker = CUE_1, .reward_marker = REWARD_1,
+      .reward_outcome = PD_OUT_CORRECT, .field_B = 0.003f },
+    { .cue_hz = 2000, .grating = 2, .pulses = 3, .cue_marker = CUE_2, .reward_marker = REWARD_2,
+      .reward_outcome = PD_OUT_CORRECT, .field_B = 0.003f },
+    { .cue_hz = 3000, .grating = 3, .pulses = 4, .cue_marker = CUE_3, .reward_marker = REWARD_3,
+      .reward_outcome = PD_OUT_CORRECT, .field_B = 0.003f },
+};
+
+static const pd_state_def_t tiered_states[] = {
+    {
+        .name = "init", .tag = S_INIT, .mark = PD_MARK_FIXED, .marker = INIT,
+        .timeout_ms = 50,           // keeps the INIT and CUE markers apart
+        .entry = { ACT(PD_A_NEW_TRIAL), ACT(PD_A_CUE_OFF), ACT(PD_A_LOCK, .a = 1),
+                   ACT(PD_A_CTRL, .a = PD_CTRL_HOLD), ACT(PD_A_FIELD) },
+        .trans = { { PD_C_TIMER, .next = "cue" } },
+    },
+    {
+        .name = "cue", .tag = S_CUE, .mark = PD_MARK_CUE, .timeout_ms = 500,
+        .entry = { ACT(PD_A_CUE_ON, .a = 500), ACT(PD_A_CAPTURE_BEGIN), ACT(PD_A_RT_START) },
+        .trans = { { PD_C_BELOW, REWARD_THRESHOLD, 100, "reward" },
+                   { PD_C_TIMER, .next = "moving" } },
+    },
+    {
+        .name = "moving", .tag = S_MOVING, .mark = PD_MARK_FIXED, .marker = MOVING,
+        .timeout_ms = 3000,
+        .entry = { ACT(PD_A_CUE_OFF), ACT(PD_A_LOCK, .a = 0),
+                   ACT(PD_A_CTRL, .a = PD_CTRL_FIELD), ACT(PD_A_FIELD_TRIGGER) },
+        .trans = { { PD_C_BELOW, REWARD_THRESHOLD, 100, "reward" },
+                   { PD_C_TIMER, .next = "timeout" } },
+    },
+    {
+        .name = "reward", .tag = S_REWARD, .mark = PD_MARK_REWARD,
+        .entry = { ACT(PD_A_CUE_OFF), ACT(PD_A_CTRL, .a = PD_CTRL_STAY), ACT(PD_A_RT_STOP),
+                   ACT(PD_A_OUTCOME, .a = PD_OUTCOME_VARIANT),
+                   ACT(PD_A_REWARD, .a = REWARD_TONE_HZ, .b = REWARD_PHASE_MS) },
+        .trans = { { PD_C_DONE, .next = "reset" } },
+    },
+    {
+        .name = "timeout", .tag = S_TIMEOUT, .mark = PD_MARK_FIXED, .marker = TIMEOUT,
+        .timeout_ms = 500,
+        .entry = { ACT(PD_A_CTRL, .a = PD_CTRL_STAY), ACT(PD_A_OUTCOME, .a = PD_OUT_TIMEOUT) },
+        .trans = { { PD_C_TIMER, .next = "reset" } },
+    },
+    RESET_STATES,
+};
+
+static const pd_def_t tiered = {
+    .name       = "tiered",
+    .variants   = tiered_variants,
+    .n_variants = sizeof(tiered_variants) / sizeof(tiered_variants[0]),
+    .states     = tiered_states,
+    .n_states   = sizeof(tiered_states) / sizeof(tiered_states[0]),
+};
+
+// ───────────── pull: one cue, one reward ─────────────
+//
+// 3 kHz cue with the middle grating, then 3 s to pull past −25 (no hold) with
+// the lever free. RT is timed from the end of the cue.
+
+static const pd_variant_t pull_variants[] = {
+    { .cue_hz = 3000, .grating = 2, .pulses = 1, .cue_marker = CUE_0, .reward_marker = REWARD_0,
+      .reward_outcome = PD_OUT_CORRECT, .field_B = 0.0f },
+};
+
+static const pd_state_def_t pull_states[] = {
+    {
+        .name = "init", .tag = S_INIT, .mark = PD_MARK_FIXED, .marker = INIT,
+        .timeout_ms = 50,
+        .entry = { ACT(PD_A_NEW_TRIAL), ACT(PD_A_CUE_OFF), ACT(PD_A_LOCK, .a = 1),
+                   ACT(PD_A_CTRL, .a = PD_CTRL_HOLD), ACT(PD_A_FIELD) },
+        .trans = { { PD_C_TIMER, .next = "cue" } },
+    },
+    {
+        .name = "cue", .tag = S_CUE, .mark = PD_MARK_CUE, .timeout_ms = 500,
+        .entry = { ACT(PD_A_CUE_ON, .a = 500), ACT(PD_A_CAPTURE_BEGIN) },
+        .trans = { { PD_C_TIMER, .next = "moving" } },
+    },
+    {
+        .name = "moving", .tag = S_MOVING, .mark = PD_MARK_FIXED, .marker = MOVING,
+        .timeout_ms = 3000,
+        .entry = { ACT(PD_A_CUE_OFF), ACT(PD_A_LOCK, .a = 0),
+                   ACT(PD_A_CTRL, .a = PD_CTRL_FIELD), ACT(PD_A_RT_START) },
+        .trans = { { PD_C_BELOW, -25, 0, "reward" },
+                   { PD_C_TIMER, .next = "timeout" } },
+    },
+    {
+        .name = "reward", .tag = S_REWARD, .mark = PD_MARK_REWARD,
+        .entry = { ACT(PD_A_CTRL, .a = PD_CTRL_STAY), ACT(PD_A_RT_STOP),
+                   ACT(PD_A_OUTCOME, .a = PD_OUTCOME_VARIANT),
+                   ACT(PD_A_REWARD, .a = REWARD_TONE_HZ, .b = REWARD_PHASE_MS) },
+        .trans = { { PD_C_DONE, .next = "reset" } },
+    },
+    {
+        .name = "timeout", .tag = S_TIMEOUT, .mark = PD_MARK_FIXED, .marker = TIMEOUT,
+        .timeout_ms = 500,
+        .entry = { ACT(PD_A_CTRL, .a = PD_CTRL_STAY), ACT(PD_A_OUTCOME, .a = PD_OUT_TIMEOUT) },
+        .trans = { { PD_C_TIMER, .next = "reset" } },
+    },
+    RESET_STATES,
+};
+
+static const pd_def_t pull = {
+    .name       = "pull",
+    .variants   = pull_variants,
+    .n_variants = sizeof(pull_variants) / sizeof(pull_variants[0]),
+    .states     = pull_states,
+    .n_states   = sizeof(pull_states) / sizeof(pull_states[0]),
+};
+
+// ───────────── autocomplete: the motor makes the movement ─────────────
+//
+// Same cues and rewards as "tiered", but 100 ms after the cue the controller
+// moves the lever to −50 (minimum jerk) and the animal only has to let it.
+
+#define AUTO_TARGET         -50
+
+static const pd_state_def_t autocomplete_states[] = {
+    {
+        .name = "init", .tag = S_INIT, .mark = PD_MARK_FIXED, .marker = INIT,
+        .timeout_ms = 50,
+        .entry = { ACT(PD_A_NEW_TRIAL), ACT(PD_A_CUE_OFF), ACT(PD_A_LOCK, .a = 1),
+                   ACT(PD_A_CTRL, .a = PD_CTRL_HOLD) },
+        .trans = { { PD_C_TIMER, .next = "cue" } },
+    },
+    {
+        .name = "cue", .tag = S_CUE, .mark = PD_MARK_CUE, .timeout_ms = 500,
+        .entry = { ACT(PD_A_CUE_ON, .a = 500), ACT(PD_A_CAPTURE_BEGIN), ACT(PD_A_RT_START) },
+        .trans = { { PD_C_TIMER, .next = "delay" } },
+    },
+    {
+        .name = "delay", .tag = S_CUE, .timeout_ms = 100,
+        .entry = { ACT(PD_A_CUE_OFF) },
+        .trans = { { PD_C_TIMER, .next = "moving" } },
+    },
+    {
+        .name = "moving", .tag = S_MOVING, .mark = PD_MARK_FIXED, .marker = MOVING,
+        .timeout_ms = 3000,
+        .entry = { ACT(PD_A_CTRL, .a = PD_CTRL_TRACK, .b = AUTO_TARGET) },
+        .trans = { { PD_C_BELOW, AUTO_TARGET + 1, 50, "reward" },
+                   { PD_C_TIMER, .next = "timeout" } },
+    },
+    {
+        .name = "reward", .tag = S_REWARD, .mark = PD_MARK_REWARD,
+        .entry = { ACT(PD_A_CTRL, .a = PD_CTRL_STAY), ACT(PD_A_RT_STOP),
+                   ACT(PD_A_OUTCOME, .a = PD_OUTCOME_VARIANT),
+                   ACT(PD_A_REWARD, .a = REWARD_TONE_HZ, .b = REWARD_PHASE_MS) },
+        .trans = { { PD_C_DONE, .next = "reset" } },
+    },
+    {
+        .name = "timeout", .tag = S_TIMEOUT, .mark = PD_MARK_FIXED, .marker = TIMEOUT,
+        .timeout_ms = 500,
+        .entry = { ACT(PD_A_CTRL, .a = PD_CTRL_STAY), ACT(PD_A_OUTCOME, .a = PD_OUT_TIMEOUT) },
+        .trans = { { PD_C_TIMER, .next = "reset" } },
+    },
+    RESET_STATES,
+};
+
+static const pd_def_t autocomplete = {
+    .name       = "autocomplete",
+    .variants   = tiered_variants,
+    .n_variants = sizeof(tiered_variants) / sizeof(tiered_variants[0]),
+    .states     = autocomplete_states,
+    .n_states   = sizeof(autocomplete_states) / sizeof(autocomplete_states[0]),
+};
+
+esp_err_t paradigms_register_all(void)
+{
+    ESP_RETURN_ON_ERROR(pd_register(&tiered),       TAG, "tiered");
+    ESP_RETURN_ON_ERROR(pd_register(&pull),         TAG, "pull");
+    ESP_RETURN_ON_ERROR(pd_register(&autocomplete), TAG, "autocomplete");
+    return ESP_OK;
+}
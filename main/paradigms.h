@@ -0,0 +1,24 @@
+// main/paradigms.h
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The built-in paradigm tables (see paradigm.h):
+ *   "tiered"        four cue/reward levels, viscous field, early-cue reward path
+ *   "pull"          single cue, pull past threshold, one reward pulse
+ *   "autocomplete"  the lever is driven to the target after the cue
+ */
+
+/**
+ * @brief  pd_register() every built-in table.
+ */
+esp_err_t paradigms_register_all(void);
+
+#ifdef __cplusplus
+}
+#endif
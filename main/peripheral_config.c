@@ -1,16 +0,0 @@
-#include "esp_err.h"
-#include "driver/uart.h"
-
-//******************* UART INIT *******************//
-
-
-const uart_port_t uart_num = UART_NUM_2;
-uart_config_t uart_config = {
-    .baud_rate = 115200,
-    .data_bits = UART_DATA_8_BITS,
-    .parity = UART_PARITY_DISABLE,
-    .stop_bits = UART_STOP_BITS_1,
-    .flow_ctrl = UART_HW_FLOWCTRL_DISABLE
-};
-
-//********************UART INIT ********************//
@@ -2,111 +2,125 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include <string.h>
+#include <strings.h>
 #include <math.h>
-#include "driver/pcnt_types_legacy.h"
+#include <stdatomic.h>
 #include "esp_err.h"
+#include "esp_check.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "esp_log.h"
-#include "esp_random.h"
 #include "esp_rom_sys.h"
-#include "driver/pcnt.h"
+#include "esp_timer.h"
 
 #include "hal/gpio_types.h"
 #include "lvgl.h"
 #include "lv_conf.h"
 #include "graphics.h"
-#include "audio_pwm.c"
-#include "peripheral_config.c"
 
+#include "app_mode.h"
 #include "motor_init.h"
 #include "motorctrl.h"
-#include "encoder.h"
+#include "rtexec.h"
+#include "rtstats.h"
+#include "rig.h"
+#include "serial_cmd.h"
+#include "stim.h"
+#include "stimfb.h"
+#include "kinbus.h"
 #include "encoder_out.h"
+#include "forcefield.h"
+#include "clocksync.h"
 #include "event.h"
-#include "reward.h"
-#include "state_machine.h"
+#include "journal.h"
+#include "paradigm.h"
+#include "paradigms.h"
+#include "telemetry.h"
+#include "trial_capture.h"
+#include "tone.h"
+#include "twheel.h"
+#include "traj.h"
 
 #include "driver/gpio.h"
 
 #define TAG                 "PHASE1_TASK"
 #define GPIO_REWARD_SIGNAL  3
 #define GPIO_EVENT_PIN      4
-#define ENCODER_THRESHOLD   -27
-#define CUE_DURATION_MS     500
-#define TRIAL_TIMEOUT_MS    3000
-#define RESET_DELAY_MS      1000
 #define STACK_SIZE          16384
-#define UI_TASK_PERIOD_MS   10
 #define SCREEN_WIDTH        1024
 #define SCREEN_HEIGHT       600
-#define REWARD_HOLD_MS 100 // how long to hold past encoder count thresh.
-#define RESET_THRESHOLD    5    // only consider “home” if within ±5 counts of zero
-#define RESET_HOLD_MS     100    // must hold for 20 ms before we call it done
-#define HANDLE_EARLY_CUE_REWARD 1   // 1 = enable cue→reward direct path (single REWARD pulse)
-
-
-static const float B_level[4] = {0.003f, 0.003f, 0.003f, 0.003f}; // set the levels of B coeff for vsicous force fields
+#define HOME_V_MAX_CPS    150.0f // CTRL_TRACK move limits (minimum-jerk, see traj.h)
+#define HOME_A_MAX_CPS2   1500.0f
+#define HOME_KFF          0.004f // tracking velocity feedforward, % per count/s
+#define PID_DEADZONE_CNT  2    // hold deadzone; friction feedforward makes small errors correctable
+// rate groups of the cyclic executive (see rt_groups in task_init)
+#define ENCODER_RATE_HZ   5000   // input stage: encoder → kinbus (= RTEXEC_BASE_RATE_HZ)
+#define CONTROL_RATE_HZ   1000   // motor control
+#define TRIAL_RATE_HZ     500    // trial state machine
+#define UI_RATE_HZ        60     // lever indicator + lv_timer_handler
+#define TLM_KIN_RATE_HZ   1000   // kinematics/effort records per second (divides CONTROL_RATE_HZ)
+#define CAPTURE_MAX_MS    15000  // longest CUE→RESET span kept per trial (at TLM_KIN_RATE_HZ)
+#define BOOT_PARADIGM     "tiered" // paradigms.c; PARADIGM <name> switches at the next trial
 // -----------------------------------------------------------------------------
-// global flag for PID‐homing
-static volatile bool homing_active = false;
 static float kp = 0.21;
 static float ki = 0.003;
 static float kd = 0.005;
 // -----------------------------------------------------------------------------
 
-
+// what the control loop drives the motor with; requested by the paradigm
 typedef enum {
-    TRIAL_CORRECT = 0,
-    TRIAL_TIMEOUT
-} trial_outcome_t;
+    CTRL_HOLD  = PD_CTRL_HOLD,    // PID toward zero (lever locked)
+    CTRL_FIELD = PD_CTRL_FIELD,   // force-field set (forcefield.c) during MOVING
+    CTRL_TRACK = PD_CTRL_TRACK,   // minimum-jerk move to ctrl_target, then hold it
+    CTRL_STAY  = PD_CTRL_STAY     // PID toward the position at the hand-over
+} ctrl_mode_t;
 
-// globals
-static SemaphoreHandle_t encoder_mutex;
-static volatile int32_t  current_encoder_value;
+// Written by the trial task, then published by bumping ctrl_seq; the control
+// loop picks up mode and target together when it sees a new sequence number.
+static volatile ctrl_mode_t ctrl_mode   = CTRL_HOLD;
+static volatile int32_t     ctrl_target = 0;
+static _Atomic uint32_t     ctrl_seq;
+static _Atomic uint32_t     track_done_seq = UINT32_MAX;   // ctrl_seq whose CTRL_TRACK move has finished
+
+// rate groups, in rt_groups[] order (group 0 is the executive's input stage)
+enum { GRP_ENCODER = 0, GRP_CONTROL, GRP_TRIAL, GRP_UI, GRP_COUNT };
 
-static lv_obj_t *grating1, *grating2, *grating3;
+// per-stage execution time inside control_step (CPU cycles, see STATS)
+static rtstats_t st_field, st_pid, st_track, st_apply, st_dac;
+
+// globals
+static int       grating_frame[4];      // stimfb frames for reward levels 1..3
 static lv_obj_t *lever_indicator;
 static lv_obj_t *trial_info_label;
-static lv_obj_t *create_grating_pattern(lv_obj_t *parent, int stripes);
-static void hide_all_gratings(void);
 
 
 static uint32_t trial_number;
 static uint32_t session_correct;
 static uint32_t session_total;
+static atomic_bool stats_changed;       // set by the trial group, drawn by the UI group
 
-bool motor_locked = false;
-
-// cue frequencies for rewardType = 0..3
-static const uint32_t cue_freqs[4] = { 500, 1000, 2000, 3000 };
-
-static const uint32_t reward_freq = 5000;
+static atomic_bool motor_locked;    // trial group sets, control group reads
 
-// send CSV over UART / printf
-static void send_trial_data(trial_outcome_t outcome,
+// queue the trial summary as a TLM_TRIAL record (decoded by telemetry.py)
+static void send_trial_data(uint8_t outcome,
+                            int reward_type,
                             uint32_t reaction_time_ms,
                             int32_t encoder_position)
 {
-    const char *out_str = (outcome==TRIAL_CORRECT) ? "CORRECT" : "TIMEOUT";
-    printf("TRIAL,%s,%lu,%ld\n",
-           out_str,
-           (unsigned long)reaction_time_ms,
-           (long)encoder_position);
-    ESP_LOGI(TAG,
-             "Trial %lu: %s, RT=%lums, Pos=%ld",
-             trial_number,
-             out_str,
-             (long)reaction_time_ms,
-             (long)encoder_position);
+    telemetry_trial(trial_number,
+                    outcome,
+                    (uint8_t)reward_type,
+                    reaction_time_ms,
+                    encoder_position,
+                    session_correct,
+                    session_total);
 }
 
-// update the on-screen stats
+// update the on-screen stats (UI group, LVGL lock held)
 static void update_trial_display(void)
 {
     if (!trial_info_label) return;
-    if (!lvgl_lock(10)) return;
 
     float success = session_total
                   ? ((float)session_correct / session_total)*100.0f
@@ -117,128 +131,54 @@ static void update_trial_display(void)
         session_correct,
         session_total,
         success);
-    lvgl_unlock();
 }
 
-// create a grating container with `stripes` green bars
-static lv_obj_t *create_grating_pattern(lv_obj_t *parent, int stripes)
+// pre-render the gratings for reward levels 1..3: green bars on black
+// (stripe counts 13, 7 and 3, from the earlier design)
+static esp_err_t create_gratings(void)
 {
-    int sw = SCREEN_WIDTH / stripes;
-    lv_obj_t *cont = lv_obj_create(parent);
-    lv_obj_remove_style_all(cont);
-    lv_obj_set_size(cont, SCREEN_WIDTH, SCREEN_HEIGHT);
-    lv_obj_set_style_bg_color(cont, lv_color_hex(0x000000), 0);
-
-    for (int i = 0; i < stripes; i += 2) {
-        lv_obj_t *s = lv_obj_create(cont);
-        lv_obj_remove_style_all(s);
-        lv_obj_set_size(s, sw, SCREEN_HEIGHT);
-        lv_obj_set_pos(s, i*sw, 0);
-        lv_obj_set_style_bg_color(s, lv_color_hex(0x00FF00), 0);
-        lv_obj_set_style_bg_opa(s, LV_OPA_COVER, 0);
+    static const int stripes[4] = { 0, 13, 7, 3 };
+    grating_frame[0] = STIMFB_BLANK;
+    for (int r = 1; r <= 3; r++) {
+        ESP_RETURN_ON_ERROR(stimfb_new_grating(stripes[r], 0x00FF00, 0x000000, &grating_frame[r]),
+                            TAG, "grating %d", r);
     }
-    return cont;
+    return ESP_OK;
 }
 
-// hide all three gratings
-static void hide_all_gratings(void)
-{
-    if (!lvgl_lock(10)) return;
-    lv_obj_add_flag(grating1, LV_OBJ_FLAG_HIDDEN);
-    lv_obj_add_flag(grating2, LV_OBJ_FLAG_HIDDEN);
-    lv_obj_add_flag(grating3, LV_OBJ_FLAG_HIDDEN);
-    lvgl_unlock();
-}
-
-// show only the grating for rewardType 1..3, none for 0
+// show only the grating for rewardType 1..3, none for 0 (one DMA copy)
 static void show_grating_for(int reward)
 {
-    if (!lvgl_lock(10)) return;
-    lv_obj_add_flag(grating1, LV_OBJ_FLAG_HIDDEN);
-    lv_obj_add_flag(grating2, LV_OBJ_FLAG_HIDDEN);
-    lv_obj_add_flag(grating3, LV_OBJ_FLAG_HIDDEN);
-    if      (reward == 1) lv_obj_clear_flag(grating1, LV_OBJ_FLAG_HIDDEN);
-    else if (reward == 2) lv_obj_clear_flag(grating2, LV_OBJ_FLAG_HIDDEN);
-    else if (reward == 3) lv_obj_clear_flag(grating3, LV_OBJ_FLAG_HIDDEN);
-    lvgl_unlock();
+    if (reward < 0 || reward > 3) reward = 0;
+    if (stimfb_show(grating_frame[reward]) != ESP_OK) ESP_LOGW(TAG, "grating %d not shown", reward);
 }
 
-// sample the PCNT every 5 ms and push to the DAC
-void encoder_read_task(void *pv)
+// update lever graphic (rate group "ui", UI_RATE_HZ)
+static void ui_step(const kin_sample_t *kin, void *ctx)
 {
-    const TickType_t period = pdMS_TO_TICKS(5);
-    TickType_t next = xTaskGetTickCount();
-    while (1) {
-        int32_t val = read_encoder();
-        if (encoder_mutex) {
-            xSemaphoreTake(encoder_mutex, portMAX_DELAY);
-            current_encoder_value = val;
-            encoder_out_update(val);
-            xSemaphoreGive(encoder_mutex);
-        }
-        vTaskDelayUntil(&next, period);
-    }
-}
-
-// update lever graphic every UI_TASK_PERIOD_MS
-void ui_update_task(void *pv)
-{
-    const TickType_t period = pdMS_TO_TICKS(UI_TASK_PERIOD_MS);
-    TickType_t next = xTaskGetTickCount();
-
-    while (1) {
-        int32_t pos = 0;
-        if (encoder_mutex) {
-            xSemaphoreTake(encoder_mutex, portMAX_DELAY);
-            pos = current_encoder_value*-1;
-            xSemaphoreGive(encoder_mutex);
-        }
+    int32_t pos = kin->pos*-1;
 
-        // map pos → screen X
-        int32_t center = SCREEN_WIDTH/2;
-        int32_t span   = SCREEN_WIDTH/2 - 25;
-        int32_t x = center + (pos*span)/200;
-        if (x < 25) x = 25;
-        if (x > SCREEN_WIDTH-25) x = SCREEN_WIDTH-25;
-
-        if (lvgl_lock(10)) {
-            lv_obj_set_x(lever_indicator, x-25);
-            lv_timer_handler();
-            lvgl_unlock();
-        }
+    // map pos → screen X
+    int32_t center = SCREEN_WIDTH/2;
+    int32_t span   = SCREEN_WIDTH/2 - 25;
+    int32_t x = center + (pos*span)/200;
+    if (x < 25) x = 25;
+    if (x > SCREEN_WIDTH-25) x = SCREEN_WIDTH-25;
 
-        vTaskDelayUntil(&next, period);
-    }
-}
-
-// play audio + visual during cue
-static void play_audio_and_visual_cue(uint32_t freq, uint32_t ms)
-{
     if (lvgl_lock(10)) {
-        show_grating_for(0);  // temporarily show something? optional
-        lvgl_unlock();
-    }
-    init_ledc(freq);
-    vTaskDelay(pdMS_TO_TICKS(ms));
-    ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 0);
-    ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_1, 0);
-    if (lvgl_lock(10)) {
-        hide_all_gratings();
+        lv_obj_set_x(lever_indicator, x-25);
+        if (atomic_exchange(&stats_changed, false)) update_trial_display();
+        lv_timer_handler();
         lvgl_unlock();
     }
 }
 
 static void create_simple_ui(lv_display_t *display) {
-    // 1) black background
+    // 1) key-colour background: the stimulus layer (gratings) shows through
     lv_obj_t *scr = lv_disp_get_scr_act(display);
-    lv_obj_set_style_bg_color(scr, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_bg_color(scr, lv_color_hex(LCD_KEY_COLOR), 0);
 
-    // 2) create three gratings for reward levels 1..3
-    //    (stripe counts: 3, 7, and 13 are from your earlier design)
-    grating1 = create_grating_pattern(scr,  13);
-    grating2 = create_grating_pattern(scr,  7);
-    grating3 = create_grating_pattern(scr, 3);
-    hide_all_gratings();  // start hidden
+    // 2) the gratings are stimfb frames (create_gratings), not LVGL objects
 
     // 3) lever indicator in center
     lever_indicator = lv_obj_create(scr);
@@ -255,271 +195,151 @@ static void create_simple_ui(lv_display_t *display) {
     lv_obj_set_pos(trial_info_label, 20, 20);
     lv_obj_set_style_text_color(trial_info_label, lv_color_hex(0xFFFFFF), 0);
     lv_obj_set_style_bg_color(trial_info_label, lv_color_hex(0x000000), 0);
-    lv_obj_set_style_bg_opa(trial_info_label, LV_OPA_70, 0);
+    lv_obj_set_style_bg_opa(trial_info_label, LV_OPA_COVER, 0);  // blended over the key it would tint
     lv_obj_set_style_pad_all(trial_info_label, 10, 0);
     lv_label_set_text(trial_info_label,
         "Trial: 0\nCorrect: 0/0\nSuccess: 0.0%");
 }
 
-static void pid_task(void *pv)
+// rate group "ctrl": runs at CONTROL_RATE_HZ, right after the encoder group
+static void control_step(const kin_sample_t *kin, void *ctx)
 {
-    const TickType_t period = pdMS_TO_TICKS(2); // 500 Hz
-    TickType_t next = xTaskGetTickCount();
+    static ctrl_mode_t active = CTRL_HOLD;
+    static uint32_t    seen_seq;
+    static traj_t      move;
+    static int64_t     move_t0;
+    static int32_t     hold_at;       // PID setpoint: 0, or where CTRL_STAY took over
+    int32_t pos = kin->pos;   // published on the kinbus by the encoder group this frame
+
+    uint32_t seq = atomic_load_explicit(&ctrl_seq, memory_order_acquire);
+    if (seq != seen_seq) {
+        ctrl_mode_t mode = ctrl_mode;
+        // reset controller history on every hand-over; the field has no state to seed
+        if ((mode == CTRL_HOLD || mode == CTRL_STAY) && active != mode) pid_clear_state();
+        hold_at = (mode == CTRL_STAY) ? pos : 0;
+        if (mode == CTRL_TRACK) {
+            // planned here, from this step's position, so the move starts without a jump
+            traj_plan_minjerk(&move, (float)pos, (float)ctrl_target, HOME_V_MAX_CPS, HOME_A_MAX_CPS2);
+            move_t0 = kin->t_us;
+            track_clear_state();
+        }
+        active   = mode;
+        seen_seq = seq;
+    }
 
-    while (1) {
-        // grab the latest encoder count under mutex
-        int32_t pos;
-        xSemaphoreTake(encoder_mutex, portMAX_DELAY);
-          pos = current_encoder_value;
-        xSemaphoreGive(encoder_mutex);
+    // evaluated in both modes so a set loaded while holding is picked up
+    // (and acknowledged) before MOVING starts
+    float field;
+    RTSTATS_TIME(&st_field, field = ff_eval(kin));
+
+    float u;
+    if (active == CTRL_FIELD) {
+        u = atomic_load_explicit(&motor_locked, memory_order_relaxed) ? 0.0f : field;
+        RTSTATS_TIME(&st_apply, apply_control_mcpwm(u));
+    } else if (active == CTRL_TRACK) {
+        float t = (float)(kin->t_us - move_t0) * 1e-6f;
+        float x_ref, v_ref;
+        traj_eval(&move, t, &x_ref, &v_ref);
+        RTSTATS_TIME(&st_track, u = track_step(pos, kin->vel, x_ref, v_ref));   // applies too
+        // tagged with the request it finished, so a newer pd_ctrl() is never reported done
+        if (t >= move.T) atomic_store_explicit(&track_done_seq, seen_seq, memory_order_release);
+    } else {
+        RTSTATS_TIME(&st_pid, u = pid_step(pos, hold_at));   // includes its apply_control_mcpwm()
+    }
 
-        // always home toward zero during RESET state only:
-        // (you can gate this with a flag if needed)
-        pid_step(pos, 0);
+    static uint32_t steps;
+    if (++steps % (CONTROL_RATE_HZ / TLM_KIN_RATE_HZ) == 0) {
+        telemetry_kin(kin->t_us, pos, kin->vel);
+        telemetry_effort(kin->t_us, u, (uint8_t)active);
+        trial_capture_sample(kin->t_us, pos, kin->vel, u);
+    }
 
-        vTaskDelayUntil(&next, period);
+    // analog copy of the position for the Intan; the DAC task does the I2C
+    RTSTATS_TIME(&st_dac, encoder_out_update(pos));
+}
+
+// PARADIGM [name]: list the registered paradigms, or switch at the next trial
+static void cmd_paradigm(const char *args)
+{
+    if (*args) {
+        printf("paradigm %s: %s\n", args, esp_err_to_name(pd_select(args)));
+        return;
+    }
+    const char *cur = pd_current();
+    for (int i = 0; pd_name(i); i++) {
+        printf("%c %s\n", (cur && strcmp(cur, pd_name(i)) == 0) ? '*' : ' ', pd_name(i));
     }
 }
 
-static void pulse_reward_ttl() {
-    gpio_set_level(GPIO_REWARD_SIGNAL, 1);
-    vTaskDelay(pdMS_TO_TICKS(500));
-    gpio_set_level(GPIO_REWARD_SIGNAL, 0);
+// ───────────── paradigm hooks (called from pd_step, trial task) ─────────────
+
+static void pd_ctrl(pd_ctrl_t mode, int32_t target)
+{
+    ctrl_target = target;
+    ctrl_mode   = (ctrl_mode_t)mode;
+    atomic_fetch_add_explicit(&ctrl_seq, 1, memory_order_release);
 }
 
-    void simplified_trial_task(void *pv)
+static bool pd_ctrl_done(void)
 {
-    const TickType_t loop_period = pdMS_TO_TICKS(2);  // 500 Hz
-    TickType_t next = xTaskGetTickCount();
-
-    sm_state_t   state        = S_INIT;
-    TickType_t   state_ts     = next;
-    TickType_t   hold_ts      = 0;
-    int          rewardType   = 0;
-    const int32_t targetPos   = 0;
-    bool         first_entry  = true;
-
-    while(1) {
-        TickType_t now = xTaskGetTickCount();
-
-        // Always update the reward‐TTL engine first
-        reward_update(now);
-
-        // Sample encoder once per loop
-        int32_t pos;
-        xSemaphoreTake(encoder_mutex, portMAX_DELAY);
-          pos = current_encoder_value;
-        xSemaphoreGive(encoder_mutex);
-
-        switch(state) {
-        // ───────────── INIT ─────────────
-        case S_INIT:
-            if (first_entry) {
-                trial_number++;  session_total++;
-                hide_all_gratings();
-                rewardType   = rand() % 4;
-                motor_locked = true;
-                motorctrl_init_viscous(0.002f, 0.02f, B_level[rewardType]);
-                first_entry  = false;
-            }
-            
-            if (now - state_ts >= pdMS_TO_TICKS(50)) {   // ~10 ms separation
-            sm_enter(S_CUE, CUE_EVENT[rewardType]);
-            
-            state     = S_CUE;
-            state_ts  = now;
-            first_entry = true;
-            }
-            break;
-
-        // ───────────── CUE ──────────────
-        case S_CUE:
-        if (first_entry) {
-            if (rewardType > 0) show_grating_for(rewardType);
-            init_ledc(cue_freqs[rewardType]);   // cue tone/visuals
-            first_entry = false;
-        }
+    return atomic_load_explicit(&track_done_seq, memory_order_acquire) ==
+           atomic_load_explicit(&ctrl_seq, memory_order_relaxed);
+}
 
-    #if HANDLE_EARLY_CUE_REWARD
-        // Early-response path: if lever is held past threshold during the cue window
-        if (pos < ENCODER_THRESHOLD) {
-            if (hold_ts == 0) hold_ts = now;
-            else if (now - hold_ts >= pdMS_TO_TICKS(REWARD_HOLD_MS)) {
-                // End cue visuals/audio
-                ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 0);
-                ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_1, 0);
-                hide_all_gratings();
-
-                // Emit exactly ONE reward marker here (skip MOVING marker)
-                (void)event_send_state_immediate(REW_EVENT[rewardType]);
-
-                // Transition to S_REWARD WITHOUT emitting again
-                sm_enter_no_emit(S_REWARD);
-                state       = S_REWARD;
-                state_ts    = now;
-                first_entry = true;
-                hold_ts     = 0;
-                break;
-            }
-        } else {
-            hold_ts = 0;
-        }
-    #endif
-
-        // Normal end-of-cue → MOVING path
-        if (now - state_ts >= pdMS_TO_TICKS(CUE_DURATION_MS)) {
-            ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 0);
-            ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_1, 0);
-            hide_all_gratings();
-            motor_locked = false;
-
-            sm_enter(S_MOVING, MOVING);     // emits MOVING marker
-            state       = S_MOVING;
-            state_ts    = now;
-            first_entry = true;
-        }
-        break;
-
-
-        // ───────────── MOVING ────────────
-        case S_MOVING:
-            {
-                float u = motor_locked ? 0.0f : motorctrl_viscous(pos);
-                apply_control_mcpwm(u);
-                
-            }
-            // threshold‐crossing?
-            if (pos < ENCODER_THRESHOLD) {
-                if (hold_ts == 0) hold_ts = now;
-                else if (now - hold_ts >= pdMS_TO_TICKS(REWARD_HOLD_MS)) {
-                    sm_enter(S_REWARD, REW_EVENT[rewardType]);
-                    state     = S_REWARD;
-                    state_ts  = now;
-                    first_entry = true;
-                }
-            } else {
-                hold_ts = 0;
-            }
-            // timeout‐fallback?
-            if (now - state_ts > pdMS_TO_TICKS(TRIAL_TIMEOUT_MS)) {
-                sm_enter(S_TIMEOUT, TIMEOUT);
-                state     = S_TIMEOUT;
-                state_ts  = now;
-                first_entry = true;
-            }
-            break;
-
-       // ───────────── REWARD ────────────
-        case S_REWARD: {
-            // Uses outer `first_entry` (no shadowing). Event marker is emitted at transition.
-            static int        pulses_done;
-            static bool       pin_high;
-            static TickType_t last_toggle;
-
-            const int        pulses_plus_one = rewardType + 1;      // reward_0→1 drop, reward_1→2, etc.
-            const TickType_t PHASE_MS        = pdMS_TO_TICKS(500);  // HIGH then LOW per pulse
-
-            if (first_entry) {
-                first_entry = false;
-
-                // start first HIGH phase (tone + pump TTL)
-                pulses_done = 0;
-                pin_high    = true;
-                gpio_set_level(GPIO_REWARD_SIGNAL, 1);   // pump on
-                init_ledc(reward_freq);                  // reward tone on
-                last_toggle = now;
-                break;
-            }
-
-            TickType_t dt = now - last_toggle;
-
-            if (pin_high && dt >= PHASE_MS) {
-                // HIGH → LOW (end one half-cycle)
-                gpio_set_level(GPIO_REWARD_SIGNAL, 0);   // pump off
-                ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 0);
-                ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_1, 0);
-                pin_high   = false;
-                last_toggle = now;
-            } else if (!pin_high && dt >= PHASE_MS) {
-                // Completed one full pulse (HIGH+LOW)
-                pulses_done++;
-                if (pulses_done < pulses_plus_one) {
-                    // next pulse: go HIGH again (tone + pump)
-                    gpio_set_level(GPIO_REWARD_SIGNAL, 1);
-                    init_ledc(reward_freq);
-                    pin_high    = true;
-                    last_toggle = now;
-                } else {
-                    // all pulses completed → advance
-                    first_entry = true;
-                    sm_enter(S_RESET, RESET);   // emits RESET marker
-                    state     = S_RESET;
-                    state_ts  = now;
-                }
-            }
-            break;
-        }
+static void pd_lock(bool locked)
+{
+    atomic_store_explicit(&motor_locked, locked, memory_order_relaxed);
+}
 
+static void pd_visual(int grating)
+{
+    show_grating_for(grating);
+}
 
+static void pd_new_trial(uint32_t trial, const pd_variant_t *v)
+{
+    trial_number = trial;
+    session_total++;
+}
 
-        // ───────────── TIMEOUT ───────────
-        case S_TIMEOUT:
-            if (first_entry) {
-                // you could flash a “timeout” tone or LED here
-                first_entry = false;
-            }
-            // after a short pause, go home
-            if (now - state_ts >= pdMS_TO_TICKS(500)) {
-                sm_enter(S_RESET, RESET);
-                state     = S_RESET;
-                state_ts  = now;
-                first_entry = true;
-            }
-            break;
-
-        // ───────────── RESET ─────────────
-        case S_RESET:
-            if (first_entry) {
-                // arm your PID toward zero once
-                pid_init(kp, ki, kd,0,0,0.002,5);
-                first_entry = false;
-                printf(">> RESET: homing started\n");
-            }
-            // run one PID step (in‐line or via pid_task)
-            pid_step(pos, targetPos);
-            // once “home,” stop and wrap up trial
-            if (abs(pos - targetPos) <= RESET_THRESHOLD) {
-                apply_control_mcpwm(0);
-                send_trial_data(
-                  (rewardType>0) ? TRIAL_CORRECT : TRIAL_TIMEOUT,
-                  pdTICKS_TO_MS(now - state_ts),
-                  pos
-                );
-                update_trial_display();
-                // after a little hold, back to INIT
-                if (now - state_ts >= pdMS_TO_TICKS(RESET_DELAY_MS)) {
-                    sm_enter(S_INIT, INIT);
-                    state     = S_INIT;
-                    state_ts  = now;
-                    first_entry = true;
-                }
-                vTaskDelay(pdMS_TO_TICKS(1500));
-            }
-            break;
-        }
+static void pd_report(const pd_report_t *r)
+{
+    if (r->outcome == PD_OUT_CORRECT) session_correct++;
+    send_trial_data(r->outcome, r->variant, r->rt_ms, r->pos);
+    atomic_store(&stats_changed, true);     // the trial group never takes the LVGL lock
+}
 
-        vTaskDelayUntil(&next, loop_period);
-    }
+// Trial timers (phase ends, reward pulses, tone stops) live on this wheel;
+// pd_step advances it once per release.
+static twheel_t trial_wheel;
+
+// rate group "trial": the selected paradigm (paradigm.c), TRIAL_RATE_HZ
+static void trial_step(const kin_sample_t *kin, void *ctx)
+{
+    pd_step(kin);
 }
 
-void app_main(void)
+// ───────────── mode "task" ─────────────
+
+static esp_err_t task_init(void)
 {
     esp_log_level_set(TAG, ESP_LOG_INFO);
+    ESP_RETURN_ON_ERROR(trial_capture_init(CAPTURE_MAX_MS * TLM_KIN_RATE_HZ / 1000,
+                                           1000000 / TLM_KIN_RATE_HZ), TAG, "trial capture");
+    ESP_RETURN_ON_ERROR(serial_cmd_register("PARADIGM", cmd_paradigm, "[name] list or select the trial paradigm"),
+                        TAG, "PARADIGM command");
     ESP_LOGI(TAG, "Starting behavioral task…");
 
-    // setup reward pin
-    // reward_init(GPIO_REWARD_SIGNAL);
-    ESP_ERROR_CHECK(event_init_rmt(GPIO_EVENT_PIN, 1000000));
+    // setup reward pin; markers, reward TTL edges and tones are journaled
+    ESP_RETURN_ON_ERROR(journal_init(), TAG, "journal");
+    ESP_RETURN_ON_ERROR(event_init_rmt(GPIO_EVENT_PIN, 1000000), TAG, "event RMT");
+#if CONFIG_EVENT_MARKER_WORDS
+    ESP_RETURN_ON_ERROR(event_set_encoding(EVENT_ENC_WORD), TAG, "event words");
+#else
+    // a fast movement can start while the 30-60 ms cue pulse is still high;
+    // its onset edge goes out on time and the cut cue is flagged truncated
+    ESP_RETURN_ON_ERROR(event_set_policy(MOVING, EVENT_PREEMPT), TAG, "MOVING policy");
+#endif
 
     gpio_config_t io_conf = {
     .pin_bit_mask = 1ULL << GPIO_REWARD_SIGNAL ,
@@ -528,39 +348,81 @@ void app_main(void)
     .pull_down_en = GPIO_PULLDOWN_DISABLE,
     .intr_type    = GPIO_INTR_DISABLE
     };
-    ESP_ERROR_CHECK(gpio_config(&io_conf));
+    ESP_RETURN_ON_ERROR(gpio_config(&io_conf), TAG, "reward pin");
     gpio_set_level(GPIO_REWARD_SIGNAL,0);
-    // encoder + DAC
-    encoder_mutex = xSemaphoreCreateMutex();
-    init_encoder();
-    ESP_ERROR_CHECK( encoder_out_init() );
-
-    // motor
-    init_mcpwm_highres();
-    apply_control_mcpwm(0);
-    motorctrl_init_viscous(0.002f, 0.02f, 0.03f);
-    pid_init(0.21, 0.01,0.001,0,0,0.002,5);
-
-    // graphics
-    lv_display_t *disp = lcd_init();
-    bsp_set_lcd_backlight(1);
+    ESP_RETURN_ON_ERROR(journal_watch_gpio(GPIO_REWARD_SIGNAL), TAG, "reward pin journal");
+    ESP_RETURN_ON_ERROR(clocksync_init((gpio_num_t)CONFIG_CLOCKSYNC_GPIO, CONFIG_CLOCKSYNC_PERIOD_MS),
+                        TAG, "clock sync");
+
+    // encoder, DAC, motor, friction feedforward
+    ESP_RETURN_ON_ERROR(rig_init(ENCODER_RATE_HZ), TAG, "rig");
+
+    // trial deadlines (one wheel tick per trial release); tones on the I2S audio engine
+    twheel_init(&trial_wheel, 1000000 / TRIAL_RATE_HZ, esp_timer_get_time());
+    ESP_RETURN_ON_ERROR(tone_init(), TAG, "tone");
+    // cue sound, grating and marker released together on the display's vsync
+    if (stim_init() != ESP_OK) ESP_LOGW(TAG, "no stimulus commit: cue parts go out as they come");
+
+    // trial paradigms: the tables in paradigms.c, run by pd_step()
+    static const pd_hooks_t hooks = {
+        .ctrl      = pd_ctrl,
+        .ctrl_done = pd_ctrl_done,
+        .lock      = pd_lock,
+        .visual    = pd_visual,
+        .new_trial = pd_new_trial,
+        .report    = pd_report,
+    };
+    ESP_RETURN_ON_ERROR(pd_init(&hooks, &trial_wheel, GPIO_REWARD_SIGNAL), TAG, "paradigm engine");
+    ESP_RETURN_ON_ERROR(paradigms_register_all(), TAG, "paradigms");
+    ESP_RETURN_ON_ERROR(pd_select(BOOT_PARADIGM), TAG, "paradigm %s", BOOT_PARADIGM);
+
+    // graphics (display brought up by main.c): gratings on the stimulus
+    // layer, lever and stats drawn by LVGL over it
+    ESP_RETURN_ON_ERROR(stimfb_init(), TAG, "stimulus layer");
+    ESP_RETURN_ON_ERROR(create_gratings(), TAG, "gratings");
     if (lvgl_lock(100)) {
-        create_simple_ui(disp);
+        create_simple_ui(lv_display_get_default());
         lv_timer_handler();
         lvgl_unlock();
     }
 
-    // tasks
-    xTaskCreate(encoder_read_task,    "enc",   4096, NULL, 6, NULL);
-    xTaskCreate(ui_update_task,       "ui",    4096, NULL, 5, NULL);
-    xTaskCreate(simplified_trial_task,"trial", STACK_SIZE, NULL, 5, NULL);
-    xTaskCreatePinnedToCore(
-    pid_task,
-    "pid",     // name
-    4096,      // stack
-    NULL,      // arg
-    /*prio=*/7, 
-    NULL,
-    /*core=*/0
-);
-}
\ No newline at end of file
+    // cyclic executive: one gptimer, every real-time job in a declared rate
+    // group. Core 0 is input + control only; behaviour and UI live on core 1.
+    static const rtexec_group_t rt_groups[GRP_COUNT] = {
+        //               name     rate             core prio  stack       step
+        [GRP_ENCODER] = { "enc",   ENCODER_RATE_HZ, 0,   12,   3072,       rtexec_encoder_step, NULL },
+        [GRP_CONTROL] = { "ctrl",  CONTROL_RATE_HZ, 0,   11,   4096,       control_step,        NULL },
+        [GRP_TRIAL]   = { "trial", TRIAL_RATE_HZ,   1,   6,    STACK_SIZE, trial_step,          NULL },
+        [GRP_UI]      = { "ui",    UI_RATE_HZ,      1,   4,    4096,       ui_step,             NULL },
+    };
+    rtstats_register(&st_field,   "ff_eval",   RTSTATS_CYCLES);
+    rtstats_register(&st_pid,     "pid_step",  RTSTATS_CYCLES);
+    rtstats_register(&st_track,   "track",     RTSTATS_CYCLES);
+    rtstats_register(&st_apply,   "apply_pwm", RTSTATS_CYCLES);
+    rtstats_register(&st_dac,     "dac_post",  RTSTATS_CYCLES);
+    ESP_RETURN_ON_ERROR(rtexec_init(rt_groups, GRP_COUNT), TAG, "rtexec");
+    pid_init(kp, ki, kd, 0, 0, rtexec_dt(GRP_CONTROL), PID_DEADZONE_CNT);
+    track_init(kp, ki, kd, HOME_KFF, rtexec_dt(GRP_CONTROL));
+    return ESP_OK;
+}
+
+static esp_err_t task_run(void)
+{
+    return rtexec_start();
+}
+
+static void task_teardown(void)
+{
+    rtexec_stop();
+    apply_control_mcpwm(0);
+    tone_stop();
+    gpio_set_level(GPIO_REWARD_SIGNAL, 0);
+}
+
+const app_mode_t mode_task = {
+    .name     = "task",
+    .help     = "behavioural task (PARADIGM selects the table)",
+    .init     = task_init,
+    .run      = task_run,
+    .teardown = task_teardown,
+};
@@ -0,0 +1,80 @@
+// main/rig.c
+#include "rig.h"
+#include <stdio.h>
+#include <strings.h>
+#include "encoder.h"
+#include "encoder_out.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "friction.h"
+#include "motor_init.h"
+#include "motorctrl.h"
+#include "rtexec.h"
+#include "serial_cmd.h"
+
+static const char *TAG = "RIG";
+
+// FRICTION [ID|CLEAR]: show, re-identify (pauses the session ~15 s) or forget
+static void cmd_friction(const char *args)
+{
+    friction_params_t p;
+    if (strcasecmp(args, "ID") == 0) {
+        // the sweep needs the motor to itself: no identification unless the
+        // control loop is known to be stopped
+        esp_err_t err = rtexec_stop();
+        if (err != ESP_OK) {
+            printf("friction identification: control loop not stopped: %s\n", esp_err_to_name(err));
+            return;
+        }
+        vTaskDelay(pdMS_TO_TICKS(5));   // let a step in flight finish
+        err = friction_identify(&p);
+        if (err == ESP_OK) err = friction_set(&p, true);
+        pid_clear_state();
+        printf("friction identification: %s\n", esp_err_to_name(err));
+        err = rtexec_start();
+        if (err != ESP_OK) printf("control loop not restarted: %s\n", esp_err_to_name(err));
+    } else if (strcasecmp(args, "CLEAR") == 0) {
+        printf("friction clear: %s\n", esp_err_to_name(friction_clear()));
+    }
+    if (friction_get(&p)) {
+        printf("breakaway +%.2f/-%.2f %%  coulomb +%.2f/-%.2f %%\n",
+               p.breakaway_pos, p.breakaway_neg, p.coulomb_pos, p.coulomb_neg);
+    } else {
+        printf("friction compensation off\n");
+    }
+}
+
+esp_err_t rig_init(uint32_t encoder_rate_hz)
+{
+    // encoder + DAC
+    init_encoder();
+    encoder_limits_t enc_limits;
+    ESP_RETURN_ON_ERROR(encoder_limits(encoder_rate_hz, &enc_limits), TAG, "encoder limits");
+#if CONFIG_ENCODER_TEST_GPIO_A >= 0 && CONFIG_ENCODER_TEST_GPIO_B >= 0
+    // a failed or slow test only warns: the encoder itself is set up
+    encoder_speed_t enc_speed;
+    esp_err_t err = encoder_speed_test(CONFIG_ENCODER_TEST_GPIO_A, CONFIG_ENCODER_TEST_GPIO_B, &enc_speed);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "encoder speed test not run: %s", esp_err_to_name(err));
+    } else if (enc_speed.passed_cps < enc_limits.max_cps) {
+        ESP_LOGW(TAG, "encoder counts exactly only up to %lu counts/s, below the computed %lu",
+                 (unsigned long)enc_speed.passed_cps, (unsigned long)enc_limits.max_cps);
+    }
+#else
+    ESP_LOGI(TAG, "encoder speed not tested (ENCODER_TEST_GPIO_A/B unset)");
+#endif
+    ESP_RETURN_ON_ERROR(encoder_out_init(), TAG, "encoder DAC");
+
+    // motor
+    init_mcpwm_highres();
+    apply_control_mcpwm(0);
+
+    // friction feedforward: identified once per rig on request (the sweep
+    // drives the lever for ~15 s, so never at boot), then reused from NVS
+    if (friction_init() == ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "no friction parameters stored, compensation off: run FRICTION ID with the lever clear");
+    }
+    return serial_cmd_register("FRICTION", cmd_friction, "[ID|CLEAR] friction feedforward");
+}
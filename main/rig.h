@@ -0,0 +1,27 @@
+// main/rig.h
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bring-up of the in-house lever rig shared by the modes that drive it:
+ * PCNT encoder (speed-tested if ENCODER_TEST_GPIO_A/B are set), MCP4725
+ * position DAC, MCPWM motor driver and the friction feedforward (identified once per rig by FRICTION ID, then
+ * loaded from NVS; off until then).
+ * Also registers the FRICTION serial command.
+ */
+
+/**
+ * @brief  Initialize the rig, motor stopped. @p encoder_rate_hz is the rate
+ *         the input stage will read the encoder at (for its computed limits).
+ */
+esp_err_t rig_init(uint32_t encoder_rate_hz);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,285 @@
+// main/rtexec.c
+//
+// The frame ISR does nothing but count frames down per group and release the
+// groups that are due. A group still running from its previous release is
+// not released again; the skipped release is counted as an overrun. The group
+// tasks time themselves and flag a deadline miss when a step finishes later
+// than one period after its release.
+#include "rtexec.h"
+#include "encoder.h"
+#include "rtstats.h"
+#include "driver/gptimer.h"
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include <stdio.h>
+
+#if configTASK_NOTIFICATION_ARRAY_ENTRIES <= RTEXEC_NOTIFY_INDEX
+#error "rtexec needs CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES >= 2 (slot 0 stays free for the groups' own use)"
+#endif
+
+static const char *TAG = "RTEXEC";
+
+#define RTEXEC_TIMER_RES_HZ   1000000   // 1 µs per timer tick
+#define RTEXEC_FRAME_US       (RTEXEC_TIMER_RES_HZ / RTEXEC_BASE_RATE_HZ)
+
+typedef struct {
+    rtexec_group_t    cfg;
+    uint32_t          divisor;          // frames per release
+    uint32_t          period_us;
+    TaskHandle_t      task;
+
+    // shared with the frame ISR
+    uint32_t          countdown;        // ISR only
+    volatile bool     pending;          // released and not yet finished
+    volatile int64_t  release_us;
+    volatile uint32_t overruns;
+
+    // written by the group task under s_stats_lock
+    rtexec_stats_t    st;
+
+    // histograms, written by the group task only (dumped via rtstats)
+    rtstats_t         h_wake;           // release → start, µs
+    rtstats_t         h_jitter;         // |start-to-start interval − period|, µs
+    rtstats_t         h_exec;           // step, CPU cycles
+    char              h_names[3][20];
+} rt_group_t;
+
+static rt_group_t        s_grp[RTEXEC_MAX_GROUPS];
+static int               s_n        = 0;
+static int               s_monitor  = 0;    // slowest group; reports problems once a second
+static gptimer_handle_t  s_timer    = NULL;
+static float             s_input_dt = 0.0f;
+static float             s_alpha    = 1.0f;
+static portMUX_TYPE      s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool IRAM_ATTR frame_isr(gptimer_handle_t timer,
+                                const gptimer_alarm_event_data_t *edata,
+                                void *user_ctx)
+{
+    BaseType_t hp_task_woken = pdFALSE;
+    int64_t    now           = esp_timer_get_time();
+
+    for (int i = 0; i < s_n; i++) {
+        rt_group_t *g = &s_grp[i];
+        if (--g->countdown != 0) continue;
+        g->countdown = g->divisor;
+
+        if (g->pending) {
+            g->overruns++;
+            continue;
+        }
+        g->pending    = true;
+        g->release_us = now;
+        vTaskNotifyGiveIndexedFromISR(g->task, RTEXEC_NOTIFY_INDEX, &hp_task_woken);
+    }
+    return hp_task_woken == pdTRUE;
+}
+
+void rtexec_encoder_step(const kin_sample_t *prev, void *ctx)
+{
+    kin_sample_t k;
+
+    k.t_us  = esp_timer_get_time();
+    k.pos   = encoder_sample();
+    k.vel   = s_alpha * ((float)(k.pos - prev->pos) / s_input_dt) + (1.0f - s_alpha) * prev->vel;
+    k.index = prev->index + 1;
+    kinbus_publish(&k);
+}
+
+// Once a second from the slowest group: log any group that overran or
+// missed a deadline since the last report.
+static void monitor(void)
+{
+    static uint32_t reported[RTEXEC_MAX_GROUPS];
+
+    for (int i = 0; i < s_n; i++) {
+        rtexec_stats_t st;
+        rtexec_get_stats(i, &st);
+        uint32_t bad = st.overruns + st.deadline_misses;
+        if (bad != reported[i]) {
+            ESP_LOGW(TAG, "%s: %lu overrun(s), %lu deadline miss(es), max exec %lu us, max start %lu us",
+                     st.name, (unsigned long)st.overruns, (unsigned long)st.deadline_misses,
+                     (unsigned long)st.max_exec_us, (unsigned long)st.max_start_us);
+            reported[i] = bad;
+        }
+    }
+}
+
+static void group_task(void *pv)
+{
+    rt_group_t  *g          = pv;
+    const int    idx        = g - s_grp;
+    int64_t      last_start = 0;
+    kin_sample_t kin;
+
+    while (1) {
+        ulTaskNotifyTakeIndexed(RTEXEC_NOTIFY_INDEX, pdTRUE, portMAX_DELAY);
+
+        int64_t  start = esp_timer_get_time();
+        uint32_t c0    = esp_cpu_get_cycle_count();
+        kinbus_read(&kin);
+        g->cfg.fn(&kin, g->cfg.ctx);
+        uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+        int64_t  end    = esp_timer_get_time();
+
+        rtstats_record(&g->h_exec, cycles);
+        rtstats_record(&g->h_wake, (uint32_t)(start - g->release_us));
+        if (last_start != 0) {
+            int64_t dev = (start - last_start) - (int64_t)g->period_us;
+            rtstats_record(&g->h_jitter, (uint32_t)(dev < 0 ? -dev : dev));
+        }
+        last_start = start;
+
+        uint32_t exec_us  = (uint32_t)(end - start);
+        uint32_t start_us = (uint32_t)(start - g->release_us);
+        uint32_t lat_us   = (idx == 0) ? exec_us : (uint32_t)(end - kin.t_us);
+        bool     late     = end - g->release_us > (int64_t)g->period_us;
+
+        portENTER_CRITICAL(&s_stats_lock);
+        g->st.releases++;
+        if (late) g->st.deadline_misses++;
+        g->st.last_exec_us    = exec_us;
+        g->st.last_latency_us = lat_us;
+        if (exec_us  > g->st.max_exec_us)    g->st.max_exec_us    = exec_us;
+        if (start_us > g->st.max_start_us)   g->st.max_start_us   = start_us;
+        if (lat_us   > g->st.max_latency_us) g->st.max_latency_us = lat_us;
+        portEXIT_CRITICAL(&s_stats_lock);
+
+        g->pending = false;
+
+        if (idx == s_monitor && g->st.releases % g->st.rate_hz == 0) {
+            monitor();
+        }
+    }
+}
+
+esp_err_t rtexec_init(const rtexec_group_t *groups, int n)
+{
+    ESP_RETURN_ON_FALSE(groups != NULL && n > 0 && n <= RTEXEC_MAX_GROUPS,
+                        ESP_ERR_INVALID_ARG, TAG, "need 1…%d groups", RTEXEC_MAX_GROUPS);
+    ESP_RETURN_ON_FALSE(s_timer == NULL, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+
+    for (int i = 0; i < n; i++) {
+        const rtexec_group_t *c = &groups[i];
+        ESP_RETURN_ON_FALSE(c->fn != NULL, ESP_ERR_INVALID_ARG, TAG, "group %d: no step", i);
+        ESP_RETURN_ON_FALSE(c->rate_hz > 0 && c->rate_hz <= RTEXEC_BASE_RATE_HZ, ESP_ERR_INVALID_ARG,
+                            TAG, "%s: rate %lu Hz out of range", c->name, (unsigned long)c->rate_hz);
+        ESP_RETURN_ON_FALSE(c->core >= 0 && c->core < portNUM_PROCESSORS, ESP_ERR_INVALID_ARG,
+                            TAG, "%s: bad core %d", c->name, c->core);
+
+        rt_group_t *g = &s_grp[i];
+        g->cfg        = *c;
+        g->divisor    = (RTEXEC_BASE_RATE_HZ + c->rate_hz / 2) / c->rate_hz;
+        g->period_us  = g->divisor * RTEXEC_FRAME_US;
+        g->countdown  = 1;              // every group is released on the first frame
+        g->pending    = false;
+        g->st         = (rtexec_stats_t){
+            .name    = c->name,
+            .rate_hz = RTEXEC_BASE_RATE_HZ / g->divisor,
+            .core    = c->core,
+        };
+        if (g->divisor > s_grp[s_monitor].divisor) s_monitor = i;
+
+        snprintf(g->h_names[0], sizeof(g->h_names[0]), "%s.wake",   c->name);
+        snprintf(g->h_names[1], sizeof(g->h_names[1]), "%s.jitter", c->name);
+        snprintf(g->h_names[2], sizeof(g->h_names[2]), "%s.exec",   c->name);
+        rtstats_register(&g->h_wake,   g->h_names[0], RTSTATS_US);
+        rtstats_register(&g->h_jitter, g->h_names[1], RTSTATS_US);
+        rtstats_register(&g->h_exec,   g->h_names[2], RTSTATS_CYCLES);
+    }
+    s_n = n;
+
+    // input stage filter, seeded with the current count so the first
+    // velocity is not a step from zero
+    s_input_dt = (float)s_grp[0].period_us * 1e-6f;
+    s_alpha    = s_input_dt / (RTEXEC_VEL_TAU_S + s_input_dt);
+    kinbus_init();
+    kin_sample_t seed = { .pos = encoder_sample(), .t_us = esp_timer_get_time() };
+    kinbus_publish(&seed);
+
+    for (int i = 0; i < n; i++) {
+        rt_group_t *g = &s_grp[i];
+        BaseType_t ok = xTaskCreatePinnedToCore(group_task, g->cfg.name, g->cfg.stack, g,
+                                                g->cfg.prio, &g->task, g->cfg.core);
+        ESP_RETURN_ON_FALSE(ok == pdPASS, ESP_ERR_NO_MEM, TAG, "%s: task create failed", g->cfg.name);
+    }
+
+    gptimer_config_t timer_cfg = {
+        .clk_src       = GPTIMER_CLK_SRC_DEFAULT,
+        .direction     = GPTIMER_COUNT_UP,
+        .resolution_hz = RTEXEC_TIMER_RES_HZ,
+    };
+    ESP_RETURN_ON_ERROR(gptimer_new_timer(&timer_cfg, &s_timer), TAG, "gptimer_new_timer failed");
+
+    gptimer_event_callbacks_t cbs = {
+        .on_alarm = frame_isr,
+    };
+    ESP_RETURN_ON_ERROR(gptimer_register_event_callbacks(s_timer, &cbs, NULL),
+                        TAG, "gptimer callback registration failed");
+
+    gptimer_alarm_config_t alarm_cfg = {
+        .alarm_count  = RTEXEC_FRAME_US,
+        .reload_count = 0,
+        .flags = { .auto_reload_on_alarm = true },
+    };
+    ESP_RETURN_ON_ERROR(gptimer_set_alarm_action(s_timer, &alarm_cfg), TAG, "gptimer alarm failed");
+    ESP_RETURN_ON_ERROR(gptimer_enable(s_timer), TAG, "gptimer_enable failed");
+
+    for (int i = 0; i < n; i++) {
+        ESP_LOGI(TAG, "group %-6s %4lu Hz (every %lu frames) core %d prio %u",
+                 s_grp[i].cfg.name, (unsigned long)s_grp[i].st.rate_hz,
+                 (unsigned long)s_grp[i].divisor, s_grp[i].cfg.core, (unsigned)s_grp[i].cfg.prio);
+    }
+    return ESP_OK;
+}
+
+esp_err_t rtexec_start(void)
+{
+    ESP_RETURN_ON_FALSE(s_timer != NULL, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    return gptimer_start(s_timer);
+}
+
+esp_err_t rtexec_stop(void)
+{
+    ESP_RETURN_ON_FALSE(s_timer != NULL, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    return gptimer_stop(s_timer);
+}
+
+float rtexec_dt(int group)
+{
+    if (group < 0 || group >= s_n) return 0.0f;
+    return (float)s_grp[group].period_us * 1e-6f;
+}
+
+esp_err_t rtexec_get_stats(int group, rtexec_stats_t *out)
+{
+    ESP_RETURN_ON_FALSE(group >= 0 && group < s_n && out != NULL, ESP_ERR_INVALID_ARG,
+                        TAG, "bad group %d", group);
+    portENTER_CRITICAL(&s_stats_lock);
+    *out = s_grp[group].st;
+    portEXIT_CRITICAL(&s_stats_lock);
+    out->overruns = s_grp[group].overruns;
+    return ESP_OK;
+}
+
+int rtexec_group_count(void)
+{
+    return s_n;
+}
+
+void rtexec_dump(void)
+{
+    printf("%-8s %6s %4s %10s %8s %8s %9s %9s\n",
+           "group", "Hz", "core", "releases", "overrun", "missed", "lat(us)", "maxlat");
+    for (int i = 0; i < s_n; i++) {
+        rtexec_stats_t st;
+        rtexec_get_stats(i, &st);
+        printf("%-8s %6lu %4d %10lu %8lu %8lu %9lu %9lu\n",
+               st.name, (unsigned long)st.rate_hz, st.core, (unsigned long)st.releases,
+               (unsigned long)st.overruns, (unsigned long)st.deadline_misses,
+               (unsigned long)st.last_latency_us, (unsigned long)st.max_latency_us);
+    }
+}
@@ -0,0 +1,99 @@
+// main/rtexec.h
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "kinbus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Cyclic executive. One gptimer ticks the minor frame at RTEXEC_BASE_RATE_HZ;
+ * every declared rate group is released on every Nth frame (N = base / rate)
+ * and runs to completion in its own task, pinned to the core the table says.
+ * Groups released on the same frame run in priority order, so the input
+ * stage always publishes before the control group reads, and the
+ * input-to-actuation latency is one bounded chain instead of emergent.
+ *
+ * Group 0 must be the input stage (rtexec_encoder_step). Every other group
+ * gets the latest kinbus sample at the moment it starts.
+ */
+
+#define RTEXEC_BASE_RATE_HZ    5000     // minor frame, 200 µs
+#define RTEXEC_MAX_GROUPS      6
+#define RTEXEC_NOTIFY_INDEX    1        // task-notification slot used for releases
+#define RTEXEC_VEL_TAU_S       0.02f    // velocity low-pass published on the kinbus
+
+/**
+ * @brief  Rate-group step, run once per release.
+ * @param  kin  Latest kinbus sample when the step started (for group 0, the
+ *              previous sample)
+ * @param  ctx  From the group table
+ */
+typedef void (*rtexec_fn_t)(const kin_sample_t *kin, void *ctx);
+
+typedef struct {
+    const char  *name;
+    uint32_t     rate_hz;   // rounded to a divisor of RTEXEC_BASE_RATE_HZ
+    int          core;
+    UBaseType_t  prio;      // rate-monotonic: faster groups higher
+    uint32_t     stack;
+    rtexec_fn_t  fn;
+    void        *ctx;
+} rtexec_group_t;
+
+typedef struct {
+    const char *name;
+    uint32_t    rate_hz;          // base / divisor (nominal release rate)
+    int         core;
+    uint32_t    releases;         // steps completed
+    uint32_t    overruns;         // releases dropped: previous step still running
+    uint32_t    deadline_misses;  // steps that finished after their period elapsed
+    uint32_t    last_exec_us;
+    uint32_t    max_exec_us;
+    uint32_t    max_start_us;     // release → step start (dispatch delay)
+    uint32_t    last_latency_us;  // kin sample → step end (input to actuation)
+    uint32_t    max_latency_us;
+} rtexec_stats_t;
+
+/**
+ * @brief  Built-in input stage: read the encoder, filter velocity and publish
+ *         the sample on the kinbus. Declare it as group 0.
+ */
+void rtexec_encoder_step(const kin_sample_t *prev, void *ctx);
+
+/**
+ * @brief  Create one task per group and the frame timer (not started).
+ * @param  groups  Table of rate groups; copied, group 0 is the input stage
+ * @param  n       1…RTEXEC_MAX_GROUPS
+ */
+esp_err_t rtexec_init(const rtexec_group_t *groups, int n);
+
+esp_err_t rtexec_start(void);
+esp_err_t rtexec_stop(void);
+
+/**
+ * @brief  Release period of a group in seconds (for controller dt).
+ */
+float rtexec_dt(int group);
+
+/**
+ * @brief  Copy out a group's counters (safe from any task).
+ */
+esp_err_t rtexec_get_stats(int group, rtexec_stats_t *out);
+
+int rtexec_group_count(void);
+
+/**
+ * @brief  Print the per-group counters to stdout (serial command task only).
+ *         Timing histograms are registered with rtstats as
+ *         "<group>.wake", "<group>.jitter" and "<group>.exec".
+ */
+void rtexec_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,89 @@
+// main/rtstats.c
+#include "rtstats.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_rom_sys.h"
+
+static rtstats_t *s_reg[RTSTATS_MAX];
+static int        s_nreg;
+
+// smallest value that lands in bucket b
+static uint64_t bucket_low(uint32_t b)
+{
+    if (b < RTSTATS_SUB) return b;
+    uint32_t oct = b / RTSTATS_SUB;
+    uint32_t sub = b % RTSTATS_SUB;
+    return (uint64_t)(RTSTATS_SUB + sub) << (oct - 1);
+}
+
+void rtstats_register(rtstats_t *s, const char *name, rtstats_unit_t unit)
+{
+    memset(s, 0, sizeof(*s));
+    s->name = name;
+    s->unit = unit;
+    if (s_nreg < RTSTATS_MAX) s_reg[s_nreg++] = s;
+}
+
+// value at quantile q, reported as the top of its bucket (never optimistic)
+static uint32_t quantile(const rtstats_t *s, uint32_t count, float q)
+{
+    uint64_t need = (uint64_t)(q * count + 0.999f);
+    uint64_t seen = 0;
+    if (need == 0) need = 1;
+    for (uint32_t b = 0; b < RTSTATS_BUCKETS; b++) {
+        seen += s->hist[b];
+        if (seen >= need) {
+            uint64_t top = (b + 1 < RTSTATS_BUCKETS) ? bucket_low(b + 1) - 1 : s->max;
+            return top > s->max ? s->max : (uint32_t)top;
+        }
+    }
+    return s->max;
+}
+
+void rtstats_summarize(const rtstats_t *s, rtstats_summary_t *out)
+{
+    float    scale = (s->unit == RTSTATS_CYCLES) ? 1.0f / esp_rom_get_cpu_ticks_per_us() : 1.0f;
+    uint32_t count = s->count;
+
+    memset(out, 0, sizeof(*out));
+    if (count == 0) return;
+    out->count   = count;
+    out->min_us  = s->min * scale;
+    out->max_us  = s->max * scale;
+    out->mean_us = (float)((double)s->sum / count) * scale;
+    out->p50_us  = quantile(s, count, 0.50f) * scale;
+    out->p99_us  = quantile(s, count, 0.99f) * scale;
+}
+
+void rtstats_reset_all(void)
+{
+    for (int i = 0; i < s_nreg; i++) {
+        rtstats_t *s = s_reg[i];
+        s->count = 0;
+        s->min   = 0;
+        s->max   = 0;
+        s->sum   = 0;
+        memset(s->hist, 0, sizeof(s->hist));
+    }
+}
+
+void rtstats_dump(bool hist)
+{
+    printf("%-16s %10s %9s %9s %9s %9s %9s  (us)\n",
+           "stat", "count", "min", "mean", "p50", "p99", "max");
+    for (int i = 0; i < s_nreg; i++) {
+        const rtstats_t  *s = s_reg[i];
+        rtstats_summary_t sum;
+        rtstats_summarize(s, &sum);
+        printf("%-16s %10lu %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+               s->name, (unsigned long)sum.count, sum.min_us, sum.mean_us,
+               sum.p50_us, sum.p99_us, sum.max_us);
+
+        if (!hist || sum.count == 0) continue;
+        float scale = (s->unit == RTSTATS_CYCLES) ? 1.0f / esp_rom_get_cpu_ticks_per_us() : 1.0f;
+        for (uint32_t b = 0; b < RTSTATS_BUCKETS; b++) {
+            if (s->hist[b] == 0) continue;
+            printf("    >= %10.2f  %lu\n", bucket_low(b) * scale, (unsigned long)s->hist[b]);
+        }
+    }
+}
@@ -0,0 +1,103 @@
+// main/rtstats.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_cpu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Always-on timing histograms.
+ *
+ * Each rtstats_t has exactly one writer (the task that owns the measured
+ * stage), so recording is a handful of integer ops with no locks. Buckets are
+ * log-linear: exact below 8, then 8 sub-buckets per power of two (~12 %
+ * resolution), which covers a 10 ns step and a 100 ms stall in one table.
+ * Readers (the dump) take an unsynchronised snapshot; counts may be off by
+ * the one sample in flight.
+ */
+
+#define RTSTATS_SUB_BITS    3
+#define RTSTATS_SUB         (1u << RTSTATS_SUB_BITS)
+#define RTSTATS_BUCKETS     (RTSTATS_SUB * (32 - RTSTATS_SUB_BITS + 1))
+#define RTSTATS_MAX         24      // registered histograms
+
+typedef enum {
+    RTSTATS_CYCLES = 0,     // esp_cpu_get_cycle_count() deltas (same core only)
+    RTSTATS_US,             // esp_timer_get_time() deltas
+} rtstats_unit_t;
+
+typedef struct {
+    const char     *name;
+    rtstats_unit_t  unit;
+    uint32_t        count;
+    uint32_t        min;
+    uint32_t        max;
+    uint64_t        sum;
+    uint32_t        hist[RTSTATS_BUCKETS];
+} rtstats_t;
+
+typedef struct {
+    uint32_t count;
+    float    min_us;
+    float    mean_us;
+    float    p50_us;
+    float    p99_us;
+    float    max_us;
+} rtstats_summary_t;
+
+/**
+ * @brief  Clear a histogram and add it to the dump list.
+ */
+void rtstats_register(rtstats_t *s, const char *name, rtstats_unit_t unit);
+
+static inline uint32_t rtstats_bucket(uint32_t v)
+{
+    if (v < RTSTATS_SUB) return v;
+    uint32_t msb = 31 - __builtin_clz(v);
+    return (msb - RTSTATS_SUB_BITS + 1) * RTSTATS_SUB + ((v >> (msb - RTSTATS_SUB_BITS)) & (RTSTATS_SUB - 1));
+}
+
+/**
+ * @brief  Add one sample (in the histogram's unit). Owner task only.
+ */
+static inline void rtstats_record(rtstats_t *s, uint32_t v)
+{
+    s->hist[rtstats_bucket(v)]++;
+    s->sum += v;
+    if (s->count == 0 || v < s->min) s->min = v;
+    if (v > s->max) s->max = v;
+    s->count++;
+}
+
+// Time one statement in CPU cycles into an RTSTATS_CYCLES histogram.
+#define RTSTATS_TIME(stat, stmt)                                        \
+    do {                                                                \
+        uint32_t _rts_t0 = esp_cpu_get_cycle_count();                   \
+        stmt;                                                           \
+        rtstats_record((stat), esp_cpu_get_cycle_count() - _rts_t0);    \
+    } while (0)
+
+/**
+ * @brief  min/mean/p50/p99/max of one histogram, converted to µs.
+ */
+void rtstats_summarize(const rtstats_t *s, rtstats_summary_t *out);
+
+/**
+ * @brief  Zero every registered histogram (their owners keep recording).
+ */
+void rtstats_reset_all(void);
+
+/**
+ * @brief  Print a summary line per registered histogram to stdout; with
+ *         @p hist also the non-empty buckets. For the serial command task,
+ *         never from a real-time group.
+ */
+void rtstats_dump(bool hist);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,106 @@
+// main/serial_cmd.c
+//
+// Line-oriented commands from the host on the console UART. Runs at low
+// priority on core 1, so a long dump can never hold up a rate group.
+#include "serial_cmd.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "driver/uart.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "CMD";
+
+#define SERIAL_CMD_UART     CONFIG_ESP_CONSOLE_UART_NUM
+
+typedef struct {
+    const char      *name;
+    serial_cmd_fn_t  fn;
+    const char      *help;
+} serial_cmd_t;
+
+static serial_cmd_t    s_cmds[SERIAL_CMD_MAX];
+static int             s_ncmds;
+static serial_cmd_fn_t s_default;
+
+static void cmd_help(const char *args)
+{
+    for (int i = 0; i < s_ncmds; i++) {
+        printf("  %-10s %s\n", s_cmds[i].name, s_cmds[i].help ? s_cmds[i].help : "");
+    }
+}
+
+static void dispatch(char *line)
+{
+    while (isspace((unsigned char)*line)) line++;
+    if (*line == '\0') return;
+
+    char *args = line;
+    while (*args && !isspace((unsigned char)*args)) args++;
+    char *cut = args;
+    char  sep = *cut;
+    if (*args) *args++ = '\0';
+    while (isspace((unsigned char)*args)) args++;
+
+    for (int i = 0; i < s_ncmds; i++) {
+        if (strcasecmp(line, s_cmds[i].name) == 0) {
+            s_cmds[i].fn(args);
+            return;
+        }
+    }
+    if (s_default) {
+        *cut = sep;             // the whole line, as received
+        s_default(line);
+        return;
+    }
+    printf("unknown command '%s' (try HELP)\n", line);
+}
+
+static void serial_cmd_task(void *pv)
+{
+    char    line[SERIAL_CMD_LINE_MAX];
+    size_t  len = 0;
+    uint8_t c;
+
+    while (1) {
+        if (uart_read_bytes(SERIAL_CMD_UART, &c, 1, portMAX_DELAY) != 1) continue;
+
+        if (c == '\n' || c == '\r') {
+            line[len] = '\0';
+            dispatch(line);
+            len = 0;
+        } else if (len < sizeof(line) - 1) {
+            line[len++] = (char)c;
+        }
+    }
+}
+
+void serial_cmd_set_default(serial_cmd_fn_t fn)
+{
+    s_default = fn;
+}
+
+esp_err_t serial_cmd_register(const char *name, serial_cmd_fn_t fn, const char *help)
+{
+    ESP_RETURN_ON_FALSE(name != NULL && fn != NULL, ESP_ERR_INVALID_ARG, TAG, "bad command");
+    ESP_RETURN_ON_FALSE(s_ncmds < SERIAL_CMD_MAX, ESP_ERR_NO_MEM, TAG, "command table full");
+    s_cmds[s_ncmds++] = (serial_cmd_t){ name, fn, help };
+    return ESP_OK;
+}
+
+esp_err_t serial_cmd_init(void)
+{
+    ESP_RETURN_ON_FALSE(uart_is_driver_installed(SERIAL_CMD_UART), ESP_ERR_INVALID_STATE,
+                        TAG, "UART driver not installed (call telemetry_init first)");
+    ESP_RETURN_ON_ERROR(serial_cmd_register("HELP", cmd_help, "list commands"), TAG, "help");
+
+    BaseType_t ok = xTaskCreatePinnedToCore(serial_cmd_task, "cmd", 4096, NULL,
+                                            SERIAL_CMD_TASK_PRIO, NULL, SERIAL_CMD_TASK_CORE);
+    ESP_RETURN_ON_FALSE(ok == pdPASS, ESP_ERR_NO_MEM, TAG, "command task create failed");
+    return ESP_OK;
+}
@@ -0,0 +1,42 @@
+// main/serial_cmd.h
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SERIAL_CMD_MAX          16      // registered commands
+#define SERIAL_CMD_LINE_MAX     128
+#define SERIAL_CMD_TASK_PRIO    2
+#define SERIAL_CMD_TASK_CORE    1
+
+/**
+ * @brief  Command handler.
+ * @param  args  Rest of the line after the command word ("" if none)
+ */
+typedef void (*serial_cmd_fn_t)(const char *args);
+
+/**
+ * @brief  Add a command. Names match case-insensitively on the first word
+ *         of a line; output goes to stdout (text between telemetry frames).
+ */
+esp_err_t serial_cmd_register(const char *name, serial_cmd_fn_t fn, const char *help);
+
+/**
+ * @brief  Handler for lines that match no command; it gets the whole line
+ *         (for host tools with their own line formats). NULL restores the
+ *         "unknown command" reply.
+ */
+void serial_cmd_set_default(serial_cmd_fn_t fn);
+
+/**
+ * @brief  Start the line reader on the console UART. Call after
+ *         telemetry_init(), which installs the UART driver.
+ */
+esp_err_t serial_cmd_init(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,7 @@
 #pragma once
 #include "event.h"     // for event_state_t & event_send_state()
-#include "esp_err.h"   // for ESP_ERROR_CHECK()
+#include "esp_err.h"
+#include "telemetry.h" // TLM_STATE record on every transition
 
 // Map reward levels 0–3 → your CUE_x and REWARD_x codes
 static const event_state_t CUE_EVENT[4] = {
@@ -22,16 +23,34 @@ typedef enum {
 
 // Track the current state
 static sm_state_t _sm_current = S_INIT;
+static uint32_t   _sm_trial   = 0;
 
-/* Emit the state marker immediately (deterministic, no queue). */
+/* Trial number stamped on the TLM_STATE records. */
+static inline void sm_set_trial(uint32_t trial) {
+    _sm_trial = trial;
+}
+
+/* Emit the state marker immediately (deterministic, no queue). A marker the
+ * scheduler cannot take is dropped, counted and reported (event.h); the trial
+ * goes on, and TLM_STATE still records the transition. */
 static inline void sm_enter(sm_state_t next, event_state_t ev_code) {
     if (_sm_current == next) return;
-    ESP_ERROR_CHECK(event_send_state_immediate(ev_code));
+    (void)event_send_marker(ev_code, _sm_trial);
+    _sm_current = next;
+    telemetry_state(_sm_trial, (uint8_t)next, (uint8_t)ev_code);
+}
+
+/* Move and record ev_code on TLM_STATE, but leave the marker to the stimulus
+ * commit (stim.h), which sends it at the cue's onset with the sound and frame. */
+static inline void sm_enter_staged(sm_state_t next, event_state_t ev_code) {
+    if (_sm_current == next) return;
     _sm_current = next;
+    telemetry_state(_sm_trial, (uint8_t)next, (uint8_t)ev_code);
 }
 
 /* Move between SM states WITHOUT emitting (use when you already emitted). */
 static inline void sm_enter_no_emit(sm_state_t next) {
     if (_sm_current == next) return;
     _sm_current = next;
+    telemetry_state(_sm_trial, (uint8_t)next, 0xFF);
 }
@@ -0,0 +1,333 @@
+// main/stim.c
+//
+// One commit task on the UI core does everything after stim_commit(): the
+// trial task only fills a one-slot mailbox. The task holds the LVGL lock
+// from V0 to the end of the render only, so the UI group's lever redraw
+// keeps running while a commit waits for its frame. The vsync
+// interrupt keeps the last vsync time and a smoothed frame period, and
+// wakes the task only while it waits for one.
+#include "stim.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "graphics.h"
+#include "journal.h"
+#include "telemetry.h"
+
+static const char *TAG = "STIM";
+
+#define STIM_PERIOD_US      16667   // until the first vsyncs are measured
+#define STIM_NO_MARKER      0xFF
+
+_Static_assert(sizeof(tlm_stim_t) <= TELEMETRY_MAX_PAYLOAD, "tlm_stim_t too large");
+
+typedef struct {
+    void             (*apply)(int arg);
+    int                arg;
+    const audio_buf_t *buf;
+    uint8_t            marker;      // event_state_t or STIM_NO_MARKER
+    uint8_t            flags;       // STIM_F_VISUAL/AUDIO/MARKER
+    uint32_t           trial;
+} stim_job_t;
+
+static TaskHandle_t  s_task;
+static atomic_bool   s_waiting;     // task is blocked on a vsync
+static stim_job_t    s_stage;       // staging task only
+
+// under s_lock
+static portMUX_TYPE  s_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t       s_vsync_us;
+static int64_t       s_period_us = STIM_PERIOD_US;
+static stim_job_t    s_job;
+static bool          s_has_job;
+static bool          s_cancel;      // drop the job the task is running
+static void        (*s_post)(int arg);  // stim_post_visual(), runs before a waiting job
+static int           s_post_arg;
+static uint32_t      s_onset_trial;
+static int64_t       s_onset_us;
+static stim_stats_t  s_stats;
+
+static bool on_vsync(int64_t t_us, void *ctx)
+{
+    portENTER_CRITICAL_ISR(&s_lock);
+    int64_t d = t_us - s_vsync_us;
+    if (s_vsync_us && d > s_period_us / 2 && d < s_period_us * 3 / 2) {
+        s_period_us += (d - s_period_us) / 8;
+    }
+    s_vsync_us = t_us;
+    portEXIT_CRITICAL_ISR(&s_lock);
+
+    BaseType_t woken = pdFALSE;
+    if (atomic_load_explicit(&s_waiting, memory_order_relaxed)) vTaskNotifyGiveFromISR(s_task, &woken);
+    return woken == pdTRUE;
+}
+
+// First vsync later than @p after (the latest one if several passed), or 0
+// if none comes within STIM_VSYNC_WAIT_MS.
+static int64_t wait_vsync(int64_t after)
+{
+    int64_t deadline = esp_timer_get_time() + STIM_VSYNC_WAIT_MS * 1000;
+    int64_t v;
+    atomic_store(&s_waiting, true);
+    for (;;) {
+        portENTER_CRITICAL(&s_lock);
+        v = s_vsync_us;
+        portEXIT_CRITICAL(&s_lock);
+        if (v > after) break;
+        int64_t left = deadline - esp_timer_get_time();
+        if (left <= 0) {
+            v = 0;
+            break;
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(left / 1000) + 1);
+    }
+    atomic_store(&s_waiting, false);
+    return v;
+}
+
+static bool cancelled(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool c = s_cancel;
+    portEXIT_CRITICAL(&s_lock);
+    return c;
+}
+
+static void report_cancelled(const stim_job_t *j)
+{
+    tlm_stim_t r = { .trial = j->trial, .marker = j->marker, .flags = j->flags | STIM_F_CANCELLED };
+    portENTER_CRITICAL(&s_lock);
+    s_stats.cancelled++;
+    portEXIT_CRITICAL(&s_lock);
+    telemetry_stim(&r);
+}
+
+// Render a stim_post_visual() change if one is waiting: untimed, on the
+// task's own clock, no vsync and no record. False if there was none.
+static bool run_post(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    void (*post)(int) = s_post;
+    int  arg          = s_post_arg;
+    s_post            = NULL;
+    portEXIT_CRITICAL(&s_lock);
+    if (post == NULL) return false;
+    if (lvgl_lock(-1)) {
+        post(arg);
+        lv_refr_now(NULL);
+        lvgl_unlock();
+    }
+    return true;
+}
+
+// The marker's first rising edge, from the RMT interrupt; it reports only
+// once the whole marker is out (a cue pulse is 30-60 ms wide), so a hide
+// posted meanwhile is rendered while waiting.
+static int64_t marker_edge(const stim_job_t *j, int64_t sent)
+{
+    int64_t deadline = sent + event_marker_dur_us((event_state_t)j->marker) + STIM_EDGE_WAIT_MS * 1000;
+    do {
+        int64_t  t;
+        uint32_t trial;
+        if (event_last_edge((event_state_t)j->marker, &t, &trial) && trial == j->trial && t >= sent) {
+            return t;
+        }
+        if (!run_post()) vTaskDelay(1);
+    } while (esp_timer_get_time() < deadline);
+    return 0;
+}
+
+static void run(const stim_job_t *j)
+{
+    tlm_stim_t r = { .trial = j->trial, .marker = j->marker, .flags = j->flags };
+
+    int64_t v0 = wait_vsync(esp_timer_get_time());
+    if (cancelled()) {
+        report_cancelled(j);
+        return;
+    }
+    // a UI render still under way delays the lock; the onset check below
+    // flags the commit slipped if that costs the frame
+    if (j->apply && lvgl_lock(-1)) {
+        j->apply(j->arg);
+        lv_refr_now(NULL);
+        lvgl_unlock();
+    }
+    int64_t ready = esp_timer_get_time();
+
+    // onset: the first frame scanned out after the render (double-buffered:
+    // the flip it queued, or the one it already waited for)
+    int64_t v1;
+    int64_t flip;
+    portENTER_CRITICAL(&s_lock);
+    int64_t period = s_period_us;
+    portEXIT_CRITICAL(&s_lock);
+    if (v0 && lcd_last_flip(&flip, NULL) && flip > v0 && flip <= ready) {
+        v1 = flip;
+        if (v1 > v0 + period / 2 * 3) r.flags |= STIM_F_SLIPPED;
+    } else if (v0) {
+        v1 = v0 + period;
+        while (v1 <= ready) v1 += period;
+        if (v1 > v0 + period) r.flags |= STIM_F_SLIPPED;
+    } else {
+        r.flags |= STIM_F_NO_VSYNC;
+        v1 = ready + AUDIO_LATENCY_US;
+    }
+    int64_t t_audio = j->buf ? audio_play_at(j->buf, v1) : 0;
+
+    // the marker leaves from the V1 wake-up, ahead of the trial group
+    vTaskPrioritySet(NULL, STIM_RELEASE_PRIO);
+    int64_t t_ref = 0;
+    if (v0) t_ref = wait_vsync(v1 - period / 2);
+    if (t_ref == 0) {
+        int64_t left = v1 - esp_timer_get_time();
+        if (left > 0) vTaskDelay(pdMS_TO_TICKS(left / 1000));
+        t_ref = esp_timer_get_time();
+        r.flags |= STIM_F_NO_VSYNC;
+    }
+    // Rendered and the sound scheduled: a cancel from here on cannot take
+    // them back, so the commit is released and the marker still goes out.
+    if (cancelled()) r.flags |= STIM_F_CUT_SHORT;
+    if (j->marker != STIM_NO_MARKER) (void)event_send_marker((event_state_t)j->marker, j->trial);
+    vTaskPrioritySet(NULL, STIM_TASK_PRIO);
+
+    portENTER_CRITICAL(&s_lock);
+    s_onset_trial = j->trial;
+    s_onset_us    = t_ref;
+    portEXIT_CRITICAL(&s_lock);
+    if (j->apply) journal_post(t_ref, JR_VISUAL, r.flags, (uint16_t)j->trial);
+
+    if (j->marker != STIM_NO_MARKER) {
+        int64_t edge = marker_edge(j, t_ref);
+        if (edge) r.marker_us = (int32_t)(edge - t_ref);
+        else      r.flags |= STIM_F_NO_EDGE;
+    }
+    r.t_us     = (uint32_t)t_ref;
+    r.audio_us = t_audio ? (int32_t)(t_audio - t_ref) : 0;
+    r.ready_us = (int32_t)(ready - t_ref);
+    telemetry_stim(&r);
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.commits++;
+    if (r.flags & STIM_F_SLIPPED)  s_stats.slipped++;
+    if (r.flags & STIM_F_NO_VSYNC) s_stats.no_vsync++;
+    if (r.flags & STIM_F_CUT_SHORT) s_stats.cut_short++;
+    if ((uint32_t)abs(r.audio_us)  > s_stats.max_audio_us)  s_stats.max_audio_us  = (uint32_t)abs(r.audio_us);
+    if ((uint32_t)abs(r.marker_us) > s_stats.max_marker_us) s_stats.max_marker_us = (uint32_t)abs(r.marker_us);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void stim_task(void *pv)
+{
+    for (;;) {
+        if (run_post()) continue;       // a post goes before a waiting commit
+        stim_job_t j;
+        portENTER_CRITICAL(&s_lock);
+        bool have = s_has_job;
+        if (have) {
+            j         = s_job;
+            s_has_job = false;
+            s_cancel  = false;
+        }
+        portEXIT_CRITICAL(&s_lock);
+        if (have) run(&j);
+        else      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+esp_err_t stim_init(void)
+{
+    ESP_RETURN_ON_FALSE(s_task == NULL, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+    ESP_RETURN_ON_FALSE(lv_display_get_default() != NULL, ESP_ERR_INVALID_STATE, TAG, "no display");
+    s_stage.marker = STIM_NO_MARKER;
+    BaseType_t ok = xTaskCreatePinnedToCore(stim_task, "stim", STIM_TASK_STACK, NULL,
+                                            STIM_TASK_PRIO, &s_task, STIM_TASK_CORE);
+    ESP_RETURN_ON_FALSE(ok == pdPASS, ESP_ERR_NO_MEM, TAG, "stim task create failed");
+    lcd_set_vsync_cb(on_vsync, NULL);
+    return ESP_OK;
+}
+
+bool stim_ready(void)
+{
+    return s_task != NULL;
+}
+
+void stim_stage_visual(void (*apply)(int arg), int arg)
+{
+    s_stage.apply  = apply;
+    s_stage.arg    = arg;
+    s_stage.flags |= STIM_F_VISUAL;
+}
+
+void stim_stage_audio(const audio_buf_t *buf)
+{
+    s_stage.buf    = buf;
+    s_stage.flags |= STIM_F_AUDIO;
+}
+
+void stim_stage_marker(event_state_t st)
+{
+    s_stage.marker = (uint8_t)st;
+    s_stage.flags |= STIM_F_MARKER;
+}
+
+esp_err_t stim_commit(uint32_t trial)
+{
+    ESP_RETURN_ON_FALSE(s_task != NULL, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    stim_job_t j = s_stage;
+    j.trial = trial;
+    s_stage = (stim_job_t){ .marker = STIM_NO_MARKER };
+
+    stim_job_t old;
+    portENTER_CRITICAL(&s_lock);
+    bool replaced = s_has_job;
+    old       = s_job;
+    s_job     = j;
+    s_has_job = true;
+    portEXIT_CRITICAL(&s_lock);
+    if (replaced) report_cancelled(&old);
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+void stim_post_visual(void (*apply)(int arg), int arg)
+{
+    if (s_task == NULL) return;
+    portENTER_CRITICAL(&s_lock);
+    s_post     = apply;
+    s_post_arg = arg;
+    portEXIT_CRITICAL(&s_lock);
+    xTaskNotifyGive(s_task);
+}
+
+void stim_cancel(void)
+{
+    if (s_task == NULL) return;
+    stim_job_t old;
+    portENTER_CRITICAL(&s_lock);
+    bool dropped = s_has_job;
+    old       = s_job;
+    s_has_job = false;
+    s_cancel  = true;
+    portEXIT_CRITICAL(&s_lock);
+    if (dropped) report_cancelled(&old);
+}
+
+int64_t stim_onset(uint32_t trial)
+{
+    portENTER_CRITICAL(&s_lock);
+    int64_t t = (s_onset_trial == trial) ? s_onset_us : 0;
+    portEXIT_CRITICAL(&s_lock);
+    return t;
+}
+
+void stim_get_stats(stim_stats_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,121 @@
+// main/stim.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "audio.h"
+#include "esp_err.h"
+#include "event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Stimulus commit: a cue's visual change, sound and event marker are staged
+ * one by one, then released together on the display's frame clock.
+ *
+ * The time reference is the DPI panel's refresh-done interrupt (graphics.c,
+ * "vsync" here): the frame DMA has read the whole frame buffer and the next
+ * frame starts from the top. A commit
+ *   1. waits for a vsync V0;
+ *   2. takes the LVGL lock, applies the visual change and renders it into the
+ *      frame buffer at once (lv_refr_now; a stimfb.h frame is one DMA copy
+ *      and the overlay);
+ *   3. takes as onset V1 the first vsync after the render is done, and hands
+ *      the sound to the audio engine for V1 (sample-exact with
+ *      AUDIO_LATENCY_US of notice, which the rest of the frame leaves);
+ *   4. sends the marker when the V1 interrupt wakes it.
+ * A TLM_STIM record then gives V1 and each modality's measured offset from
+ * it (sound: the sample the engine scheduled; marker: its first rising edge
+ * from the RMT interrupt), and the journal gets a JR_VISUAL entry at V1.
+ *
+ * Single-buffered, the frame buffer is scanned while it is written, so rows
+ * the render got to ahead of the scan can show one frame early; V1 is the
+ * first frame that shows the whole change. Double-buffered
+ * (CONFIG_DISPLAY_DOUBLE_BUFFER) the render ends by queuing a flip for the
+ * next vsync, which is V1, and nothing shows before it. The panel adds its
+ * own fixed delay after vsync.
+ */
+
+#define STIM_TASK_PRIO      5       // renders below the trial group (6) ...
+#define STIM_RELEASE_PRIO   7       // ... and waits for V1 above it
+#define STIM_TASK_CORE      1
+#define STIM_TASK_STACK     4096
+#define STIM_VSYNC_WAIT_MS  50      // no vsync by then: display off, release on the task's clock
+#define STIM_EDGE_WAIT_MS   20      // past the marker's end, for its edge to come back from the RMT interrupt
+
+#define STIM_F_VISUAL       0x01    // staged parts
+#define STIM_F_AUDIO        0x02
+#define STIM_F_MARKER       0x04
+#define STIM_F_CUT_SHORT    0x08    // stim_cancel() after the render: released anyway
+#define STIM_F_SLIPPED      0x10    // the render missed the frame after V0
+#define STIM_F_NO_VSYNC     0x20    // no refresh interrupt: t_us is the task's own clock
+#define STIM_F_NO_EDGE      0x40    // the marker's edge did not come back (marker_us 0)
+#define STIM_F_CANCELLED    0x80    // stim_cancel() before the render: nothing went out
+
+typedef struct {
+    uint32_t commits;
+    uint32_t slipped;               // onset a frame (or more) after the one planned
+    uint32_t no_vsync;
+    uint32_t cancelled;
+    uint32_t cut_short;             // cancelled too late, released anyway
+    uint32_t max_audio_us;          // largest |sound onset - V1|
+    uint32_t max_marker_us;         // largest |marker edge - V1|
+} stim_stats_t;
+
+/**
+ * @brief  Start the commit task and take the panel's vsync (graphics.c).
+ *         Needs the display up; without it stim_ready() stays false and
+ *         callers release their stimuli directly.
+ */
+esp_err_t stim_init(void);
+
+/** @brief  True once stim_init() succeeded. */
+bool stim_ready(void);
+
+/**
+ * @brief  Stage the visual change: @p apply(@p arg) runs in the commit task
+ *         with the LVGL lock held, right before the render.
+ */
+void stim_stage_visual(void (*apply)(int arg), int arg);
+
+/** @brief  Stage a sound (an audio_render() or tone_buffer() buffer). */
+void stim_stage_audio(const audio_buf_t *buf);
+
+/** @brief  Stage the event marker; the commit's trial goes with it. */
+void stim_stage_marker(event_state_t st);
+
+/**
+ * @brief  Release what is staged, at the next frame the render can make.
+ *         Returns at once; a commit not yet started is replaced by a newer
+ *         one (and reported cancelled). Staging is from one task only.
+ */
+esp_err_t stim_commit(uint32_t trial);
+
+/**
+ * @brief  Run @p apply(@p arg) and render in the commit task as soon as it
+ *         is free, with no frame timing and no TLM_STIM record (hiding a
+ *         cue). Returns at once; a newer post replaces one not yet run, and
+ *         a pending post runs before a pending commit. Does nothing before
+ *         stim_init().
+ */
+void stim_post_visual(void (*apply)(int arg), int arg);
+
+/**
+ * @brief  Drop a commit that has not been rendered yet (the cue ended
+ *         first). Once the render is done the commit is released in full,
+ *         marker included, and reported STIM_F_CUT_SHORT.
+ */
+void stim_cancel(void);
+
+/**
+ * @brief  Onset (V1) of @p trial's last released commit, 0 if there is none.
+ */
+int64_t stim_onset(uint32_t trial);
+
+void stim_get_stats(stim_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
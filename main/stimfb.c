@@ -0,0 +1,93 @@
+// main/stimfb.c
+//
+// Frames are in the panel's pixel layout (RGB888 in LVGL's byte order, row
+// after row), cache-line aligned, and drawn as rectangle fills (gfx.h: on the
+// PPA, which leaves them in memory for the DMA that shows them).
+#include "stimfb.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "gfx.h"
+#include "graphics.h"
+
+static const char *TAG = "STIMFB";
+
+static uint8_t *s_frame[STIMFB_MAX_FRAMES];
+static int      s_nframes;
+static int      s_current = -1;
+static int      s_w, s_h;
+
+static esp_err_t alloc_frame(gfx_pic_t *pic)
+{
+    ESP_RETURN_ON_FALSE(s_w > 0, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    ESP_RETURN_ON_FALSE(s_nframes < STIMFB_MAX_FRAMES, ESP_ERR_NO_MEM, TAG, "frame table full");
+    *pic = (gfx_pic_t){ .buf_size = (size_t)s_w * s_h * 3, .w = s_w, .h = s_h };
+    pic->buf = heap_caps_aligned_alloc(GFX_ALIGN, pic->buf_size, MALLOC_CAP_SPIRAM);
+    ESP_RETURN_ON_FALSE(pic->buf != NULL, ESP_ERR_NO_MEM, TAG, "frame (%u bytes)", (unsigned)pic->buf_size);
+    return ESP_OK;
+}
+
+// Hand out a drawn frame's number, or free it if drawing failed
+static esp_err_t publish(const gfx_pic_t *pic, esp_err_t err, int *id)
+{
+    if (err != ESP_OK) {
+        heap_caps_free(pic->buf);
+        return err;
+    }
+    *id = s_nframes;
+    s_frame[s_nframes++] = pic->buf;
+    return ESP_OK;
+}
+
+esp_err_t stimfb_new_grating(int stripes, uint32_t fg, uint32_t bg, int *id)
+{
+    ESP_RETURN_ON_FALSE(stripes >= 1 && stripes <= s_w, ESP_ERR_INVALID_ARG, TAG, "%d stripes", stripes);
+    gfx_pic_t f;
+    ESP_RETURN_ON_ERROR(alloc_frame(&f), TAG, "grating");
+    // the background, then the even bars over it; the remainder of an
+    // uneven division stays background on the right
+    int sw = s_w / stripes;
+    esp_err_t err = gfx_fill(&f, 0, 0, s_w, s_h, bg);
+    for (int i = 0; i < stripes && err == ESP_OK; i += 2) err = gfx_fill(&f, i * sw, 0, sw, s_h, fg);
+    return publish(&f, err, id);
+}
+
+esp_err_t stimfb_new_solid(uint32_t rgb, int *id)
+{
+    gfx_pic_t f;
+    ESP_RETURN_ON_ERROR(alloc_frame(&f), TAG, "solid");
+    return publish(&f, gfx_fill(&f, 0, 0, s_w, s_h, rgb), id);
+}
+
+esp_err_t stimfb_show(int id)
+{
+    ESP_RETURN_ON_FALSE(id >= 0 && id < s_nframes, ESP_ERR_INVALID_ARG, TAG, "no frame %d", id);
+    if (!lvgl_lock(LCD_BLIT_TIMEOUT_MS)) return ESP_ERR_TIMEOUT;
+    lcd_set_underlay(s_frame[id]);
+    esp_err_t err = lcd_blit(0, 0, s_w, s_h, s_frame[id]);
+    if (err == ESP_OK) {
+        s_current = id;
+        // the copy went over the overlay too: redraw it
+        lcd_redraw_overlay();
+    }
+    lvgl_unlock();
+    ESP_RETURN_ON_ERROR(err, TAG, "frame %d", id);
+    return ESP_OK;
+}
+
+int stimfb_current(void)
+{
+    return s_current;
+}
+
+esp_err_t stimfb_init(void)
+{
+    ESP_RETURN_ON_FALSE(s_w == 0, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+    lv_display_t *disp = lv_display_get_default();
+    ESP_RETURN_ON_FALSE(disp != NULL, ESP_ERR_INVALID_STATE, TAG, "no display");
+    s_w = lv_display_get_horizontal_resolution(disp);
+    s_h = lv_display_get_vertical_resolution(disp);
+    int id;
+    ESP_RETURN_ON_ERROR(stimfb_new_solid(0x000000, &id), TAG, "blank frame");
+    return stimfb_show(STIMFB_BLANK);
+}
@@ -0,0 +1,59 @@
+// main/stimfb.h
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Stimulus layer: full-screen stimulus frames rendered once into PSRAM (PPA
+ * fills, gfx.h) and put on the panel by one DMA copy into its frame buffer
+ * (lcd_blit() in graphics.c), so showing or hiding a grating costs no render
+ * time in the trial. LVGL is left with the overlay (lever indicator, session stats): a
+ * screen whose background is LCD_KEY_COLOR shows the current stimulus frame
+ * through it, and only the overlay objects are redrawn after a change.
+ *
+ * Frame 0 is black and is shown by stimfb_init(). stimfb_show() holds the
+ * LVGL lock for the copy (a few ms) and redraws the overlay before it
+ * returns, so the two never show apart. Single-buffered the copy races the
+ * panel's scan, and the stimulus commit (stim.h) starts it right after a
+ * vsync; double-buffered (CONFIG_DISPLAY_DOUBLE_BUFFER) it goes to the back
+ * buffer and the whole frame appears at one flip.
+ */
+
+#define STIMFB_MAX_FRAMES   8
+#define STIMFB_BLANK        0
+
+/**
+ * @brief  Allocate the blank frame and show it. Needs the display up
+ *         (graphics.c).
+ */
+esp_err_t stimfb_init(void);
+
+/**
+ * @brief  Render a full-screen grating of @p stripes equal vertical bars,
+ *         the even ones @p fg and the odd ones @p bg (0xRRGGBB).
+ * @param  id  Frame number for stimfb_show()
+ */
+esp_err_t stimfb_new_grating(int stripes, uint32_t fg, uint32_t bg, int *id);
+
+/**
+ * @brief  Render a full-screen solid colour (0xRRGGBB).
+ */
+esp_err_t stimfb_new_solid(uint32_t rgb, int *id);
+
+/**
+ * @brief  Copy frame @p id to the panel and redraw the overlay over it.
+ *         Takes the LVGL lock (recursive: fine to hold it already).
+ */
+esp_err_t stimfb_show(int id);
+
+/** @brief  Frame on the panel, -1 before stimfb_init(). */
+int stimfb_current(void);
+
+#ifdef __cplusplus
+}
+#endif
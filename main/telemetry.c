@@ -0,0 +1,303 @@
+// main/telemetry.c
+//
+// Producers reserve a ring slot with a CAS on the head index and mark it ready
+// through the slot's own sequence number (bounded MPSC queue), so posting never
+// takes a lock and a slow UART can only ever cost dropped records. The writer
+// task drains the ring every TELEMETRY_FLUSH_MS, frames each record with
+// CRC + COBS into one batch and hands the batch to the UART driver.
+#include "telemetry.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "crc16.h"
+#include "driver/uart.h"
+#include "driver/uart_vfs.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "TLM";
+
+#define TELEMETRY_UART      CONFIG_ESP_CONSOLE_UART_NUM
+#define TLM_UART_RX_BUF     1024
+#define TLM_UART_TX_BUF     8192
+#define TLM_RING_MASK       (TELEMETRY_RING_SLOTS - 1)
+#define TLM_HDR_LEN         3                                   // type + seq
+#define TLM_RAW_MAX         (TLM_HDR_LEN + TELEMETRY_MAX_PAYLOAD + 2)
+#define TLM_FRAME_MAX       (TLM_RAW_MAX + TLM_RAW_MAX / 254 + 2) // COBS overhead + delimiter
+#define TLM_BATCH_BYTES     2048
+#define TLM_HEALTH_PERIOD_US 1000000
+
+_Static_assert((TELEMETRY_RING_SLOTS & TLM_RING_MASK) == 0, "ring size must be a power of two");
+
+typedef struct {
+    atomic_uint seq;        // == index + 1 when ready to drain, index + SLOTS when free again
+    uint8_t     type;
+    uint8_t     len;
+    uint8_t     payload[TELEMETRY_MAX_PAYLOAD];
+} tlm_slot_t;
+
+static tlm_slot_t   s_ring[TELEMETRY_RING_SLOTS];
+static atomic_uint  s_head;         // next slot to reserve (any producer)
+static volatile unsigned s_tail;    // next slot to drain (written by the writer task only)
+static atomic_uint  s_dropped;
+static atomic_bool  s_ready;
+
+static uint32_t     s_sent;
+static uint16_t     s_wire_seq;     // next frame's seq (writer task only)
+static unsigned     s_drops_seen;   // s_dropped already skipped in s_wire_seq
+static uint16_t     s_high_water;
+static uint8_t      s_batch[TLM_BATCH_BYTES];
+
+// Consistent Overhead Byte Stuffing: no 0x00 in the output, so 0x00 can
+// delimit frames. Returns the encoded length (len + 1 for short records).
+static size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t  code_idx = 0;
+    size_t  o        = 1;
+    uint8_t code     = 1;
+
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[code_idx] = code;
+            code_idx = o++;
+            code     = 1;
+        } else {
+            out[o++] = in[i];
+            if (++code == 0xFF) {
+                out[code_idx] = code;
+                code_idx = o++;
+                code     = 1;
+            }
+        }
+    }
+    out[code_idx] = code;
+    return o;
+}
+
+bool telemetry_post(uint8_t type, const void *payload, size_t len)
+{
+    if (!atomic_load_explicit(&s_ready, memory_order_acquire) || len > TELEMETRY_MAX_PAYLOAD) {
+        return false;
+    }
+    unsigned    pos = atomic_load_explicit(&s_head, memory_order_relaxed);
+    tlm_slot_t *slot;
+    for (;;) {
+        slot = &s_ring[pos & TLM_RING_MASK];
+        unsigned seq  = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int      diff = (int)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&s_head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // writer has not freed this slot yet: ring is full
+            atomic_fetch_add_explicit(&s_dropped, 1, memory_order_relaxed);
+            return false;
+        } else {
+            pos = atomic_load_explicit(&s_head, memory_order_relaxed);
+        }
+    }
+
+    slot->type    = type;
+    slot->len     = (uint8_t)len;
+    memcpy(slot->payload, payload, len);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return true;
+}
+
+// Frame the next ready slot into out; returns 0 if the ring is empty.
+static size_t ring_pop_frame(uint8_t *out)
+{
+    tlm_slot_t *slot = &s_ring[s_tail & TLM_RING_MASK];
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != s_tail + 1) {
+        return 0;
+    }
+
+    // seq is given here, in wire order, and skips one number per record
+    // dropped since the last frame: the host sees drops as gaps, never as
+    // a record overtaking another
+    unsigned dropped = atomic_load_explicit(&s_dropped, memory_order_relaxed);
+    s_wire_seq  += (uint16_t)(dropped - s_drops_seen);
+    s_drops_seen = dropped;
+    uint16_t seq = s_wire_seq++;
+
+    uint8_t raw[TLM_RAW_MAX];
+    size_t  n = 0;
+    raw[n++] = slot->type;
+    raw[n++] = (uint8_t)(seq & 0xFF);
+    raw[n++] = (uint8_t)(seq >> 8);
+    memcpy(&raw[n], slot->payload, slot->len);
+    n += slot->len;
+
+    atomic_store_explicit(&slot->seq, s_tail + TELEMETRY_RING_SLOTS, memory_order_release);
+    s_tail++;
+
+    uint16_t crc = crc16_xmodem(raw, n);
+    raw[n++] = (uint8_t)(crc >> 8);
+    raw[n++] = (uint8_t)(crc & 0xFF);
+
+    size_t len = cobs_encode(raw, n, out);
+    out[len++] = 0x00;
+    return len;
+}
+
+static void post_health(void)
+{
+    tlm_health_t h = {
+        .t_us       = (uint32_t)esp_timer_get_time(),
+        .dropped    = atomic_load_explicit(&s_dropped, memory_order_relaxed),
+        .sent       = s_sent,
+        .high_water = s_high_water,
+    };
+    telemetry_post(TLM_HEALTH, &h, sizeof(h));
+}
+
+static void telemetry_task(void *pv)
+{
+    int64_t next_health = esp_timer_get_time() + TLM_HEALTH_PERIOD_US;
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(TELEMETRY_FLUSH_MS));
+
+        unsigned used = atomic_load_explicit(&s_head, memory_order_relaxed) - s_tail;
+        if (used > s_high_water) s_high_water = (uint16_t)used;
+
+        if (esp_timer_get_time() >= next_health) {
+            post_health();
+            next_health += TLM_HEALTH_PERIOD_US;
+        }
+
+        for (;;) {
+            size_t   n      = 0;
+            uint32_t frames = 0;
+            s_batch[n++] = 0x00;    // terminate any log text written since the last batch
+
+            while (n + TLM_FRAME_MAX <= sizeof(s_batch)) {
+                size_t len = ring_pop_frame(&s_batch[n]);
+                if (len == 0) break;
+                n += len;
+                frames++;
+            }
+            if (frames == 0) break;
+
+            uart_write_bytes(TELEMETRY_UART, s_batch, n);
+            s_sent += frames;
+        }
+    }
+}
+
+esp_err_t telemetry_init(void)
+{
+    ESP_RETURN_ON_FALSE(!atomic_load(&s_ready), ESP_ERR_INVALID_STATE, TAG, "already initialized");
+
+    for (unsigned i = 0; i < TELEMETRY_RING_SLOTS; i++) {
+        atomic_init(&s_ring[i].seq, i);
+    }
+    atomic_store(&s_head, 0);
+    s_tail = 0;
+
+    // finish whatever the console has queued before changing the baud rate
+    fflush(stdout);
+    uart_wait_tx_idle_polling(TELEMETRY_UART);
+
+    if (!uart_is_driver_installed(TELEMETRY_UART)) {
+        ESP_RETURN_ON_ERROR(uart_driver_install(TELEMETRY_UART, TLM_UART_RX_BUF, TLM_UART_TX_BUF,
+                                                0, NULL, 0),
+                            TAG, "uart_driver_install failed");
+    }
+    ESP_RETURN_ON_ERROR(uart_set_baudrate(TELEMETRY_UART, TELEMETRY_UART_BAUD), TAG, "baud rate");
+    // log text now goes through the driver too, so it can never split a frame
+    uart_vfs_dev_use_driver(TELEMETRY_UART);
+
+    atomic_store_explicit(&s_ready, true, memory_order_release);
+
+    BaseType_t ok = xTaskCreatePinnedToCore(telemetry_task, "tlm", 4096, NULL,
+                                            TELEMETRY_TASK_PRIO, NULL, TELEMETRY_TASK_CORE);
+    ESP_RETURN_ON_FALSE(ok == pdPASS, ESP_ERR_NO_MEM, TAG, "telemetry task create failed");
+
+    ESP_LOGI(TAG, "Telemetry on UART%d @ %d baud, %d-slot ring",
+             TELEMETRY_UART, TELEMETRY_UART_BAUD, TELEMETRY_RING_SLOTS);
+    return ESP_OK;
+}
+
+bool telemetry_kin(int64_t t_us, int32_t pos, float vel)
+{
+    tlm_kin_t r = { .t_us = (uint32_t)t_us, .pos = pos, .vel = vel };
+    return telemetry_post(TLM_KIN, &r, sizeof(r));
+}
+
+bool telemetry_effort(int64_t t_us, float u, uint8_t mode)
+{
+    tlm_effort_t r = { .t_us = (uint32_t)t_us, .u = u, .mode = mode };
+    return telemetry_post(TLM_EFFORT, &r, sizeof(r));
+}
+
+bool telemetry_state(uint32_t trial, uint8_t state, uint8_t marker)
+{
+    tlm_state_t r = {
+        .t_us   = (uint32_t)esp_timer_get_time(),
+        .trial  = trial,
+        .state  = state,
+        .marker = marker,
+    };
+    return telemetry_post(TLM_STATE, &r, sizeof(r));
+}
+
+bool telemetry_trial(uint32_t trial, uint8_t outcome, uint8_t reward_type,
+                     uint32_t rt_ms, int32_t pos, uint32_t correct, uint32_t total)
+{
+    tlm_trial_t r = {
+        .t_us        = (uint32_t)esp_timer_get_time(),
+        .trial       = trial,
+        .outcome     = outcome,
+        .reward_type = reward_type,
+        .rt_ms       = rt_ms,
+        .pos         = pos,
+        .correct     = correct,
+        .total       = total,
+    };
+    return telemetry_post(TLM_TRIAL, &r, sizeof(r));
+}
+
+bool telemetry_marker(int64_t t_us, uint32_t trial, uint8_t marker, uint8_t seq,
+                      uint8_t flags, uint32_t late_us)
+{
+    tlm_marker_t r = {
+        .t_us    = (uint32_t)t_us,
+        .trial   = trial,
+        .marker  = marker,
+        .seq     = seq,
+        .flags   = flags,
+        .late_us = late_us,
+    };
+    return telemetry_post(TLM_MARKER, &r, sizeof(r));
+}
+
+bool telemetry_sync(int64_t t_us, uint32_t seq, uint16_t width_us)
+{
+    tlm_sync_t r = { .t_us = (uint32_t)t_us, .seq = seq, .width_us = width_us };
+    return telemetry_post(TLM_SYNC, &r, sizeof(r));
+}
+
+bool telemetry_stim(const tlm_stim_t *r)
+{
+    return telemetry_post(TLM_STIM, r, sizeof(*r));
+}
+
+uint32_t telemetry_free_slots(void)
+{
+    // s_tail is only advanced by the writer; a slightly stale read just
+    // under-reports free space
+    unsigned used = atomic_load_explicit(&s_head, memory_order_relaxed) - s_tail;
+    return used >= TELEMETRY_RING_SLOTS ? 0 : TELEMETRY_RING_SLOTS - used;
+}
+
+uint32_t telemetry_dropped(void)
+{
+    return atomic_load_explicit(&s_dropped, memory_order_relaxed);
+}
@@ -0,0 +1,184 @@
+// main/telemetry.h
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary telemetry on the console UART.
+ *
+ * Every record is one frame:
+ *
+ *     COBS( type:u8  seq:u16  payload[len]  crc16:u16 ) 0x00
+ *
+ * little-endian fields, CRC-16/XMODEM (poly 0x1021, init 0, as used for the
+ * RoboClaw in mcpcommands.c) over type..payload, stored big-endian. seq is
+ * assigned as frames go out and skips one number for each record dropped in
+ * between, so a gap on the host means records were dropped (around there;
+ * a drop is noticed at the next frame).
+ * Log text still goes out on the same UART between frames; the host decoder
+ * (telemetry.py) passes anything that is not a valid frame through as text.
+ */
+
+#define TELEMETRY_UART_BAUD     921600
+#define TELEMETRY_MAX_PAYLOAD   28      // largest payload a record may carry
+#define TELEMETRY_RING_SLOTS    512     // power of two
+#define TELEMETRY_FLUSH_MS      2       // writer task period
+#define TELEMETRY_TASK_PRIO     2       // below everything behavioural
+#define TELEMETRY_TASK_CORE     1
+
+typedef enum {
+    TLM_KIN    = 1,     // tlm_kin_t
+    TLM_EFFORT = 2,     // tlm_effort_t
+    TLM_STATE  = 3,     // tlm_state_t
+    TLM_TRIAL  = 4,     // tlm_trial_t
+    TLM_HEALTH = 5,     // tlm_health_t, once a second from the writer
+    TLM_TRAJ_HDR = 6,   // tlm_traj_hdr_t, starts a captured trial (trial_capture.c)
+    TLM_TRAJ   = 7,     // tlm_traj_t, two samples of that trial
+    TLM_MARKER = 8,     // tlm_marker_t, one per event marker (event.c)
+    TLM_JOURNAL = 9,    // tlm_journal_t, a batch of event journal entries (journal.h)
+    TLM_SYNC   = 10,    // tlm_sync_t, one per clock-sync pulse (clocksync.h)
+    TLM_STIM   = 11,    // tlm_stim_t, one per stimulus commit (stim.h)
+} tlm_type_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t t_us;      // esp_timer time of the encoder read (low 32 bits)
+    int32_t  pos;       // encoder count
+    float    vel;       // filtered velocity, counts/s
+} tlm_kin_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t t_us;
+    float    u;         // motor command, -100…100
+    uint8_t  mode;      // controller that produced it (paradigm-defined)
+} tlm_effort_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t t_us;
+    uint32_t trial;
+    uint8_t  state;     // sm_state_t entered
+    uint8_t  marker;    // event_state_t emitted (0xFF if none)
+} tlm_state_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t t_us;
+    uint32_t trial;
+    uint8_t  outcome;       // 0 = correct, 1 = timeout
+    uint8_t  reward_type;
+    uint32_t rt_ms;
+    int32_t  pos;
+    uint32_t correct;       // session totals after this trial
+    uint32_t total;
+} tlm_trial_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t t_us;      // first rising edge on the event pin (0 if never sent)
+    uint32_t trial;
+    uint8_t  marker;    // event_state_t
+    uint8_t  seq;       // marker counter, 7 bits (the word's sequence field)
+    uint8_t  flags;     // EVENT_MK_*
+    uint32_t late_us;   // t_us minus the earliest the edge could have been
+} tlm_marker_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t t_us;      // rising edge of the sync pulse
+    uint32_t seq;       // pulse number since boot
+    uint16_t width_us;  // CLOCKSYNC_*_US (frame coding, clocksync.h)
+} tlm_sync_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t t_us;      // onset: vsync of the first frame showing the stimulus
+    uint32_t trial;
+    uint8_t  marker;    // event_state_t, 0xFF if none was staged
+    uint8_t  flags;     // STIM_F_*
+    int32_t  audio_us;  // sound onset - t_us
+    int32_t  marker_us; // marker's first rising edge - t_us
+    int32_t  ready_us;  // frame in the buffer - t_us (negative: margin left)
+} tlm_stim_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  n;         // entries used
+    struct __attribute__((packed)) {
+        uint32_t t_us;
+        uint8_t  kind;  // journal_kind_t
+        uint8_t  val;
+        uint16_t arg;
+    } e[3];
+} tlm_journal_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t t_us;
+    uint32_t dropped;       // records lost to a full ring since boot
+    uint32_t sent;          // frames written since boot
+    uint16_t high_water;    // most slots ever in use
+} tlm_health_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t t0_us;         // time of sample 0
+    uint32_t trial;
+    uint32_t n_samples;     // samples that follow in TLM_TRAJ records
+    uint32_t lost;          // samples that did not fit in the arena
+    uint16_t period_us;     // sample spacing
+} tlm_traj_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    int32_t  pos;
+    float    vel;
+    float    u;
+} tlm_traj_sample_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t          trial;    // low 16 bits of the trial number
+    uint16_t          index;    // index of s[0]; s[1] is padding past n_samples
+    tlm_traj_sample_t s[2];
+} tlm_traj_t;
+
+_Static_assert(sizeof(tlm_trial_t) <= TELEMETRY_MAX_PAYLOAD, "tlm_trial_t too large");
+_Static_assert(sizeof(tlm_traj_t)  <= TELEMETRY_MAX_PAYLOAD, "tlm_traj_t too large");
+
+/**
+ * @brief  Install the UART driver on the console port, route log output
+ *         through it, and start the writer task.
+ */
+esp_err_t telemetry_init(void);
+
+/**
+ * @brief  Queue one record. Lock-free and non-blocking; safe from any task on
+ *         either core. Returns false (and counts a drop) if the ring is full.
+ * @param  type     tlm_type_t
+ * @param  payload  Record body, copied
+ * @param  len      ≤ TELEMETRY_MAX_PAYLOAD
+ */
+bool telemetry_post(uint8_t type, const void *payload, size_t len);
+
+// Typed helpers around telemetry_post()
+bool telemetry_kin(int64_t t_us, int32_t pos, float vel);
+bool telemetry_effort(int64_t t_us, float u, uint8_t mode);
+bool telemetry_state(uint32_t trial, uint8_t state, uint8_t marker);
+bool telemetry_trial(uint32_t trial, uint8_t outcome, uint8_t reward_type,
+                     uint32_t rt_ms, int32_t pos, uint32_t correct, uint32_t total);
+bool telemetry_marker(int64_t t_us, uint32_t trial, uint8_t marker, uint8_t seq,
+                      uint8_t flags, uint32_t late_us);
+bool telemetry_sync(int64_t t_us, uint32_t seq, uint16_t width_us);
+bool telemetry_stim(const tlm_stim_t *r);
+
+/**
+ * @brief  Ring slots currently free. Bulk producers use this to pace
+ *         themselves instead of overflowing the ring.
+ */
+uint32_t telemetry_free_slots(void);
+
+/**
+ * @brief  Records dropped because the ring was full.
+ */
+uint32_t telemetry_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
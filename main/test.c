@@ -5,14 +5,16 @@
 #include "freertos/projdefs.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "esp_check.h"
 #include "esp_log.h"
 #include "lvgl.h"
 #include "lv_conf.h"
-#include "audio_pwm.c"
+#include "app_mode.h"
+#include "audio_pwm.h"
 #include "graphics.h"
-#include "mcpcommands.c"
-#include "peripheral_config.c"
+#include "mcpcommands.h"
 #include "encoder_out.h"
+#include "serial_cmd.h"
 #include "driver/ledc.h"
 #include "driver/uart.h"
 #include "driver/gpio.h"
@@ -20,6 +22,7 @@
 #include "esp_random.h"
 #include "esp_rom_sys.h"
 #include "font/lv_font.h"
+#include <stdlib.h>
 #include <string.h>
 
 // Define our GPIO Pins for use
@@ -49,6 +52,17 @@
 #define REWARD_DURATION_MS   500       // 500ms to signal the syringe pump via TTL
 #define TRIAL_TIMEOUT_MS     3500  // 3.5 seconds
 #define ENCODER_DIR          -1 // invert the direction of the encoder values for push/pull
+#define CONFIG_LINE_MAX      128       // TRIALS=..;COLOR=..;MODE=..;SIDE=.. from the host
+
+// RoboClaw packet serial (mcpcommands.h) on UART2
+static const uart_port_t uart_num = UART_NUM_2;
+static const uart_config_t uart_config = {
+    .baud_rate = 115200,
+    .data_bits = UART_DATA_8_BITS,
+    .parity = UART_PARITY_DISABLE,
+    .stop_bits = UART_STOP_BITS_1,
+    .flow_ctrl = UART_HW_FLOWCTRL_DISABLE
+};
 
 
 // // Define LEDC parameters, used here for audio generation via PWMs
@@ -62,15 +76,15 @@
 
 // Global variables
 static const char *TAG = "LEVER_TEST";
-SemaphoreHandle_t encoder_mutex = NULL;
-volatile int32_t current_encoder_value = 0;
-lv_obj_t *lever_indicator = NULL;
-lv_obj_t *nonreward_circle = NULL;
+static SemaphoreHandle_t encoder_mutex = NULL;
+static volatile int32_t current_encoder_value = 0;
+static lv_obj_t *lever_indicator = NULL;
+static lv_obj_t *nonreward_circle = NULL;
 // lv_obj_t *condition_circle_push = NULL;  // Forward/push condition circle
 // lv_obj_t *condition_circle_pull = NULL;  // Backward/pull condition circle
-lv_style_t indicator_style;
-lv_style_t condition_style;
-lv_style_t condition_active_style;
+static lv_style_t indicator_style;
+static lv_style_t condition_style;
+static lv_style_t condition_active_style;
 
 // -------------------
 // Trial State Machine
@@ -109,13 +123,13 @@ static const uint32_t EVENT_WIDTH_US[] = {
     [EVT_SESSION_END]   =   1000
 };
 
-volatile trial_state_t trial_state = TRIAL_INIT;
-volatile bool trial_success = false;
-lv_obj_t *reward_circle = NULL;
+static volatile trial_state_t trial_state = TRIAL_INIT;
+static volatile bool trial_success = false;
+static lv_obj_t *reward_circle = NULL;
 
 // Animation flag (used by animation callback and UI task)
-bool animation_active = false;
-int32_t animation_target = 0;
+static bool animation_active = false;
+static int32_t animation_target = 0;
 
 typedef enum {
     REWARD_FIXED_PUSH,
@@ -132,7 +146,7 @@ typedef struct {
 
 
 // Initialize with default values. For example, if fixed and reward is on the left:
-RewardConfig reward_config = {
+static RewardConfig reward_config = {
     .reward_color_is_green = true,          // Green is the reward color
     .reward_mode = REWARD_FIXED_PUSH,       // Default to fixed left
     .reward_x_pos = INDICATOR_START_X - CONDITION_SCREEN_OFFSET,  // Reward circle on top(push)
@@ -148,7 +162,7 @@ typedef struct {
 } SessionConfig;
 
 // Initialize with default values
-SessionConfig session = {
+static SessionConfig session = {
     .num_trials = 20,            // Default: 20 trials
     .current_trial = 0,          // Start at trial 0
     .use_serial_config = true,   // Try to use serial config by default
@@ -160,21 +174,20 @@ SessionConfig session = {
 };
 
 // Function prototypes
-void encoder_read_task(void *pvParameters);
-void ui_update_task(void *pvParameters);
-void trial_state_task(void *pvParameters);
+static void encoder_read_task(void *pvParameters);
+static void ui_update_task(void *pvParameters);
+static void trial_state_task(void *pvParameters);
 static void create_lever_ui(lv_display_t *display);
-void play_tone(uint32_t tone_frequency, uint32_t duration_ms);
 static inline void pulse_event_us(uint32_t width_us);
 static void log_and_pulse(event_type_t evt, int trial_num);
-void set_motor_position(int32_t position);
-void start_animation_to_position(int32_t position);
+static void set_motor_position(int32_t position);
+static void start_animation_to_position(int32_t position);
 static void animation_callback(void *var, int32_t value);
 static void highlight_condition_circle( bool active);
-bool check_circle_collision(int32_t x1, int32_t y1, int32_t r1, int32_t x2, int32_t y2, int32_t r2);
-void randomize_condition_circle_positions(void);
-void update_trial_counter(void);
-void update_circle_styles(void);
+static bool check_circle_collision(int32_t x1, int32_t y1, int32_t r1, int32_t x2, int32_t y2, int32_t r2);
+static void randomize_condition_circle_positions(void);
+static void update_trial_counter(void);
+static void update_circle_styles(void);
 
 // GPIO Setup
 static esp_err_t setup_gpio(void) { // set up the GPIO pins according to the GPIO pin MASK (l.33)
@@ -196,36 +209,24 @@ static inline void pulse_event_us(uint32_t width_us) {
 
 
 //----------------------
-static char wait_for_user_input(int timeout_ms) {
-    uint8_t data;
-    int len = uart_read_bytes(UART_NUM_0, &data, 1, pdMS_TO_TICKS(timeout_ms));
-    if (len > 0) {
-        if (data >= 'a' && data <= 'z') data -= ('a' - 'A');
-        return (char)data;
-    }
-    return '\0';
+// The console belongs to serial_cmd; config lines (no command word) reach
+// us through its fallback handler and this one-slot queue.
+static QueueHandle_t config_queue;
+
+static void config_line(const char *line)
+{
+    char buf[CONFIG_LINE_MAX];
+    strlcpy(buf, line, sizeof(buf));
+    xQueueOverwrite(config_queue, buf);
 }
 
 static void wait_for_config(void) {
-    char    buf[128];
-    size_t  idx = 0;
-    uint8_t ch;
+    char    buf[CONFIG_LINE_MAX];
 
     printf("READY_FOR_CONFIG\n");
 
-    // Read UART input until newline
-    while (1) {
-        int r = uart_read_bytes(UART_NUM_0, &ch, 1, pdMS_TO_TICKS(100));
-        if (r > 0) {
-            if (ch == '\r') continue;
-            if (idx < sizeof(buf) - 1)
-                buf[idx++] = (char)ch;
-            if (ch == '\n') {
-                buf[idx] = '\0';
-                break;
-            }
-        }
-    }
+    // Block until the host sends its config line
+    xQueueReceive(config_queue, buf, portMAX_DELAY);
 
     printf("Received config string: %s\n", buf);
 
@@ -329,7 +330,7 @@ static void log_and_pulse(event_type_t evt, int trial_num) {
 
 //----------------------
 // Check collision between two circles
-bool check_circle_collision(int32_t x1, int32_t y1, int32_t r1, int32_t x2, int32_t y2, int32_t r2) {
+static bool check_circle_collision(int32_t x1, int32_t y1, int32_t r1, int32_t x2, int32_t y2, int32_t r2) {
     int32_t dx = x1 - x2;
     int32_t dy = y1 - y2;
     int32_t distance_squared = dx * dx + dy * dy;
@@ -368,7 +369,7 @@ static void animation_callback(void *var, int32_t value) {
 
 //----------------------
 // Start an animation to move the lever to a target position
-void start_animation_to_position(int32_t position) {
+static void start_animation_to_position(int32_t position) {
     // Convert encoder position to screen coordinate
     int32_t screen_center = SCREEN_WIDTH / 2;
     int32_t screen_value = screen_center + (ENCODER_DIR * ((position * (SCREEN_WIDTH/2 - INDICATOR_SIZE)) / ENCODER_MAX_RANGE));
@@ -398,7 +399,7 @@ void start_animation_to_position(int32_t position) {
 
 //----------------------
 // Set motor position using mcpcommands.c functions
-void set_motor_position(int32_t position) {
+static void set_motor_position(int32_t position) {
     // Clamp position to safe range
     if (position > ENCODER_MAX_RANGE) position = ENCODER_MAX_RANGE;
     if (position < -ENCODER_MAX_RANGE) position = -ENCODER_MAX_RANGE;
@@ -416,7 +417,7 @@ void set_motor_position(int32_t position) {
 
 //----------------------
 // Task to read encoder values
-void encoder_read_task(void *pvParameters) {
+static void encoder_read_task(void *pvParameters) {
     TickType_t last_wake_time = xTaskGetTickCount();
     
     // ESP_LOGI(TAG, "Encoder reading task started"); Uncomment for debugging
@@ -453,7 +454,7 @@ static void highlight_condition_circle(bool active) {
 }
 
 // Function to update styles based on reward configuration
-static void update_reward_styles() {
+static void update_reward_styles(void) {
     if (!lvgl_lock(10)) {
         ESP_LOGE(TAG, "Failed to acquire LVGL mutex in update_reward_styles");
         return;
@@ -473,7 +474,7 @@ static void update_reward_styles() {
     lvgl_unlock();
 }
 
-void update_circle_styles(void) {
+static void update_circle_styles(void) {
     if (!lvgl_lock(10)) {
         ESP_LOGE(TAG, "Failed to acquire LVGL mutex in update_circle_styles");
         return;
@@ -582,7 +583,7 @@ static void create_lever_ui(lv_display_t *display) {
 //----------------------
 // Task to update UI based on encoder position
 // UI only ever moves the lever indicator now — no need to touch the reward circle here.
-void ui_update_task(void *pvParameters) {
+static void ui_update_task(void *pvParameters) {
     TickType_t last_wake_time = xTaskGetTickCount();
     int32_t    last_encoder_value = 0;
 
@@ -629,7 +630,7 @@ void ui_update_task(void *pvParameters) {
 }
 
 // Now only randomize our single reward_circle, not two separate circles:
-void randomize_condition_circle_positions(void) {
+static void randomize_condition_circle_positions(void) {
     bool on_bottom = (esp_random() & 0x01);
     int32_t pos_x = on_bottom
                   ? (INDICATOR_START_X + CONDITION_SCREEN_OFFSET)
@@ -651,7 +652,7 @@ void randomize_condition_circle_positions(void) {
 }
 
 // Function to update the trial counter display
-void update_trial_counter() {
+static void update_trial_counter(void) {
     if (lvgl_lock(10)) {
         if (session.trial_counter_label != NULL) {
             lv_label_set_text_fmt(session.trial_counter_label, 
@@ -671,7 +672,7 @@ void update_trial_counter() {
 #define STATE_TASK_PERIOD 5
 #endif
 
-void trial_state_task(void *pvParameters) {
+static void trial_state_task(void *pvParameters) {
     TickType_t state_start = xTaskGetTickCount();
     setup_gpio();
     trial_state = TRIAL_CONFIG;
@@ -920,8 +921,8 @@ void trial_state_task(void *pvParameters) {
     }
 }
 //----------------------
-// Main application entry point
-void app_main(void) {
+// Mode "levertest": RoboClaw lever rig (encoder and motor on the RoboClaw)
+static esp_err_t levertest_init(void) {
     ESP_LOGI(TAG, "Starting lever test application");
     // Only keep ERROR+ for LEDC; similarly you can mute any tag you like.
     esp_log_level_set("ledc", ESP_LOG_ERROR);
@@ -930,42 +931,39 @@ void app_main(void) {
     // Then re-enable your task’s TAG:
     esp_log_level_set(TAG, ESP_LOG_INFO);
 
-    
+
     // Initialize UART for motor communication
-    ESP_ERROR_CHECK(uart_param_config(uart_num, &uart_config));
-    ESP_ERROR_CHECK(uart_set_pin(uart_num, 25, 24, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
-    ESP_ERROR_CHECK(uart_driver_install(uart_num, 256, 0, 0, NULL, 0));
-    // after existing UART₂
-    ESP_ERROR_CHECK(uart_param_config   (UART_NUM_0, &uart_config));
-    ESP_ERROR_CHECK(uart_set_pin        (UART_NUM_0, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
-    ESP_ERROR_CHECK(uart_driver_install (UART_NUM_0, 256, 0, 0, NULL, 0));
+    ESP_RETURN_ON_ERROR(uart_param_config(uart_num, &uart_config), TAG, "uart2 config");
+    ESP_RETURN_ON_ERROR(uart_set_pin(uart_num, 25, 24, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE), TAG, "uart2 pins");
+    ESP_RETURN_ON_ERROR(uart_driver_install(uart_num, 256, 0, 0, NULL, 0), TAG, "uart2 driver");
+    // host config lines come in on the console through serial_cmd
+    config_queue = xQueueCreate(1, CONFIG_LINE_MAX);
+    ESP_RETURN_ON_FALSE(config_queue != NULL, ESP_ERR_NO_MEM, TAG, "config queue");
+    serial_cmd_set_default(config_line);
 
-        
     // Initialize encoder mutex
     encoder_mutex = xSemaphoreCreateMutex();
-    if (encoder_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to create encoder mutex");
-        return;
-    }
-    
-    // Initialize display and set backlight
-    lv_display_t *display = lcd_init();
-    bsp_set_lcd_backlight(1);  // Turn on backlight
-    
+    ESP_RETURN_ON_FALSE(encoder_mutex != NULL, ESP_ERR_NO_MEM, TAG, "Failed to create encoder mutex");
+
     ESP_LOGI(TAG, "Creating UI elements");
-    create_lever_ui(display);
-    
+    if (lvgl_lock(100)) {
+        create_lever_ui(lv_display_get_default());
+        lvgl_unlock();
+    }
+
     // Reset encoder counter and position
     ESP_LOGI(TAG, "Initializing motor and encoder");
     reset_encoder_counter();
     reset_position();
     vTaskDelay(pdMS_TO_TICKS(500));
 
-    ESP_ERROR_CHECK(encoder_out_init());
-    
+    return encoder_out_init();
+}
+
+static esp_err_t levertest_run(void) {
     // Create tasks with appropriate priorities
     ESP_LOGI(TAG, "Creating tasks");
-    
+
     // Create encoder reading task (highest priority)
     xTaskCreate(encoder_read_task, "encoder_task", STACK_SIZE, NULL, 
                 configMAX_PRIORITIES - 5, NULL);
@@ -979,4 +977,18 @@ void app_main(void) {
                 configMAX_PRIORITIES - 6, NULL);
     
     ESP_LOGI(TAG, "Initialization complete, starting main loop");
-}
\ No newline at end of file
+    return ESP_OK;
+}
+
+static void levertest_teardown(void) {
+    gpio_set_level(GPIO_REWARD_SIGNAL, 0);
+    reset_position();
+}
+
+const app_mode_t mode_levertest = {
+    .name     = "levertest",
+    .help     = "RoboClaw lever test (needs the RoboClaw rig)",
+    .init     = levertest_init,
+    .run      = levertest_run,
+    .teardown = levertest_teardown,
+};
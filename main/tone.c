@@ -0,0 +1,105 @@
+// main/tone.c
+#include "tone.h"
+#include <inttypes.h>
+#include <stdatomic.h>
+#include "audio.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "TONE";
+
+typedef struct {
+    uint32_t     freq_hz;
+    uint32_t     duration_ms;
+    audio_buf_t *buf;
+} tone_slot_t;
+
+// Entries are only ever appended: readers (the trial task) scan up to the
+// published count without a lock; appending (a render) takes s_render_lock.
+static tone_slot_t       s_cache[TONE_CACHE];
+static atomic_int        s_cached;
+static SemaphoreHandle_t s_render_lock;
+
+static bool find(uint32_t freq_hz, uint32_t duration_ms, audio_buf_t **out)
+{
+    int n = atomic_load_explicit(&s_cached, memory_order_acquire);
+    for (int i = 0; i < n; i++) {
+        if (s_cache[i].freq_hz == freq_hz && s_cache[i].duration_ms == duration_ms) {
+            *out = s_cache[i].buf;
+            return true;
+        }
+    }
+    return false;
+}
+
+static esp_err_t render(uint32_t freq_hz, uint32_t duration_ms, audio_buf_t **out)
+{
+    ESP_RETURN_ON_FALSE(s_render_lock != NULL, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    xSemaphoreTake(s_render_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    int       n   = atomic_load_explicit(&s_cached, memory_order_relaxed);
+    if (!find(freq_hz, duration_ms, out)) {
+        const audio_wave_t w = {
+            .shape   = AUDIO_SQUARE,
+            .freq_hz = freq_hz,
+            .amp     = TONE_AMP,
+            .dur_ms  = duration_ms,
+            .ramp_ms = TONE_RAMP_MS,
+        };
+        if (n == TONE_CACHE) {
+            err = ESP_ERR_NO_MEM;
+        } else if ((err = audio_render(&w, out)) == ESP_OK) {
+            s_cache[n] = (tone_slot_t){ freq_hz, duration_ms, *out };
+            atomic_store_explicit(&s_cached, n + 1, memory_order_release);
+        }
+    }
+    xSemaphoreGive(s_render_lock);
+    ESP_RETURN_ON_ERROR(err, TAG, "%" PRIu32 " Hz/%" PRIu32 " ms", freq_hz, duration_ms);
+    return ESP_OK;
+}
+
+esp_err_t tone_init(void)
+{
+    if (s_render_lock == NULL) {
+        s_render_lock = xSemaphoreCreateMutex();
+        ESP_RETURN_ON_FALSE(s_render_lock != NULL, ESP_ERR_NO_MEM, TAG, "render lock");
+    }
+    return audio_init();
+}
+
+esp_err_t tone_prepare(uint32_t freq_hz, uint32_t duration_ms)
+{
+    audio_buf_t *buf;
+    return find(freq_hz, duration_ms, &buf) ? ESP_OK : render(freq_hz, duration_ms, &buf);
+}
+
+const audio_buf_t *tone_buffer(uint32_t freq_hz, uint32_t duration_ms)
+{
+    audio_buf_t *buf;
+    if (!find(freq_hz, duration_ms, &buf)) {
+        ESP_LOGW(TAG, "%" PRIu32 " Hz/%" PRIu32 " ms not prepared, rendering (late onset)",
+                 freq_hz, duration_ms);
+        if (render(freq_hz, duration_ms, &buf) != ESP_OK) return NULL;
+    }
+    return buf;
+}
+
+esp_err_t tone_start(uint32_t freq_hz, uint32_t duration_ms)
+{
+    const audio_buf_t *buf = tone_buffer(freq_hz, duration_ms);
+    ESP_RETURN_ON_FALSE(buf != NULL, ESP_ERR_NO_MEM, TAG, "tone");
+    audio_play(buf);
+    return ESP_OK;
+}
+
+void tone_stop(void)
+{
+    audio_stop();
+}
+
+bool tone_active(void)
+{
+    return audio_busy();
+}
@@ -0,0 +1,61 @@
+// main/tone.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "audio.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Cue and reward tones for the paradigms, on the audio engine (audio.h).
+ * Each (frequency, duration) pair is rendered once and kept; starting a tone
+ * is then one hand-off to the audio interrupt, with the onset a fixed
+ * AUDIO_LATENCY_US later. Tones are square waves with short ramps, as the
+ * animals were trained on.
+ */
+
+#define TONE_CACHE      32
+#define TONE_RAMP_MS    2
+#define TONE_AMP        0.8f
+
+/**
+ * @brief  Bring up the audio engine (silent).
+ */
+esp_err_t tone_init(void);
+
+/**
+ * @brief  Render a tone ahead of its first use (paradigm selection does this
+ *         for every tone its tables name).
+ */
+esp_err_t tone_prepare(uint32_t freq_hz, uint32_t duration_ms);
+
+/**
+ * @brief  The rendered buffer, for scheduling it on audio.h directly (the
+ *         stimulus commit does); renders it first if it was not prepared.
+ *         NULL if it cannot be rendered.
+ */
+const audio_buf_t *tone_buffer(uint32_t freq_hz, uint32_t duration_ms);
+
+/**
+ * @brief  Start (or replace) the tone; @p duration_ms 0 plays until
+ *         tone_stop(). Renders it first if it was not prepared.
+ */
+esp_err_t tone_start(uint32_t freq_hz, uint32_t duration_ms);
+
+/**
+ * @brief  Fade the tone out now.
+ */
+void tone_stop(void);
+
+/**
+ * @brief  True while a tone is sounding.
+ */
+bool tone_active(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,88 @@
+// main/traj.c
+#include "traj.h"
+#include <math.h>
+#include "esp_check.h"
+
+static const char *TAG = "TRAJ";
+
+// minimum-jerk peak speed = 1.875·D/T, peak acceleration = (10/√3)·D/T²
+#define MJ_PEAK_V   1.875f
+#define MJ_PEAK_A   5.7735027f
+
+esp_err_t traj_plan_minjerk(traj_t *tr, float x0, float x1, float v_max, float a_max)
+{
+    ESP_RETURN_ON_FALSE(tr != NULL && v_max > 0.0f && a_max > 0.0f, ESP_ERR_INVALID_ARG,
+                        TAG, "bad limits");
+    float D = fabsf(x1 - x0);
+
+    tr->profile = TRAJ_MINJERK;
+    tr->x0      = x0;
+    tr->x1      = x1;
+    tr->T       = fmaxf(MJ_PEAK_V * D / v_max, sqrtf(MJ_PEAK_A * D / a_max));
+    tr->inv_T   = tr->T > 0.0f ? 1.0f / tr->T : 0.0f;
+    return ESP_OK;
+}
+
+esp_err_t traj_plan_trapezoid(traj_t *tr, float x0, float x1, float v_max, float a_max)
+{
+    ESP_RETURN_ON_FALSE(tr != NULL && v_max > 0.0f && a_max > 0.0f, ESP_ERR_INVALID_ARG,
+                        TAG, "bad limits");
+    float D = fabsf(x1 - x0);
+
+    tr->profile = TRAJ_TRAPEZOID;
+    tr->x0      = x0;
+    tr->x1      = x1;
+    tr->dir     = (x1 >= x0) ? 1.0f : -1.0f;
+    tr->a       = a_max;
+    if (D * a_max < v_max * v_max) {
+        // triangle: accelerate to the midpoint, then brake
+        tr->v     = sqrtf(D * a_max);
+        tr->t_acc = tr->v / a_max;
+        tr->T     = 2.0f * tr->t_acc;
+    } else {
+        tr->v     = v_max;
+        tr->t_acc = v_max / a_max;
+        tr->T     = 2.0f * tr->t_acc + (D - v_max * tr->t_acc) / v_max;
+    }
+    tr->inv_T = tr->T > 0.0f ? 1.0f / tr->T : 0.0f;
+    return ESP_OK;
+}
+
+void traj_eval(const traj_t *tr, float t, float *x, float *v)
+{
+    if (t <= 0.0f) {
+        *x = tr->x0;
+        *v = 0.0f;
+        return;
+    }
+    if (t >= tr->T) {
+        *x = tr->x1;
+        *v = 0.0f;
+        return;
+    }
+
+    if (tr->profile == TRAJ_MINJERK) {
+        float s  = t * tr->inv_T;
+        float s2 = s * s;
+        float D  = tr->x1 - tr->x0;
+        *x = tr->x0 + D * s2 * s * (10.0f + s * (-15.0f + 6.0f * s));
+        *v = D * tr->inv_T * s2 * (30.0f + s * (-60.0f + 30.0f * s));
+        return;
+    }
+
+    // trapezoid: distance covered so far along the path
+    float d, sp;
+    if (t < tr->t_acc) {
+        sp = tr->a * t;
+        d  = 0.5f * sp * t;
+    } else if (t <= tr->T - tr->t_acc) {
+        sp = tr->v;
+        d  = 0.5f * tr->v * tr->t_acc + tr->v * (t - tr->t_acc);
+    } else {
+        float r = tr->T - t;
+        sp = tr->a * r;
+        d  = fabsf(tr->x1 - tr->x0) - 0.5f * sp * r;
+    }
+    *x = tr->x0 + tr->dir * d;
+    *v = tr->dir * sp;
+}
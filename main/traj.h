@@ -0,0 +1,55 @@
+// main/traj.h
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Point-to-point reference trajectories in encoder counts.
+ *
+ * Both planners pick the shortest duration that respects the speed and
+ * acceleration limits, so a move takes a known time computed up front.
+ * traj_eval() is cheap (a few multiplies, no divisions) for the control loop.
+ */
+
+typedef enum {
+    TRAJ_MINJERK = 0,   // smooth 5th-order polynomial, zero vel/acc at both ends
+    TRAJ_TRAPEZOID,     // constant accel / cruise / constant decel
+} traj_profile_t;
+
+typedef struct {
+    traj_profile_t profile;
+    float x0, x1;           // start and end position (counts)
+    float T;                // total duration (s)
+    float inv_T;
+    // trapezoid only
+    float dir;              // ±1
+    float a;                // acceleration magnitude (counts/s²)
+    float v;                // cruise (or triangle peak) speed (counts/s)
+    float t_acc;            // duration of each ramp (s)
+} traj_t;
+
+/**
+ * @brief  Minimum-jerk move from @p x0 to @p x1 with peak speed ≤ @p v_max
+ *         (counts/s) and peak acceleration ≤ @p a_max (counts/s²).
+ */
+esp_err_t traj_plan_minjerk(traj_t *tr, float x0, float x1, float v_max, float a_max);
+
+/**
+ * @brief  Trapezoidal-velocity move, triangular if the cruise speed is
+ *         never reached.
+ */
+esp_err_t traj_plan_trapezoid(traj_t *tr, float x0, float x1, float v_max, float a_max);
+
+/**
+ * @brief  Reference position and velocity @p t seconds after the start;
+ *         clamped to the end points outside [0, T].
+ */
+void traj_eval(const traj_t *tr, float t, float *x, float *v);
+
+#ifdef __cplusplus
+}
+#endif
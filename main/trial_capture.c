@@ -0,0 +1,196 @@
+// main/trial_capture.c
+//
+// The control loop is the only writer of the active buffer, so appending is a
+// plain store plus a release of the sample count. The trial task swaps the
+// active buffer in and out with one atomic pointer; the flush task owns a
+// buffer from trial_capture_end() until it is marked free again.
+#include "trial_capture.h"
+#include <stdatomic.h>
+#include <string.h>
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "telemetry.h"
+
+static const char *TAG = "TCAP";
+
+#define TCAP_NUM_BUFS   2
+
+typedef enum {
+    TCAP_FREE = 0,
+    TCAP_RECORDING,
+    TCAP_PENDING,       // waiting for / being flushed
+} tcap_state_t;
+
+typedef struct {
+    atomic_int          state;
+    uint32_t            trial;
+    volatile int64_t    t0_us;
+    atomic_uint         n;          // samples stored
+    atomic_uint         lost;       // samples that did not fit
+    tlm_traj_sample_t  *samples;    // PSRAM, s_max entries
+} tcap_buf_t;
+
+static tcap_buf_t            s_buf[TCAP_NUM_BUFS];
+static tcap_buf_t * _Atomic  s_rec;         // buffer the control loop appends to
+static uint32_t              s_max;
+static uint32_t              s_period_us;
+static TaskHandle_t          s_flush_task;
+static trial_capture_stats_t s_stats;
+
+void trial_capture_sample(int64_t t_us, int32_t pos, float vel, float u)
+{
+    tcap_buf_t *b = atomic_load_explicit(&s_rec, memory_order_acquire);
+    if (b == NULL) return;
+
+    unsigned i = atomic_load_explicit(&b->n, memory_order_relaxed);
+    if (i >= s_max) {
+        atomic_fetch_add_explicit(&b->lost, 1, memory_order_relaxed);
+        return;
+    }
+    if (i == 0) b->t0_us = t_us;
+    b->samples[i].pos = pos;
+    b->samples[i].vel = vel;
+    b->samples[i].u   = u;
+    atomic_store_explicit(&b->n, i + 1, memory_order_release);
+}
+
+void trial_capture_begin(uint32_t trial)
+{
+    if (s_max == 0) return;
+    trial_capture_end();    // previous trial never ended: close it out
+
+    for (int i = 0; i < TCAP_NUM_BUFS; i++) {
+        int expected = TCAP_FREE;
+        if (atomic_compare_exchange_strong(&s_buf[i].state, &expected, TCAP_RECORDING)) {
+            tcap_buf_t *b = &s_buf[i];
+            b->trial = trial;
+            b->t0_us = 0;
+            atomic_store_explicit(&b->n, 0, memory_order_relaxed);
+            atomic_store_explicit(&b->lost, 0, memory_order_relaxed);
+            atomic_store_explicit(&s_rec, b, memory_order_release);
+            return;
+        }
+    }
+    // both buffers still flushing: bounded memory wins, this trial is not kept
+    s_stats.trials_skipped++;
+}
+
+void trial_capture_end(void)
+{
+    tcap_buf_t *b = atomic_exchange_explicit(&s_rec, NULL, memory_order_acq_rel);
+    if (b == NULL) return;
+
+    uint32_t n    = atomic_load_explicit(&b->n, memory_order_acquire);
+    uint32_t lost = atomic_load_explicit(&b->lost, memory_order_relaxed);
+    s_stats.trials_captured++;
+    s_stats.samples_lost += lost;
+    if (n + lost > s_stats.max_fill) s_stats.max_fill = n + lost;
+
+    atomic_store(&b->state, TCAP_PENDING);
+    xTaskNotify(s_flush_task, 1u << (b - s_buf), eSetBits);
+}
+
+// Block until the telemetry ring has room, leaving headroom for live records.
+static void wait_for_ring(void)
+{
+    while (telemetry_free_slots() <= TRIAL_CAPTURE_HEADROOM) {
+        vTaskDelay(1);
+    }
+}
+
+static void flush_one(tcap_buf_t *b)
+{
+    // a control step that loaded s_rec just before trial_capture_end() may
+    // still be storing its sample; one tick is far longer than a step
+    vTaskDelay(1);
+
+    uint32_t n = atomic_load_explicit(&b->n, memory_order_acquire);
+
+    tlm_traj_hdr_t hdr = {
+        .t0_us     = (uint32_t)b->t0_us,
+        .trial     = b->trial,
+        .n_samples = n,
+        .lost      = atomic_load_explicit(&b->lost, memory_order_relaxed),
+        .period_us = (uint16_t)s_period_us,
+    };
+    wait_for_ring();
+    telemetry_post(TLM_TRAJ_HDR, &hdr, sizeof(hdr));
+
+    tlm_traj_t rec = { .trial = (uint16_t)b->trial };
+    for (uint32_t i = 0; i < n; i += 2) {
+        rec.index = (uint16_t)i;
+        rec.s[0]  = b->samples[i];
+        if (i + 1 < n) {
+            rec.s[1] = b->samples[i + 1];
+        } else {
+            memset(&rec.s[1], 0, sizeof(rec.s[1]));
+        }
+        wait_for_ring();
+        telemetry_post(TLM_TRAJ, &rec, sizeof(rec));
+    }
+
+    atomic_store(&b->state, TCAP_FREE);
+    s_stats.trials_flushed++;
+}
+
+static void flush_task(void *pv)
+{
+    uint32_t pending = 0;
+
+    while (1) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+        pending |= bits;
+
+        while (pending) {
+            // oldest trial first
+            int pick = -1;
+            for (int i = 0; i < TCAP_NUM_BUFS; i++) {
+                if ((pending & (1u << i)) &&
+                    (pick < 0 || s_buf[i].trial < s_buf[pick].trial)) {
+                    pick = i;
+                }
+            }
+            flush_one(&s_buf[pick]);
+            pending &= ~(1u << pick);
+
+            // pick up anything that ended while we were flushing
+            if (xTaskNotifyWait(0, UINT32_MAX, &bits, 0) == pdTRUE) pending |= bits;
+        }
+    }
+}
+
+esp_err_t trial_capture_init(uint32_t max_samples, uint32_t period_us)
+{
+    ESP_RETURN_ON_FALSE(max_samples > 0 && max_samples <= UINT16_MAX, ESP_ERR_INVALID_ARG,
+                        TAG, "max_samples %lu out of range", (unsigned long)max_samples);
+    ESP_RETURN_ON_FALSE(s_max == 0, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+
+    for (int i = 0; i < TCAP_NUM_BUFS; i++) {
+        s_buf[i].samples = heap_caps_calloc(max_samples, sizeof(tlm_traj_sample_t), MALLOC_CAP_SPIRAM);
+        ESP_RETURN_ON_FALSE(s_buf[i].samples != NULL, ESP_ERR_NO_MEM, TAG, "PSRAM arena alloc failed");
+        atomic_init(&s_buf[i].state, TCAP_FREE);
+    }
+    atomic_store(&s_rec, NULL);
+    s_period_us = period_us;
+
+    BaseType_t ok = xTaskCreatePinnedToCore(flush_task, "tcap", 3072, NULL,
+                                            TRIAL_CAPTURE_FLUSH_PRIO, &s_flush_task,
+                                            TRIAL_CAPTURE_FLUSH_CORE);
+    ESP_RETURN_ON_FALSE(ok == pdPASS, ESP_ERR_NO_MEM, TAG, "flush task create failed");
+    s_max = max_samples;
+
+    ESP_LOGI(TAG, "Trial capture: 2 x %lu samples (%lu KB PSRAM), %lu us spacing",
+             (unsigned long)max_samples,
+             (unsigned long)(TCAP_NUM_BUFS * max_samples * sizeof(tlm_traj_sample_t) / 1024),
+             (unsigned long)period_us);
+    return ESP_OK;
+}
+
+void trial_capture_get_stats(trial_capture_stats_t *out)
+{
+    *out = s_stats;
+}
@@ -0,0 +1,61 @@
+// main/trial_capture.h
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Full-resolution per-trial trajectory capture.
+ *
+ * Two preallocated PSRAM buffers: one records the current trial while the
+ * other is flushed over telemetry (TLM_TRAJ_HDR + TLM_TRAJ records) during
+ * the inter-trial interval. Memory is bounded: a trial longer than the
+ * buffer keeps its first max_samples and counts the rest as lost, and a trial
+ * that starts while both buffers are still busy is not captured at all.
+ */
+
+#define TRIAL_CAPTURE_FLUSH_PRIO    3   // above telemetry writer, below behaviour
+#define TRIAL_CAPTURE_FLUSH_CORE    1
+#define TRIAL_CAPTURE_HEADROOM      64  // ring slots left free for live records
+
+typedef struct {
+    uint32_t trials_captured;   // buffers handed to the flusher
+    uint32_t trials_flushed;    // buffers completely sent
+    uint32_t trials_skipped;    // trials not captured: no free buffer
+    uint32_t samples_lost;      // samples past max_samples, all trials
+    uint32_t max_fill;          // most samples any one trial needed
+} trial_capture_stats_t;
+
+/**
+ * @brief  Allocate both buffers in PSRAM and start the flush task.
+ * @param  max_samples  Capacity of each buffer
+ * @param  period_us    Spacing of trial_capture_sample() calls (for the host)
+ */
+esp_err_t trial_capture_init(uint32_t max_samples, uint32_t period_us);
+
+/**
+ * @brief  Start recording a trial (trial task, at cue onset).
+ */
+void trial_capture_begin(uint32_t trial);
+
+/**
+ * @brief  Stop recording and queue the buffer for flushing (trial task, at
+ *         the end of RESET).
+ */
+void trial_capture_end(void);
+
+/**
+ * @brief  Append one sample if a trial is being recorded. Called from the
+ *         control loop: no locks, no allocation, returns immediately.
+ */
+void trial_capture_sample(int64_t t_us, int32_t pos, float vel, float u);
+
+void trial_capture_get_stats(trial_capture_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
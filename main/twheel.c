@@ -0,0 +1,74 @@
+// main/twheel.c
+#include "twheel.h"
+#include <string.h>
+
+#define SLOT_MASK   (TWHEEL_SLOTS - 1)
+
+static void unlink_timer(twheel_timer_t *t)
+{
+    *t->pprev = t->next;
+    if (t->next) t->next->pprev = t->pprev;
+    t->next  = NULL;
+    t->pprev = NULL;
+}
+
+void twheel_init(twheel_t *w, uint32_t tick_us, int64_t now_us)
+{
+    memset(w, 0, sizeof(*w));
+    w->tick_us   = tick_us;
+    w->origin_us = now_us;
+}
+
+void twheel_arm(twheel_t *w, twheel_timer_t *t, uint32_t delay_us, twheel_cb_t cb, void *arg)
+{
+    if (t->pprev) unlink_timer(t);
+
+    uint64_t ticks = (delay_us + w->tick_us - 1) / w->tick_us;
+    if (ticks == 0) ticks = 1;      // never fire from inside the current advance
+
+    t->expires = w->now_tick + ticks;
+    t->cb      = cb;
+    t->arg     = arg;
+
+    twheel_timer_t **head = &w->slot[t->expires & SLOT_MASK];
+    t->next  = *head;
+    t->pprev = head;
+    if (*head) (*head)->pprev = &t->next;
+    *head = t;
+}
+
+void twheel_cancel(twheel_t *w, twheel_timer_t *t)
+{
+    if (t->pprev) unlink_timer(t);
+}
+
+void twheel_advance(twheel_t *w, int64_t now_us)
+{
+    if (now_us < w->origin_us) return;
+    uint64_t target = (uint64_t)(now_us - w->origin_us) / w->tick_us;
+
+    while (w->now_tick < target) {
+        w->now_tick++;
+        twheel_timer_t **head = &w->slot[w->now_tick & SLOT_MASK];
+
+        // detach the slot: callbacks may arm or cancel anything, including
+        // timers still on this list, without disturbing the walk
+        twheel_timer_t *list = *head;
+        *head = NULL;
+        if (list) list->pprev = &list;
+
+        while (list) {
+            twheel_timer_t *t = list;
+            unlink_timer(t);
+            if (t->expires <= w->now_tick) {
+                t->cb(t->arg);
+            } else {
+                // later round: back into the slot
+                t->next  = *head;
+                t->pprev = head;
+                if (*head) (*head)->pprev = &t->next;
+                *head = t;
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+// main/twheel.h
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hashed timer wheel for one task's deadlines.
+ *
+ * The owner calls twheel_advance() once per release; every timer whose
+ * deadline has passed fires from there, in the owner's context, so callbacks
+ * need no locking against the owner's state. Arm/cancel are O(1); advancing
+ * visits one slot per elapsed tick. Deadlines longer than one revolution
+ * (TWHEEL_SLOTS ticks) simply stay in their slot for extra rounds.
+ * Not thread-safe: arm, cancel and advance from the owner task only.
+ */
+
+#define TWHEEL_SLOTS    256     // power of two
+
+typedef void (*twheel_cb_t)(void *arg);
+
+typedef struct twheel_timer {
+    struct twheel_timer  *next;
+    struct twheel_timer **pprev;    // NULL while not armed
+    uint64_t              expires;  // wheel tick
+    twheel_cb_t           cb;
+    void                 *arg;
+} twheel_timer_t;
+
+typedef struct {
+    uint32_t        tick_us;
+    int64_t         origin_us;
+    uint64_t        now_tick;       // last tick processed
+    twheel_timer_t *slot[TWHEEL_SLOTS];
+} twheel_t;
+
+/**
+ * @brief  Empty wheel with a @p tick_us resolution, starting at @p now_us
+ *         (esp_timer time).
+ */
+void twheel_init(twheel_t *w, uint32_t tick_us, int64_t now_us);
+
+/**
+ * @brief  (Re)arm @p t to call @p cb(@p arg) once, on the first advance at
+ *         least @p delay_us after the last one. Re-arming moves the deadline.
+ */
+void twheel_arm(twheel_t *w, twheel_timer_t *t, uint32_t delay_us, twheel_cb_t cb, void *arg);
+
+/**
+ * @brief  Disarm @p t; no-op if it is not armed.
+ */
+void twheel_cancel(twheel_t *w, twheel_timer_t *t);
+
+static inline bool twheel_armed(const twheel_timer_t *t)
+{
+    return t->pprev != 0;
+}
+
+/**
+ * @brief  Fire every timer due at @p now_us (esp_timer time).
+ */
+void twheel_advance(twheel_t *w, int64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
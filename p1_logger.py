@@ -12,6 +12,7 @@ import matplotlib.pyplot as plt
 from matplotlib.backends.backend_tkagg import FigureCanvasTkAgg
 import pandas as pd
 import os
+import telemetry
 
 class BehavioralTaskLogger:
     def __init__(self, root):
@@ -155,7 +156,7 @@ class BehavioralTaskLogger:
                 messagebox.showerror("Error", "Please select a COM port")
                 return
                 
-            self.serial_connection = serial.Serial(port, 115200, timeout=1)
+            self.serial_connection = serial.Serial(port, telemetry.BAUD_RATE, timeout=1)
             self.is_connected = True
             
             self.connect_btn.config(text="Disconnect")
@@ -222,12 +223,15 @@ class BehavioralTaskLogger:
             self.tree.delete(item)
     
     def read_serial_data(self):
+        decoder = telemetry.Decoder()
         while self.is_connected:
             try:
                 if self.serial_connection and self.serial_connection.in_waiting:
-                    line = self.serial_connection.readline().decode('utf-8').strip()
-                    if line and self.is_logging:
-                        self.data_queue.put(line)
+                    data = self.serial_connection.read(self.serial_connection.in_waiting)
+                    for kind, item in decoder.feed(data):
+                        # trial summaries arrive as binary TLM_TRIAL records
+                        if kind == "record" and item["type"] == "trial" and self.is_logging:
+                            self.data_queue.put(telemetry.trial_line(item))
             except Exception as e:
                 print(f"Serial read error: {e}")
                 break
@@ -0,0 +1,259 @@
+"""
+Host-side decoder for the firmware's binary telemetry (main/telemetry.h).
+
+Each frame on the wire is COBS(type:u8 seq:u16 payload crc16:u16) followed by
+0x00. Anything between delimiters that does not decode to a valid frame is
+ordinary log text and is handed back as such.
+
+Usage:
+    python telemetry.py COM8                 # print records as they arrive
+    python telemetry.py COM8 --csv session   # also write session_<type>.csv
+"""
+import argparse
+import csv
+import struct
+import sys
+
+BAUD_RATE = 921600
+
+TLM_KIN = 1
+TLM_EFFORT = 2
+TLM_STATE = 3
+TLM_TRIAL = 4
+TLM_HEALTH = 5
+TLM_TRAJ_HDR = 6
+TLM_TRAJ = 7
+TLM_MARKER = 8
+TLM_JOURNAL = 9
+TLM_SYNC = 10
+TLM_STIM = 11
+
+# type -> (name, struct format, field names); little-endian, packed
+RECORDS = {
+    TLM_KIN:    ("kin",    "<Iif",      ("t_us", "pos", "vel")),
+    TLM_EFFORT: ("effort", "<IfB",      ("t_us", "u", "mode")),
+    TLM_STATE:  ("state",  "<IIBB",     ("t_us", "trial", "state", "marker")),
+    TLM_TRIAL:  ("trial",  "<IIBBIiII", ("t_us", "trial", "outcome", "reward_type",
+                                         "rt_ms", "pos", "correct", "total")),
+    TLM_HEALTH: ("health", "<IIIH",     ("t_us", "dropped", "sent", "high_water")),
+    TLM_TRAJ_HDR: ("traj_hdr", "<IIIIH", ("t0_us", "trial", "n_samples", "lost", "period_us")),
+    TLM_TRAJ:   ("traj",   "<HHiffiff", ("trial", "index", "pos0", "vel0", "u0",
+                                         "pos1", "vel1", "u1")),
+    TLM_MARKER: ("marker", "<IIBBBI",   ("t_us", "trial", "marker", "seq", "flags", "late_us")),
+    # a batch of up to 3 entries; the decoder yields one "journal" record per entry
+    TLM_SYNC:   ("sync",   "<IIH",      ("t_us", "seq", "width_us")),
+    TLM_STIM:   ("stim",   "<IIBBiii",  ("t_us", "trial", "marker", "flags",
+                                         "audio_us", "marker_us", "ready_us")),
+    TLM_JOURNAL: ("journal", "<B" + "IBBH" * 3, ("t_us", "kind", "val", "arg")),
+}
+JOURNAL_KINDS = {1: "marker", 2: "ttl", 3: "tone", 4: "sync", 5: "visual", 6: "flip"}
+
+STATE_NAMES = ("INIT", "CUE", "MOVING", "REWARD", "TIMEOUT", "RESET")
+OUTCOME_NAMES = ("CORRECT", "TIMEOUT")
+
+
+def crc16_xmodem(data):
+    """Same CRC as the firmware (and the RoboClaw packets): poly 0x1021, init 0."""
+    crc = 0
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Decoder:
+    """Feed raw serial bytes; get back ('record', dict) and ('text', str) items."""
+
+    def __init__(self):
+        self._buf = bytearray()
+        self._last_seq = None
+        self.crc_errors = 0
+        self.seq_gaps = 0
+        # 32-bit µs timestamps wrap every ~71 min; unwrap per record stream
+        self._t_hi = 0
+        self._t_last = None
+
+    def feed(self, data):
+        self._buf += data
+        while True:
+            idx = self._buf.find(b"\x00")
+            if idx < 0:
+                break
+            chunk = bytes(self._buf[:idx])
+            del self._buf[:idx + 1]
+            if chunk:
+                yield from self._chunk(chunk)
+
+    def _chunk(self, chunk):
+        raw = cobs_decode(chunk)
+        if raw is not None and len(raw) >= 5:
+            body, crc = raw[:-2], (raw[-2] << 8) | raw[-1]
+            rtype = body[0]
+            if crc16_xmodem(body) == crc and rtype in RECORDS:
+                name, fmt, fields = RECORDS[rtype]
+                payload = body[3:]
+                if len(payload) == struct.calcsize(fmt):
+                    seq = body[1] | (body[2] << 8)
+                    if self._last_seq is not None and seq != (self._last_seq + 1) & 0xFFFF:
+                        self.seq_gaps += (seq - self._last_seq - 1) & 0xFFFF
+                    self._last_seq = seq
+                    values = struct.unpack(fmt, payload)
+                    if rtype == TLM_JOURNAL:
+                        for i in range(min(values[0], 3)):
+                            rec = dict(zip(fields, values[1 + 4 * i:5 + 4 * i]))
+                            rec["kind"] = JOURNAL_KINDS.get(rec["kind"], rec["kind"])
+                            rec.update(type=name, seq=seq, t_us=self._unwrap(rec["t_us"]))
+                            yield ("record", rec)
+                        return
+                    rec = dict(zip(fields, values))
+                    rec["type"] = name
+                    rec["seq"] = seq
+                    for key in ("t_us", "t0_us"):
+                        if key in rec:
+                            rec[key] = self._unwrap(rec[key])
+                    yield ("record", rec)
+                    return
+            self.crc_errors += 1
+        text = chunk.decode("utf-8", errors="replace")
+        if text.strip():
+            yield ("text", text)
+
+    def _unwrap(self, t):
+        if self._t_last is not None and t < self._t_last and self._t_last - t > 0x80000000:
+            self._t_hi += 1 << 32
+        self._t_last = t
+        return self._t_hi + t
+
+
+class TrajectoryAssembler:
+    """Collect TLM_TRAJ_HDR + TLM_TRAJ records into whole trials.
+
+    feed() returns (header, samples) once every sample of a trial has arrived,
+    where samples is a list of dicts with t_us, pos, vel and u.
+    """
+
+    def __init__(self):
+        self._hdr = None
+        self._samples = None
+        self._have = 0
+        self.incomplete = 0
+
+    def feed(self, rec):
+        if rec["type"] == "traj_hdr":
+            if self._hdr is not None:
+                self.incomplete += 1
+            self._hdr = rec
+            self._samples = [None] * rec["n_samples"]
+            self._have = 0
+            return self._finish()
+        if rec["type"] != "traj" or self._hdr is None:
+            return None
+        if rec["trial"] != self._hdr["trial"] & 0xFFFF:
+            return None
+        for k in range(2):
+            i = rec["index"] + k
+            if i < len(self._samples) and self._samples[i] is None:
+                self._samples[i] = {
+                    "t_us": self._hdr["t0_us"] + i * self._hdr["period_us"],
+                    "pos": rec[f"pos{k}"],
+                    "vel": rec[f"vel{k}"],
+                    "u": rec[f"u{k}"],
+                }
+                self._have += 1
+        return self._finish()
+
+    def _finish(self):
+        if self._hdr is None or self._have < len(self._samples):
+            return None
+        done = (self._hdr, self._samples)
+        self._hdr, self._samples, self._have = None, None, 0
+        return done
+
+
+def trial_line(rec):
+    """Render a TLM_TRIAL record in the old TRIAL,<outcome>,<rt_ms>,<pos> CSV form."""
+    outcome = OUTCOME_NAMES[rec["outcome"]] if rec["outcome"] < len(OUTCOME_NAMES) else str(rec["outcome"])
+    return f"TRIAL,{outcome},{rec['rt_ms']},{rec['pos']}"
+
+
+def main():
+    import serial
+
+    ap = argparse.ArgumentParser(description="Decode ManipulandumTask telemetry")
+    ap.add_argument("port")
+    ap.add_argument("--baud", type=int, default=BAUD_RATE)
+    ap.add_argument("--csv", metavar="PREFIX", help="write PREFIX_<type>.csv per record type")
+    ap.add_argument("--quiet-kin", action="store_true", help="do not print kin/effort records")
+    args = ap.parse_args()
+
+    writers, files = {}, []
+    if args.csv:
+        for name, _, fields in RECORDS.values():
+            if name.startswith("traj"):
+                continue
+            f = open(f"{args.csv}_{name}.csv", "w", newline="")
+            files.append(f)
+            w = csv.DictWriter(f, fieldnames=("seq",) + fields, extrasaction="ignore")
+            w.writeheader()
+            writers[name] = w
+        f = open(f"{args.csv}_traj.csv", "w", newline="")
+        files.append(f)
+        traj_writer = csv.writer(f)
+        traj_writer.writerow(("trial", "i", "t_us", "pos", "vel", "u"))
+    traj = TrajectoryAssembler()
+
+    dec = Decoder()
+    ser = serial.Serial(args.port, args.baud, timeout=0.1)
+    try:
+        while True:
+            data = ser.read(4096)
+            if not data:
+                continue
+            for kind, item in dec.feed(data):
+                if kind == "text":
+                    sys.stdout.write(item if item.endswith("\n") else item + "\n")
+                    continue
+                if item["type"].startswith("traj"):
+                    done = traj.feed(item)
+                    if done:
+                        hdr, samples = done
+                        print(f"trial {hdr['trial']}: {len(samples)} samples, {hdr['lost']} lost")
+                        if args.csv:
+                            for i, smp in enumerate(samples):
+                                traj_writer.writerow((hdr["trial"], i, smp["t_us"],
+                                                      smp["pos"], smp["vel"], smp["u"]))
+                    continue
+                if args.csv:
+                    writers[item["type"]].writerow(item)
+                if args.quiet_kin and item["type"] in ("kin", "effort"):
+                    continue
+                if item["type"] == "state" and item["state"] < len(STATE_NAMES):
+                    item["state"] = STATE_NAMES[item["state"]]
+                print(item)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        ser.close()
+        for f in files:
+            f.close()
+        print(f"crc errors: {dec.crc_errors}, sequence gaps: {dec.seq_gaps}", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()